@@ -1,13 +1,21 @@
 #include "accelerators/bvh.h"
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cstdint>
+#include <future>
+#include <mutex>
 
 #include "core/AllocAligned.h"
 #include "core/geometry.h"
+#include "core/parallel.h"
 #include "core/phr.h"
 #include "core/primitive.h"
+#include "core/stats.h"
 #include "core/util/MemoryArena.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
 
 struct BVHPrimitiveInfo {
   BVHPrimitiveInfo() {}
@@ -39,158 +47,507 @@ struct BVHBuildNode {
   int splitAxis, firstPrimOffset, nPrimitives;
 };
 
-struct LinearBVHNode {
+// Shared state for one build. Leaves copy their primitives into
+// _orderedPrims_ at the same offsets they occupy in _primitiveInfo_, so the
+// final order does not depend on which task finishes first.
+struct BVHBuildContext {
+  BVHBuildContext(std::vector<BVHPrimitiveInfo> &primitiveInfo,
+                  std::vector<std::shared_ptr<Primitive>> &orderedPrims,
+                  bool parallel, int maxForkDepth)
+      : primitiveInfo(primitiveInfo),
+        orderedPrims(orderedPrims),
+        parallel(parallel),
+        maxForkDepth(maxForkDepth) {}
+
+  std::vector<BVHPrimitiveInfo> &primitiveInfo;
+  std::vector<std::shared_ptr<Primitive>> &orderedPrims;
+  std::atomic<int> totalNodes{0};
+  const bool parallel;
+  const int maxForkDepth;
+
+  // Each forked subtree allocates its nodes from its own arena, since
+  // MemoryArena is not thread-safe. The arenas live until the tree is
+  // flattened.
+  MemoryArena &newArena() {
+    std::lock_guard<std::mutex> lock(arenaMutex);
+    arenas.push_back(std::make_unique<MemoryArena>(1024 * 1024));
+    return *arenas.back();
+  }
+
+ private:
+  std::mutex arenaMutex;
+  std::vector<std::unique_ptr<MemoryArena>> arenas;
+};
+
+// Subtrees with fewer primitives than this are built on the current thread.
+static constexpr int forkThreshold = 4096;
+// Nodes with at least this many primitives compute bounds and SAH buckets
+// in parallel chunks.
+static constexpr int parallelBinThreshold = 256 * 1024;
+
+static int binChunkCount(const BVHBuildContext &ctx, int nPrimitives) {
+  if (!ctx.parallel || nPrimitives < parallelBinThreshold) return 1;
+  return std::min(NumSystemCores(), nPrimitives / (parallelBinThreshold / 4));
+}
+
+static void computeBounds(const BVHBuildContext &ctx, int start, int end,
+                          Bounds3f *bounds, Bounds3f *centroidBounds) {
+  int nChunks = binChunkCount(ctx, end - start);
+  std::vector<Bounds3f> b(nChunks), cb(nChunks);
+  ParallelChunks(end - start, nChunks,
+                 [&](int64_t begin, int64_t chunkEnd, int chunk) {
+                   for (int64_t i = start + begin; i < start + chunkEnd; ++i) {
+                     b[chunk] = Union(b[chunk], ctx.primitiveInfo[i].bounds);
+                     cb[chunk] =
+                         Union(cb[chunk], ctx.primitiveInfo[i].centroid);
+                   }
+                 });
+  for (int c = 0; c < nChunks; ++c) {
+    *bounds = Union(*bounds, b[c]);
+    *centroidBounds = Union(*centroidBounds, cb[c]);
+  }
+}
+
+static BVHBuildNode *initLeaf(
+    BVHBuildContext &ctx, const std::vector<std::shared_ptr<Primitive>> &prims,
+    BVHBuildNode *node, int start, int end, const Bounds3f &bounds) {
+  for (int i = start; i < end; ++i)
+    ctx.orderedPrims[i] = prims[ctx.primitiveInfo[i].primitiveNumber];
+  node->InitLeaf(start, end - start, bounds);
+  return node;
+}
+
+struct BucketInfo {
+  int count = 0;
   Bounds3f bounds;
-  union {
-    int primitivesOffset;
-    int secondChildOffset;
-  };
-  uint16_t nPrimitives;
-  uint8_t axis;
-  uint8_t pad[1];
 };
 
-BVHBuildNode *BVHAccelerator::recursiveBuild(
-    MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo, int start,
-    int end, int *totalNodes,
-    std::vector<std::shared_ptr<Primitive>> orderedPrims) {
+// Maps centroids to SAH buckets along each axis, with one multiply instead of
+// the division Bounds3::Offset() does.
+struct BucketMapping {
+  BucketMapping(const Bounds3f &centroidBounds, int nBuckets)
+      : pMin(centroidBounds.pMin), nBuckets(nBuckets) {
+    for (int axis = 0; axis < 3; ++axis) {
+      Float extent = centroidBounds.pMax[axis] - centroidBounds.pMin[axis];
+      scale[axis] = extent > 0 ? nBuckets / extent : 0;
+    }
+  }
+  int operator()(const Point3f &centroid, int axis) const {
+    int b = (centroid[axis] - pMin[axis]) * scale[axis];
+    return std::min(b, nBuckets - 1);
+  }
+
+  Point3f pMin;
+  Float scale[3];
+  int nBuckets;
+};
+
+// Finds the cheapest SAH split of a node with bounds _bounds_, given
+// _nBuckets_ buckets per axis for each of the three axes, stored one axis
+// after another. Axes the centroids do not extend along are skipped, so at
+// least one must. Sets _*axis_ and _*split_ (buckets up to and including
+// _*split_ go to the first child) and returns the cost relative to
+// intersecting one primitive.
+static Float findSAHSplit(const BucketInfo *buckets, int nBuckets,
+                          const Bounds3f &centroidBounds,
+                          const Bounds3f &bounds, int *axis, int *split) {
+  Float minCost = Infinity;
+  for (int a = 0; a < 3; ++a) {
+    if (centroidBounds.pMax[a] == centroidBounds.pMin[a]) continue;
+    const BucketInfo *b = &buckets[a * nBuckets];
+    // Sweep from the right to get the cost of every second child, then from
+    // the left adding the first child's, which is O(nBuckets) per axis.
+    Float cost1[MaxSAHBuckets - 1];
+    Bounds3f b1;
+    int count1 = 0;
+    for (int i = nBuckets - 1; i > 0; --i) {
+      b1 = Union(b1, b[i].bounds);
+      count1 += b[i].count;
+      cost1[i - 1] = count1 ? count1 * b1.SurfaceArea() : 0;
+    }
+    Bounds3f b0;
+    int count0 = 0;
+    for (int i = 0; i < nBuckets - 1; ++i) {
+      b0 = Union(b0, b[i].bounds);
+      count0 += b[i].count;
+      Float cost =
+          SAHTraversalCost +
+          ((count0 ? count0 * b0.SurfaceArea() : 0) + cost1[i]) /
+              bounds.SurfaceArea();
+      if (cost < minCost) {
+        minCost = cost;
+        *axis = a;
+        *split = i;
+      }
+    }
+  }
+  return minCost;
+}
+
+BVHBuildNode *BVHAccelerator::recursiveBuild(BVHBuildContext &ctx,
+                                             MemoryArena &arena, int start,
+                                             int end, int depth) {
+  std::vector<BVHPrimitiveInfo> &primitiveInfo = ctx.primitiveInfo;
   BVHBuildNode *node = arena.alloc<BVHBuildNode>();
-  (*totalNodes)++;
-  Bounds3f bounds;
-  for (int i = start; i < end; ++i)
-    bounds = Union(bounds, primitiveInfo[i].bounds);
+  ctx.totalNodes++;
   int nPrimitives = end - start;
   if (nPrimitives == 1) {
-    int firstPrimOffset = orderedPrims.size();
-    for (int i = start; i < end; ++i) {
-      int primNum = primitiveInfo[i].primitiveNumber;
-      orderedPrims.push_back(primitives[primNum]);
+    return initLeaf(ctx, primitives, node, start, end,
+                    primitiveInfo[start].bounds);
+  }
+  Bounds3f bounds, centroidBounds;
+  computeBounds(ctx, start, end, &bounds, &centroidBounds);
+  int dim = centroidBounds.MaximumExtent();
+  int mid = (start + end) / 2;
+  if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim])
+    return initLeaf(ctx, primitives, node, start, end, bounds);
+
+  switch (splitMethod) {
+    case BVHSplitMethod::Middle: {
+      Float pmid = (centroidBounds.pMin[dim] + centroidBounds.pMax[dim]) / 2;
+      BVHPrimitiveInfo *midPtr =
+          std::partition(&primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+                         [dim, pmid](const BVHPrimitiveInfo &pi) {
+                           return pi.centroid[dim] < pmid;
+                         });
+      mid = midPtr - &primitiveInfo[0];
+      if (mid != start && mid != end) break;
     }
-    node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
-    return node;
-  } else {
-    Bounds3f centroidBounds;
-    for (int i = start; i < end; ++i)
-      centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
-    int dim = centroidBounds.MaximumExtent();
-    int mid = (start + end) / 2;
-    if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
-      int firstPrimOffset = orderedPrims.size();
-      for (int i = start; i < end; ++i) {
-        int primNum = primitiveInfo[i].primitiveNumber;
-        orderedPrims.push_back(primitives[primNum]);
-      }
-      node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
-      return node;
-    } else {
-      // TODO Add partitioning scheme
-      switch (splitMethod) {
-        case BVHSplitMethod::Middle: {
-          Float pmid =
-              (centroidBounds.pMin[dim] + centroidBounds.pMax[dim]) / 2;
-          BVHPrimitiveInfo *midPtr =
-              std::partition(&primitiveInfo[start], &primitiveInfo[end - 1] + 1,
-                             [dim, pmid](const BVHPrimitiveInfo &pi) {
-                               return pi.centroid[dim] < pmid;
-                             });
-          mid = midPtr - &primitiveInfo[0];
-          if (mid != start && mid != end) break;
-        };
-        case BVHSplitMethod::EqualCounts: {
-          mid = (start + end) / 2;
-          std::nth_element(
-              &primitiveInfo[start], &primitiveInfo[mid],
-              &primitiveInfo[end - 1] + 1,
-              [dim](const BVHPrimitiveInfo &a, const BVHPrimitiveInfo &b) {
-                return a.centroid[dim] < b.centroid[dim];
-              });
-        };
-        case BVHSplitMethod::SAH:
-        default: {
-          if (nPrimitives <= 4) {
-            mid = (start + end) / 2;
-            std::nth_element(
-                &primitiveInfo[start], &primitiveInfo[mid],
-                &primitiveInfo[end - 1] + 1,
-                [dim](const BVHPrimitiveInfo &a, const BVHPrimitiveInfo &b) {
-                  return a.centroid[dim] < b.centroid[dim];
-                });
-          } else {
-            // Actually do SAH
-            constexpr int nBuckets = 12;
-            struct BucketInfo {
-              int count = 0;
-              Bounds3f bounds;
-            };
-            BucketInfo buckets[nBuckets];
-            for (int i = start; i < end; ++i) {
-              int b = nBuckets *
-                      centroidBounds.Offset(primitiveInfo[i].centroid)[dim];
-              if (b == nBuckets) b = nBuckets - 1;
-              buckets[b].count++;
-              buckets[b].bounds =
-                  Union(buckets[b].bounds, primitiveInfo[i].bounds);
-            }
-            // implementation is O(n^2), doesn't really matter now, but could
-            // be a ineffciency later
-            Float cost[nBuckets - 1];
-            for (int i = 0; i < nBuckets - 1; ++i) {
-              Bounds3f b0, b1;
-              int count0 = 0, count1 = 0;
-              for (int j = 0; j <= 1; ++j) {
-                b0 = Union(b0, buckets[j].bounds);
-                count0 += buckets[j].count;
-              }
-              for (int j = 0; j < nBuckets - 1; ++j) {
-                b1 = Union(b1, buckets[j].bounds);
-                count1 += buckets[j].count;
-              }
-              cost[i] = .125f + (count0 * b0.SurfaceArea() +
-                                 count1 * b1.SurfaceArea()) /
-                                    bounds.SurfaceArea();
-            }
-            Float minCost = cost[0];
-            int minCostSplitBucket = 0;
-            for (int i = 1; i < nBuckets - 1; ++i) {
-              if (cost[i] < minCost) {
-                minCost = cost[i];
-                minCostSplitBucket = i;
-              }
-            }
-            Float leafCost = nPrimitives;
-            if (nPrimitives > maxPrimsInNode || minCost < leafCost) {
-              BVHPrimitiveInfo *pmid = std::partition(
-                  &primitiveInfo[start], &primitiveInfo[end - 1] + 1,
-                  [=](const BVHPrimitiveInfo &pi) {
-                    int b = nBuckets * centroidBounds.Offset(pi.centroid)[dim];
-                    if (b == nBuckets) b = nBuckets - 1;
-                    return b <= minCostSplitBucket;
-                  });
-              mid = pmid - &primitiveInfo[0];
-            } else {
-              int firstPrimOffset = orderedPrims.size();
-              for (int i = start; i < end; ++i) {
-                int primNum = primitiveInfo[i].primitiveNumber;
-                orderedPrims.push_back(primitives[primNum]);
+      [[fallthrough]];
+    case BVHSplitMethod::EqualCounts: {
+      mid = (start + end) / 2;
+      std::nth_element(
+          &primitiveInfo[start], &primitiveInfo[mid],
+          &primitiveInfo[end - 1] + 1,
+          [dim](const BVHPrimitiveInfo &a, const BVHPrimitiveInfo &b) {
+            return a.centroid[dim] < b.centroid[dim];
+          });
+      break;
+    }
+    case BVHSplitMethod::SAH:
+    default: {
+      if (nPrimitives <= 4) {
+        mid = (start + end) / 2;
+        std::nth_element(
+            &primitiveInfo[start], &primitiveInfo[mid],
+            &primitiveInfo[end - 1] + 1,
+            [dim](const BVHPrimitiveInfo &a, const BVHPrimitiveInfo &b) {
+              return a.centroid[dim] < b.centroid[dim];
+            });
+      } else {
+        // Bin along all three axes into per-chunk buckets, then merge them
+        // in chunk order. Counts are integers and unions are exact, so the
+        // result is the same for any number of chunks.
+        int nChunks = binChunkCount(ctx, nPrimitives);
+        BucketMapping bucketIndex(centroidBounds, sahBuckets);
+        std::vector<BucketInfo> chunkBuckets(nChunks * 3 * sahBuckets);
+        ParallelChunks(
+            nPrimitives, nChunks,
+            [&](int64_t begin, int64_t chunkEnd, int chunk) {
+              BucketInfo *buckets = &chunkBuckets[chunk * 3 * sahBuckets];
+              for (int64_t i = start + begin; i < start + chunkEnd; ++i) {
+                const BVHPrimitiveInfo &pi = primitiveInfo[i];
+                for (int axis = 0; axis < 3; ++axis) {
+                  BucketInfo &b = buckets[axis * sahBuckets +
+                                          bucketIndex(pi.centroid, axis)];
+                  b.count++;
+                  b.bounds = Union(b.bounds, pi.bounds);
+                }
               }
-              node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
-              return node;
-            }
+            });
+        for (int c = 1; c < nChunks; ++c) {
+          for (int b = 0; b < 3 * sahBuckets; ++b) {
+            chunkBuckets[b].count += chunkBuckets[c * 3 * sahBuckets + b].count;
+            chunkBuckets[b].bounds =
+                Union(chunkBuckets[b].bounds,
+                      chunkBuckets[c * 3 * sahBuckets + b].bounds);
           }
         }
+
+        int minCostSplitBucket;
+        Float minCost = findSAHSplit(chunkBuckets.data(), sahBuckets,
+                                     centroidBounds, bounds, &dim,
+                                     &minCostSplitBucket);
+        Float leafCost = nPrimitives;
+        if (nPrimitives > maxPrimsInNode || minCost < leafCost) {
+          BVHPrimitiveInfo *pmid = std::partition(
+              &primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+              [=](const BVHPrimitiveInfo &pi) {
+                return bucketIndex(pi.centroid, dim) <= minCostSplitBucket;
+              });
+          mid = pmid - &primitiveInfo[0];
+        } else {
+          return initLeaf(ctx, primitives, node, start, end, bounds);
+        }
+      }
+    }
+  }
+
+  BVHBuildNode *children[2];
+  if (ctx.parallel && depth < ctx.maxForkDepth &&
+      std::min(mid - start, end - mid) >= forkThreshold) {
+    std::future<BVHBuildNode *> left =
+        std::async(std::launch::async, [&ctx, this, start, mid, depth] {
+          return recursiveBuild(ctx, ctx.newArena(), start, mid, depth + 1);
+        });
+    children[1] = recursiveBuild(ctx, arena, mid, end, depth + 1);
+    children[0] = left.get();
+  } else {
+    children[0] = recursiveBuild(ctx, arena, start, mid, depth + 1);
+    children[1] = recursiveBuild(ctx, arena, mid, end, depth + 1);
+  }
+  node->InitInterior(dim, children[0], children[1]);
+  return node;
+}
+
+struct MortonPrimitive {
+  int primitiveIndex;
+  uint32_t mortonCode;
+};
+
+struct LBVHTreelet {
+  int startIndex, nPrimitives;
+  BVHBuildNode *buildNodes;
+};
+
+inline uint32_t LeftShift3(uint32_t x) {
+  if (x == (1 << 10)) --x;
+  x = (x | (x << 16)) & 0b00000011000000000000000011111111;
+  x = (x | (x << 8)) & 0b00000011000000001111000000001111;
+  x = (x | (x << 4)) & 0b00000011000011000011000011000011;
+  x = (x | (x << 2)) & 0b00001001001001001001001001001001;
+  return x;
+}
+
+inline uint32_t EncodeMorton3(const Vector3f &v) {
+  return (LeftShift3(v.z) << 2) | (LeftShift3(v.y) << 1) | LeftShift3(v.x);
+}
+
+// Stable LSD radix sort on the 30-bit Morton codes. Each pass builds one
+// histogram per chunk, turns them into per-chunk output offsets, and
+// scatters every chunk in parallel; chunks write disjoint, ordered ranges,
+// so the result is the same as a serial sort.
+static void RadixSort(std::vector<MortonPrimitive> *v, int nChunks) {
+  std::vector<MortonPrimitive> tempVector(v->size());
+  constexpr int bitsPerPass = 6;
+  constexpr int nBits = 30;
+  static_assert((nBits % bitsPerPass) == 0,
+                "Radix sort bitsPerPass must evenly divide nBits");
+  constexpr int nPasses = nBits / bitsPerPass;
+  constexpr int nBuckets = 1 << bitsPerPass;
+  constexpr int bitMask = (1 << bitsPerPass) - 1;
+  std::vector<int> bucketCount(nChunks * nBuckets);
+  for (int pass = 0; pass < nPasses; ++pass) {
+    int lowBit = pass * bitsPerPass;
+    std::vector<MortonPrimitive> &in = (pass & 1) ? tempVector : *v;
+    std::vector<MortonPrimitive> &out = (pass & 1) ? *v : tempVector;
+
+    std::fill(bucketCount.begin(), bucketCount.end(), 0);
+    ParallelChunks(in.size(), nChunks,
+                   [&](int64_t begin, int64_t end, int chunk) {
+                     int *count = &bucketCount[chunk * nBuckets];
+                     for (int64_t i = begin; i < end; ++i)
+                       count[(in[i].mortonCode >> lowBit) & bitMask]++;
+                   });
+
+    // Bucket b of chunk c starts after every element in buckets < b, and
+    // after bucket b's elements from chunks < c.
+    std::vector<int> outIndex(nChunks * nBuckets);
+    int offset = 0;
+    for (int b = 0; b < nBuckets; ++b) {
+      for (int c = 0; c < nChunks; ++c) {
+        outIndex[c * nBuckets + b] = offset;
+        offset += bucketCount[c * nBuckets + b];
+      }
+    }
+
+    ParallelChunks(in.size(), nChunks,
+                   [&](int64_t begin, int64_t end, int chunk) {
+                     int *index = &outIndex[chunk * nBuckets];
+                     for (int64_t i = begin; i < end; ++i) {
+                       int bucket = (in[i].mortonCode >> lowBit) & bitMask;
+                       out[index[bucket]++] = in[i];
+                     }
+                   });
+  }
+  if (nPasses & 1) std::swap(*v, tempVector);
+}
+
+BVHBuildNode *BVHAccelerator::HLBVHBuild(BVHBuildContext &ctx) {
+  const std::vector<BVHPrimitiveInfo> &primitiveInfo = ctx.primitiveInfo;
+  int nPrimitives = primitiveInfo.size();
+  int nChunks = ctx.parallel
+                    ? std::max(1, std::min(NumSystemCores(),
+                                           nPrimitives / forkThreshold))
+                    : 1;
+
+  Bounds3f bounds;
+  for (const BVHPrimitiveInfo &pi : primitiveInfo)
+    bounds = Union(bounds, pi.centroid);
+
+  // Quantize centroids to 10 bits per axis and interleave them
+  std::vector<MortonPrimitive> mortonPrims(nPrimitives);
+  ParallelChunks(nPrimitives, nChunks,
+                 [&](int64_t begin, int64_t end, int) {
+                   constexpr int mortonBits = 10;
+                   constexpr int mortonScale = 1 << mortonBits;
+                   for (int64_t i = begin; i < end; ++i) {
+                     mortonPrims[i].primitiveIndex =
+                         primitiveInfo[i].primitiveNumber;
+                     Vector3f centroidOffset =
+                         bounds.Offset(primitiveInfo[i].centroid);
+                     mortonPrims[i].mortonCode =
+                         EncodeMorton3(centroidOffset * Float(mortonScale));
+                   }
+                 });
+  RadixSort(&mortonPrims, nChunks);
+
+  // Primitives that share the top 12 bits of their code form one treelet
+  std::vector<LBVHTreelet> treeletsToBuild;
+  MemoryArena &arena = ctx.newArena();
+  for (int start = 0, end = 1; end <= nPrimitives; ++end) {
+    uint32_t mask = 0b00111111111111000000000000000000;
+    if (end == nPrimitives || ((mortonPrims[start].mortonCode & mask) !=
+                               (mortonPrims[end].mortonCode & mask))) {
+      int nTreeletPrims = end - start;
+      int maxBVHNodes = 2 * nTreeletPrims - 1;
+      BVHBuildNode *nodes = arena.alloc<BVHBuildNode>(maxBVHNodes, false);
+      treeletsToBuild.push_back({start, nTreeletPrims, nodes});
+      start = end;
+    }
+  }
+
+  // Treelets vary a lot in size, so workers pull them one at a time
+  std::atomic<int> nextTreelet{0};
+  ParallelChunks(nChunks, nChunks, [&](int64_t, int64_t, int) {
+    constexpr int firstBitIndex = 29 - 12;
+    int i;
+    while ((i = nextTreelet++) < int(treeletsToBuild.size())) {
+      LBVHTreelet &tr = treeletsToBuild[i];
+      int nodesCreated = 0;
+      BVHBuildNode *rootNode = tr.buildNodes;
+      emitLBVH(ctx, tr.buildNodes, mortonPrims.data(), tr.startIndex,
+               tr.nPrimitives, &nodesCreated, firstBitIndex);
+      tr.buildNodes = rootNode;
+      ctx.totalNodes += nodesCreated;
+    }
+  });
+
+  std::vector<BVHBuildNode *> finishedTreelets;
+  finishedTreelets.reserve(treeletsToBuild.size());
+  for (LBVHTreelet &treelet : treeletsToBuild)
+    finishedTreelets.push_back(treelet.buildNodes);
+  int upperNodes = 0;
+  BVHBuildNode *root = buildUpperSAH(arena, finishedTreelets, 0,
+                                     finishedTreelets.size(), &upperNodes);
+  ctx.totalNodes += upperNodes;
+  return root;
+}
+
+// _start_ is the index of _mortonPrims[0]_ in the sorted order; leaves use it
+// as their primitive offset so the output order is fixed.
+BVHBuildNode *BVHAccelerator::emitLBVH(BVHBuildContext &ctx,
+                                       BVHBuildNode *&buildNodes,
+                                       const MortonPrimitive *mortonPrims,
+                                       int start, int nPrimitives,
+                                       int *totalNodes, int bitIndex) {
+  if (bitIndex == -1 || nPrimitives <= maxPrimsInNode) {
+    (*totalNodes)++;
+    BVHBuildNode *node = buildNodes++;
+    Bounds3f bounds;
+    for (int i = 0; i < nPrimitives; ++i) {
+      int primitiveIndex = mortonPrims[start + i].primitiveIndex;
+      ctx.orderedPrims[start + i] = primitives[primitiveIndex];
+      bounds = Union(bounds, ctx.primitiveInfo[primitiveIndex].bounds);
+    }
+    node->InitLeaf(start, nPrimitives, bounds);
+    return node;
+  }
+  const MortonPrimitive *prims = mortonPrims + start;
+  uint32_t mask = 1 << bitIndex;
+  // Advance to the next bit if this one does not separate the primitives
+  if ((prims[0].mortonCode & mask) ==
+      (prims[nPrimitives - 1].mortonCode & mask))
+    return emitLBVH(ctx, buildNodes, mortonPrims, start, nPrimitives,
+                    totalNodes, bitIndex - 1);
+
+  // Binary search for the first primitive with _bitIndex_ set
+  int searchStart = 0, searchEnd = nPrimitives - 1;
+  while (searchStart + 1 != searchEnd) {
+    int mid = (searchStart + searchEnd) / 2;
+    if ((prims[searchStart].mortonCode & mask) ==
+        (prims[mid].mortonCode & mask))
+      searchStart = mid;
+    else
+      searchEnd = mid;
+  }
+  int splitOffset = searchEnd;
+
+  (*totalNodes)++;
+  BVHBuildNode *node = buildNodes++;
+  BVHBuildNode *lbvh[2] = {
+      emitLBVH(ctx, buildNodes, mortonPrims, start, splitOffset, totalNodes,
+               bitIndex - 1),
+      emitLBVH(ctx, buildNodes, mortonPrims, start + splitOffset,
+               nPrimitives - splitOffset, totalNodes, bitIndex - 1)};
+  int axis = bitIndex % 3;
+  node->InitInterior(axis, lbvh[0], lbvh[1]);
+  return node;
+}
+
+BVHBuildNode *BVHAccelerator::buildUpperSAH(
+    MemoryArena &arena, std::vector<BVHBuildNode *> &treeletRoots, int start,
+    int end, int *totalNodes) {
+  int nNodes = end - start;
+  if (nNodes == 1) return treeletRoots[start];
+  (*totalNodes)++;
+  BVHBuildNode *node = arena.alloc<BVHBuildNode>();
+
+  Bounds3f bounds, centroidBounds;
+  for (int i = start; i < end; ++i) {
+    bounds = Union(bounds, treeletRoots[i]->bounds);
+    Point3f centroid =
+        (treeletRoots[i]->bounds.pMin + treeletRoots[i]->bounds.pMax) * 0.5f;
+    centroidBounds = Union(centroidBounds, centroid);
+  }
+  int dim = centroidBounds.MaximumExtent();
+
+  int mid = (start + end) / 2;
+  // Treelet centroids can coincide; split them evenly in that case
+  if (centroidBounds.pMax[dim] != centroidBounds.pMin[dim]) {
+    BucketMapping bucketIndex(centroidBounds, sahBuckets);
+    std::vector<BucketInfo> buckets(3 * sahBuckets);
+    for (int i = start; i < end; ++i) {
+      const Bounds3f &b = treeletRoots[i]->bounds;
+      Point3f centroid = (b.pMin + b.pMax) * 0.5f;
+      for (int axis = 0; axis < 3; ++axis) {
+        BucketInfo &bucket =
+            buckets[axis * sahBuckets + bucketIndex(centroid, axis)];
+        bucket.count++;
+        bucket.bounds = Union(bucket.bounds, b);
       }
-      node->InitInterior(dim,
-                         recursiveBuild(arena, primitiveInfo, start, mid,
-                                        totalNodes, orderedPrims),
-                         recursiveBuild(arena, primitiveInfo, mid, end,
-                                        totalNodes, orderedPrims));
     }
+    int minCostSplitBucket;
+    findSAHSplit(buckets.data(), sahBuckets, centroidBounds, bounds, &dim,
+                 &minCostSplitBucket);
+
+    BVHBuildNode **pmid = std::partition(
+        &treeletRoots[start], &treeletRoots[end - 1] + 1,
+        [=](const BVHBuildNode *node) {
+          Point3f centroid = (node->bounds.pMin + node->bounds.pMax) * 0.5f;
+          return bucketIndex(centroid, dim) <= minCostSplitBucket;
+        });
+    mid = pmid - &treeletRoots[0];
   }
+  node->InitInterior(
+      dim, buildUpperSAH(arena, treeletRoots, start, mid, totalNodes),
+      buildUpperSAH(arena, treeletRoots, mid, end, totalNodes));
   return node;
 }
 
-int BVHAccelerator::flattenBVHTree(BVHBuildNode *node, int *offset) {
-  LinearBVHNode *linearNode = &nodes[*offset];
+int BVHAccelerator::flattenBVHTree(BVHBuildNode *node,
+                                   LinearBVHNode *linearNodes, int *offset) {
+  LinearBVHNode *linearNode = &linearNodes[*offset];
   linearNode->bounds = node->bounds;
   int myOffset = (*offset)++;
   if (node->nPrimitives > 0) {
@@ -199,38 +556,211 @@ int BVHAccelerator::flattenBVHTree(BVHBuildNode *node, int *offset) {
   } else {
     linearNode->axis = node->splitAxis;
     linearNode->nPrimitives = 0;
-    linearNode->secondChildOffset = flattenBVHTree(node->children[1], offset);
+    flattenBVHTree(node->children[0], linearNodes, offset);
+    linearNode->secondChildOffset =
+        flattenBVHTree(node->children[1], linearNodes, offset);
   }
+  return myOffset;
 }
 
 BVHAccelerator::BVHAccelerator(
     const std::vector<std::shared_ptr<Primitive>> &primitives,
-    int maxPrimsInNode, BVHSplitMethod splitMethod)
+    int maxPrimsInNode, BVHSplitMethod splitMethod, bool parallelBuild,
+    BVHLayout layout, int sahBuckets)
     : maxPrimsInNode(maxPrimsInNode),
       splitMethod(splitMethod),
-      primitives(primitives) {
+      sahBuckets(Clamp(sahBuckets, 2, MaxSAHBuckets)),
+      primitives(primitives),
+      layout(layout) {
   if (primitives.empty()) return;
   std::vector<BVHPrimitiveInfo> primitiveInfo(primitives.size());
   for (size_t i = 0; i < primitives.size(); ++i) {
     primitiveInfo[i] = {i, primitives[i]->WorldBound()};
   }
 
-  MemoryArena arena(1024 * 1024);
-  int totalNodes = 0;
-  std::vector<std::shared_ptr<Primitive>> orderedPrims;
-  BVHBuildNode *root;
-  root = recursiveBuild(arena, primitiveInfo, 0, primitives.size(), &totalNodes,
-                        orderedPrims);
+  std::vector<std::shared_ptr<Primitive>> orderedPrims(primitives.size());
+  // Allow a few more forks than cores so uneven splits still fill them.
+  BVHBuildContext ctx(primitiveInfo, orderedPrims,
+                      parallelBuild && NumSystemCores() > 1,
+                      int(std::ceil(std::log2(NumSystemCores()))) + 2);
+  BVHBuildNode *root =
+      splitMethod == BVHSplitMethod::HLBVH
+          ? HLBVHBuild(ctx)
+          : recursiveBuild(ctx, ctx.newArena(), 0, primitives.size(), 0);
   this->primitives.swap(orderedPrims);
 
-  nodes = AllocAligned<LinearBVHNode>(totalNodes);
+  totalNodes = ctx.totalNodes;
+  LinearBVHNode *linearNodes = AllocAligned<LinearBVHNode>(totalNodes);
+  nodeStorage = std::shared_ptr<const void>(
+      linearNodes, [](const void *p) { FreeAligned(const_cast<void *>(p)); });
   int offset = 0;
-  flattenBVHTree(root, &offset);
+  flattenBVHTree(root, linearNodes, &offset);
+  nodes = linearNodes;
+
+  records.Build(&this->primitives, nodes, totalNodes);
+  buildWideNodes();
+}
+
+BVHAccelerator::BVHAccelerator(
+    std::vector<std::shared_ptr<Primitive>> primitives,
+    const LinearBVHNode *nodes, int totalNodes,
+    std::shared_ptr<const void> nodeStorage, int maxPrimsInNode,
+    BVHSplitMethod splitMethod, BVHLayout layout, int sahBuckets,
+    const PrimitiveRecords::Arrays *records)
+    : maxPrimsInNode(maxPrimsInNode),
+      splitMethod(splitMethod),
+      sahBuckets(Clamp(sahBuckets, 2, MaxSAHBuckets)),
+      primitives(std::move(primitives)),
+      nodes(totalNodes > 0 ? nodes : nullptr),
+      totalNodes(totalNodes),
+      nodeStorage(std::move(nodeStorage)),
+      layout(layout) {
+  if (records)
+    this->records.Adopt(*records, this->nodeStorage);
+  else
+    this->records.Build(&this->primitives, this->nodes, this->totalNodes);
+  buildWideNodes();
+}
+
+void BVHAccelerator::buildWideNodes() {
+  if (!nodes) return;
+  if (layout == BVHLayout::Wide4)
+    wideNodes4 = std::make_unique<WideBVH<4>>(nodes);
+  else if (layout == BVHLayout::Wide8)
+    wideNodes8 = std::make_unique<WideBVH<8>>(nodes);
+}
+
+size_t BVHAccelerator::WideNodeBytes() const {
+  if (wideNodes4) return wideNodes4->NodeCount() * sizeof(WideBVHNode<4>);
+  if (wideNodes8) return wideNodes8->NodeCount() * sizeof(WideBVHNode<8>);
+  return 0;
+}
+
+// Leaf primitives with a record are intersected inline; a hit only shortens
+// ray.tMax and remembers the primitive in _deferred_, and resolveHit() has it
+// fill in _isect_ once traversal is over. Other primitives fill _isect_
+// themselves and reset _deferred_ to -1.
+inline bool BVHAccelerator::intersectLeaf(const Ray &ray, int offset,
+                                          int count, SurfaceInteraction *isect,
+                                          int *deferred) const {
+  bool hit = false;
+  int i = offset, end = offset + count;
+  // Spheres come first in a leaf. Cull them in batches, then run the exact
+  // test on the ones left over.
+  int nSpheres = 0;
+  while (i + nSpheres < end &&
+         records.Type(i + nSpheres) == RecordType::Sphere)
+    ++nSpheres;
+  PHR_STAT_ADD(PrimitiveTests, nSpheres);
+  const int batchSize = PrimitiveRecords::SphereBatch;
+  for (int batch = 0; batch < nSpheres; batch += batchSize) {
+    int first = records.Index(i + batch);
+    int n = std::min(batchSize, nSpheres - batch);
+    int mask = n > 1 ? records.CullSpheres(ray, first, n) : 1;
+    for (int j = 0; j < n; ++j) {
+      Float t;
+      if (!(mask & (1 << j)) || !records.IntersectSphere(ray, first + j, &t))
+        continue;
+      PHR_STAT_INC(PrimitiveHits);
+      ray.tMax = t;
+      *deferred = i + batch + j;
+      hit = true;
+    }
+  }
+
+  for (i += nSpheres; i < end; ++i) {
+    if (records.Type(i) == RecordType::Triangle) {
+      PHR_STAT_INC(PrimitiveTests);
+      const TriangleRecord &tri = records.Triangles()[records.Index(i)];
+      Float t, b0, b1, b2;
+      if (!IntersectTriangle(ray, tri.p0, tri.p1, tri.p2, &t, &b0, &b1, &b2))
+        continue;
+      PHR_STAT_INC(PrimitiveHits);
+      ray.tMax = t;
+      *deferred = i;
+      hit = true;
+    } else if (primitives[i]->Intersect(ray, isect)) {
+      *deferred = -1;
+      hit = true;
+    }
+  }
+  return hit;
+}
+
+inline bool BVHAccelerator::intersectLeafP(const Ray &ray, int offset,
+                                           int count) const {
+  int i = offset, end = offset + count;
+  int nSpheres = 0;
+  while (i + nSpheres < end &&
+         records.Type(i + nSpheres) == RecordType::Sphere)
+    ++nSpheres;
+  PHR_STAT_ADD(PrimitiveTests, nSpheres);
+  const int batchSize = PrimitiveRecords::SphereBatch;
+  for (int batch = 0; batch < nSpheres; batch += batchSize) {
+    int first = records.Index(i + batch);
+    int n = std::min(batchSize, nSpheres - batch);
+    int mask = n > 1 ? records.CullSpheres(ray, first, n) : 1;
+    for (int j = 0; j < n; ++j) {
+      Float t;
+      if ((mask & (1 << j)) && records.IntersectSphere(ray, first + j, &t))
+        return true;
+    }
+  }
+
+  for (i += nSpheres; i < end; ++i) {
+    if (records.Type(i) == RecordType::Triangle) {
+      PHR_STAT_INC(PrimitiveTests);
+      const TriangleRecord &tri = records.Triangles()[records.Index(i)];
+      Float t, b0, b1, b2;
+      if (IntersectTriangle(ray, tri.p0, tri.p1, tri.p2, &t, &b0, &b1, &b2))
+        return true;
+    } else if (primitives[i]->IntersectP(ray)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The record kernels compute exactly what the shapes' own intersect() does,
+// so re-intersecting the winner over the ray's original extent finds the same
+// hit, now with the full SurfaceInteraction. Should the shape still reject
+// it, the hit is dropped instead of being returned with an unfilled
+// _isect_, and false is returned with ray.tMax back at _tMax_.
+inline bool BVHAccelerator::resolveHit(const Ray &ray, Float tMax, int deferred,
+                                       SurfaceInteraction *isect) const {
+  if (deferred < 0) return true;
+  ray.tMax = tMax;
+  bool hit = primitives[deferred]->Intersect(ray, isect);
+  // The shape counts its test, and its hit if any, again; intersectLeaf()
+  // already counted both for the record, so take them back out. The
+  // counters are unsigned, so adding ~0 subtracts one.
+  PHR_STAT_ADD(PrimitiveTests, ~uint64_t(0));
+  if (hit) PHR_STAT_ADD(PrimitiveHits, ~uint64_t(0));
+  return hit;
+}
+
+Bounds3f BVHAccelerator::WorldBound() const {
+  return nodes ? nodes[0].bounds : Bounds3f();
 }
 
 bool BVHAccelerator::Intersect(const Ray &ray,
                                SurfaceInteraction *isect) const {
   if (!nodes) return false;
+  PHR_STAT_INC(RaysTraced);
+  PHR_STAT_TIMER(TraversalCycles);
+  const Float tMax = ray.tMax;
+  int deferred = -1;
+  if (layout != BVHLayout::Binary) {
+    auto leaf = [&](int offset, int count) {
+      PHR_STAT_TIMER(LeafCycles);
+      return intersectLeaf(ray, offset, count, isect, &deferred);
+    };
+    bool hit = wideNodes4 ? wideNodes4->Intersect(ray, leaf, false)
+                          : wideNodes8->Intersect(ray, leaf, false);
+    if (hit) hit = resolveHit(ray, tMax, deferred, isect);
+    if (hit) PHR_STAT_INC(RayHits);
+    return hit;
+  }
   bool hit = false;
   Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
   int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
@@ -239,13 +769,17 @@ bool BVHAccelerator::Intersect(const Ray &ray,
   int nodesToVisit[64];
   while (true) {
     const LinearBVHNode *node = &nodes[currentNodeIndex];
+    PHR_STAT_INC(NodesVisited);
+    PHR_STAT_INC(BoxTests);
     // Check ray against BVH node
     if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
       if (node->nPrimitives > 0) {
         // Intersect ray with primitives in leaf BVH node
-        for (int i = 0; i < node->nPrimitives; ++i)
-          if (primitives[node->primitivesOffset + i]->Intersect(ray, isect))
-            hit = true;
+        PHR_STAT_INC(LeafVisits);
+        PHR_STAT_TIMER(LeafCycles);
+        if (intersectLeaf(ray, node->primitivesOffset, node->nPrimitives,
+                          isect, &deferred))
+          hit = true;
         if (toVisitOffset == 0) break;
         currentNodeIndex = nodesToVisit[--toVisitOffset];
       } else {
@@ -264,11 +798,25 @@ bool BVHAccelerator::Intersect(const Ray &ray,
       currentNodeIndex = nodesToVisit[--toVisitOffset];
     }
   }
+  if (hit) hit = resolveHit(ray, tMax, deferred, isect);
+  if (hit) PHR_STAT_INC(RayHits);
   return hit;
 }
 
 bool BVHAccelerator::IntersectP(const Ray &ray) const {
   if (!nodes) return false;
+  PHR_STAT_INC(ShadowRays);
+  PHR_STAT_TIMER(TraversalCycles);
+  if (layout != BVHLayout::Binary) {
+    auto leaf = [&](int offset, int count) {
+      PHR_STAT_TIMER(LeafCycles);
+      return intersectLeafP(ray, offset, count);
+    };
+    bool hit = wideNodes4 ? wideNodes4->Intersect(ray, leaf, true)
+                          : wideNodes8->Intersect(ray, leaf, true);
+    if (hit) PHR_STAT_INC(RayHits);
+    return hit;
+  }
   Vector3f invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
   int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
   int nodesToVisit[64];
@@ -276,12 +824,15 @@ bool BVHAccelerator::IntersectP(const Ray &ray) const {
   int currentNodeIndex = 0;
   while (true) {
     const LinearBVHNode *node = &nodes[currentNodeIndex];
+    PHR_STAT_INC(NodesVisited);
+    PHR_STAT_INC(BoxTests);
     if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
       if (node->nPrimitives > 0) {
-        for (int i = 0; i < node->nPrimitives; ++i) {
-          if (primitives[node->primitivesOffset + i]->IntersectP(ray)) {
-            return true;
-          }
+        PHR_STAT_INC(LeafVisits);
+        PHR_STAT_TIMER(LeafCycles);
+        if (intersectLeafP(ray, node->primitivesOffset, node->nPrimitives)) {
+          PHR_STAT_INC(RayHits);
+          return true;
         }
         if (toVisitOffset == 0) break;
         currentNodeIndex = nodesToVisit[--toVisitOffset];
@@ -301,3 +852,200 @@ bool BVHAccelerator::IntersectP(const Ray &ray) const {
   }
   return false;
 }
+
+int BVHAccelerator::Intersect(RayPacket8 &packet,
+                              SurfaceInteraction *isects) const {
+  if (!nodes || !packet.activeMask) return 0;
+  // The wide layouts have no packet traversal; trace the active rays one
+  // at a time through the wide nodes instead.
+  if (layout != BVHLayout::Binary) {
+    int hitMask = 0;
+    for (int r = 0; r < RayPacket8::Size; ++r) {
+      if (!(packet.activeMask & (1 << r))) continue;
+      if (Intersect(packet.rays[r], &isects[r])) hitMask |= 1 << r;
+      packet.SyncTMax(r);
+    }
+    return hitMask;
+  }
+  int first = 0;
+  while (!(packet.activeMask & (1 << first))) ++first;
+  const Vector3f &d = packet.rays[first].d;
+  int dirIsNeg[3] = {d.x < 0, d.y < 0, d.z < 0};
+  PHR_STAT_ADD(RaysTraced, std::bitset<8>(packet.activeMask).count());
+  PHR_STAT_TIMER(TraversalCycles);
+
+  int hitMask = 0;
+  Float tMax[RayPacket8::Size];
+  int deferred[RayPacket8::Size];
+  for (int r = 0; r < RayPacket8::Size; ++r) {
+    tMax[r] = packet.rays[r].tMax;
+    deferred[r] = -1;
+  }
+  int toVisitOffset = 0, currentNodeIndex = 0;
+  int nodesToVisit[64];
+  while (true) {
+    const LinearBVHNode *node = &nodes[currentNodeIndex];
+    // Counted per ray, like RaysTraced, so packet and single-ray runs
+    // report comparable per-ray figures.
+    PHR_STAT_ADD(NodesVisited, std::bitset<8>(packet.activeMask).count());
+    PHR_STAT_ADD(BoxTests, std::bitset<8>(packet.activeMask).count());
+    int nodeMask = IntersectBounds(node->bounds, packet, packet.activeMask);
+    if (nodeMask) {
+      if (node->nPrimitives > 0) {
+        PHR_STAT_ADD(LeafVisits, std::bitset<8>(nodeMask).count());
+        PHR_STAT_TIMER(LeafCycles);
+        for (int r = 0; r < RayPacket8::Size; ++r) {
+          if (!(nodeMask & (1 << r))) continue;
+          if (intersectLeaf(packet.rays[r], node->primitivesOffset,
+                            node->nPrimitives, &isects[r], &deferred[r]))
+            hitMask |= 1 << r;
+          packet.SyncTMax(r);
+        }
+        if (toVisitOffset == 0) break;
+        currentNodeIndex = nodesToVisit[--toVisitOffset];
+      } else {
+        if (dirIsNeg[node->axis]) {
+          nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+          currentNodeIndex = node->secondChildOffset;
+        } else {
+          nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+          currentNodeIndex = currentNodeIndex + 1;
+        }
+      }
+    } else {
+      if (toVisitOffset == 0) break;
+      currentNodeIndex = nodesToVisit[--toVisitOffset];
+    }
+  }
+  for (int r = 0; r < RayPacket8::Size; ++r) {
+    if (!(hitMask & (1 << r))) continue;
+    if (!resolveHit(packet.rays[r], tMax[r], deferred[r], &isects[r]))
+      hitMask &= ~(1 << r);
+    packet.SyncTMax(r);
+  }
+  PHR_STAT_ADD(RayHits, std::bitset<8>(hitMask).count());
+  return hitMask;
+}
+
+int BVHAccelerator::IntersectP(const RayPacket8 &packet) const {
+  if (!nodes || !packet.activeMask) return 0;
+  if (layout != BVHLayout::Binary) {
+    int hitMask = 0;
+    for (int r = 0; r < RayPacket8::Size; ++r) {
+      if (!(packet.activeMask & (1 << r))) continue;
+      if (IntersectP(packet.rays[r])) hitMask |= 1 << r;
+    }
+    return hitMask;
+  }
+  int first = 0;
+  while (!(packet.activeMask & (1 << first))) ++first;
+  const Vector3f &d = packet.rays[first].d;
+  int dirIsNeg[3] = {d.x < 0, d.y < 0, d.z < 0};
+
+  PHR_STAT_ADD(ShadowRays, std::bitset<8>(packet.activeMask).count());
+  PHR_STAT_TIMER(TraversalCycles);
+
+  // Occluded rays drop out of the active mask
+  int activeMask = packet.activeMask;
+  int toVisitOffset = 0, currentNodeIndex = 0;
+  int nodesToVisit[64];
+  while (true) {
+    const LinearBVHNode *node = &nodes[currentNodeIndex];
+    PHR_STAT_ADD(NodesVisited, std::bitset<8>(activeMask).count());
+    PHR_STAT_ADD(BoxTests, std::bitset<8>(activeMask).count());
+    int nodeMask = IntersectBounds(node->bounds, packet, activeMask);
+    if (nodeMask) {
+      if (node->nPrimitives > 0) {
+        PHR_STAT_ADD(LeafVisits, std::bitset<8>(nodeMask).count());
+        PHR_STAT_TIMER(LeafCycles);
+        for (int r = 0; r < RayPacket8::Size; ++r) {
+          if (!(nodeMask & (1 << r))) continue;
+          if (intersectLeafP(packet.rays[r], node->primitivesOffset,
+                             node->nPrimitives))
+            activeMask &= ~(1 << r);
+        }
+        if (toVisitOffset == 0 || !activeMask) break;
+        currentNodeIndex = nodesToVisit[--toVisitOffset];
+      } else {
+        if (dirIsNeg[node->axis]) {
+          nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+          currentNodeIndex = node->secondChildOffset;
+        } else {
+          nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+          currentNodeIndex = currentNodeIndex + 1;
+        }
+      }
+    } else {
+      if (toVisitOffset == 0) break;
+      currentNodeIndex = nodesToVisit[--toVisitOffset];
+    }
+  }
+  PHR_STAT_ADD(RayHits,
+               std::bitset<8>(packet.activeMask & ~activeMask).count());
+  return packet.activeMask & ~activeMask;
+}
+
+// Stable order of _rays_ by the octant of their direction, so that each
+// packet shares one traversal order.
+static std::vector<int> sortByOctant(const Ray *rays, int nRays,
+                                     std::vector<int> *octants) {
+  octants->resize(nRays);
+  int count[8] = {0};
+  for (int i = 0; i < nRays; ++i) {
+    const Vector3f &d = rays[i].d;
+    (*octants)[i] = (d.x < 0) | ((d.y < 0) << 1) | ((d.z < 0) << 2);
+    count[(*octants)[i]]++;
+  }
+  int start[8] = {0};
+  for (int o = 1; o < 8; ++o) start[o] = start[o - 1] + count[o - 1];
+  std::vector<int> order(nRays);
+  for (int i = 0; i < nRays; ++i) order[start[(*octants)[i]]++] = i;
+  return order;
+}
+
+// Calls _tracePacket(packet, indices, n)_ for runs of up to eight rays with
+// the same octant.
+template <typename TracePacket>
+static void forEachPacket(const Ray *rays, int nRays,
+                          TracePacket tracePacket) {
+  std::vector<int> octants;
+  std::vector<int> order = sortByOctant(rays, nRays, &octants);
+  for (int start = 0; start < nRays;) {
+    RayPacket8 packet;
+    int indices[RayPacket8::Size];
+    int n = 0;
+    while (n < RayPacket8::Size && start + n < nRays &&
+           octants[order[start + n]] == octants[order[start]]) {
+      indices[n] = order[start + n];
+      packet.Set(n, rays[indices[n]]);
+      ++n;
+    }
+    tracePacket(packet, indices, n);
+    start += n;
+  }
+}
+
+void BVHAccelerator::Intersect(const Ray *rays, int nRays,
+                               SurfaceInteraction *isects, bool *hits) const {
+  forEachPacket(rays, nRays,
+                [&](RayPacket8 &packet, const int *indices, int n) {
+                  SurfaceInteraction packetIsects[RayPacket8::Size];
+                  int hitMask = Intersect(packet, packetIsects);
+                  for (int k = 0; k < n; ++k) {
+                    hits[indices[k]] = hitMask & (1 << k);
+                    if (!hits[indices[k]]) continue;
+                    isects[indices[k]] = packetIsects[k];
+                    rays[indices[k]].tMax = packet.rays[k].tMax;
+                  }
+                });
+}
+
+void BVHAccelerator::IntersectP(const Ray *rays, int nRays,
+                                bool *occluded) const {
+  forEachPacket(rays, nRays,
+                [&](RayPacket8 &packet, const int *indices, int n) {
+                  int hitMask = IntersectP(packet);
+                  for (int k = 0; k < n; ++k)
+                    occluded[indices[k]] = hitMask & (1 << k);
+                });
+}
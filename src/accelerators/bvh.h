@@ -2,36 +2,145 @@
 #define PHR_ACCELERATORS_BVH_H
 
 #include <memory>
+#include <type_traits>
 #include <vector>
 
+#include "accelerators/primitiverecords.h"
+#include "accelerators/widebvh.h"
 #include "core/geometry.h"
 #include "core/interaction.h"
 #include "core/primitive.h"
+#include "core/raypacket.h"
 #include "core/util/MemoryArena.h"
 enum class BVHSplitMethod { SAH, HLBVH, Middle, EqualCounts };
 
+// The cost of visiting an interior node relative to intersecting one
+// primitive, as assumed by the SAH build and by ComputeBVHMetrics().
+static constexpr Float SAHTraversalCost = .125f;
+// The SAH build bins primitive centroids into this many buckets per axis by
+// default, and accepts between 2 and MaxSAHBuckets.
+static constexpr int DefaultSAHBuckets = 12;
+static constexpr int MaxSAHBuckets = 64;
+
 struct BVHPrimitiveInfo;
 struct BVHBuildNode;
-struct LinearBVHNode;
+struct BVHBuildContext;
+struct MortonPrimitive;
+
+struct LinearBVHNode {
+  Bounds3f bounds;
+  union {
+    int primitivesOffset;
+    int secondChildOffset;
+  };
+  uint16_t nPrimitives;
+  uint8_t axis;
+  uint8_t pad[1];
+};
+// Scene caches store the node array verbatim, so its layout is part of the
+// cache format.
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode layout changed");
+static_assert(std::is_trivially_copyable<LinearBVHNode>::value,
+              "LinearBVHNode must be trivially copyable");
 
 class BVHAccelerator : public Aggregate {
  public:
+  // With _parallelBuild_ set, subtrees above a size threshold are built as
+  // separate tasks and large nodes bin their primitives in parallel. The
+  // resulting _nodes_ and primitive order match the serial build exactly.
+  //
+  // _layout_ picks the node format used for traversal. The wide layouts are
+  // collapsed from the binary tree after it is built, so _nodes_ is always
+  // available for comparison.
+  //
+  // The SAH build, and the top levels of the HLBVH build, consider
+  // _sahBuckets_ - 1 candidate splits along each axis; more buckets cost
+  // build time and usually give a slightly better tree.
   BVHAccelerator(const std::vector<std::shared_ptr<Primitive>> &primitives,
-                 int maxPrimsInNode, BVHSplitMethod splitMethod);
-  BVHBuildNode *recursiveBuild(
-      MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo,
-      int start, int end, int *totalNodes,
-      std::vector<std::shared_ptr<Primitive>> orderedPrims);
-  int flattenBVHTree(BVHBuildNode *node, int *offset);
-  bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
-  bool IntersectP(const Ray &ray) const;
-  ~BVHAccelerator();
+                 int maxPrimsInNode, BVHSplitMethod splitMethod,
+                 bool parallelBuild = true,
+                 BVHLayout layout = BVHLayout::Binary,
+                 int sahBuckets = DefaultSAHBuckets);
+  // Adopts a node array built earlier, e.g. one mapped from a scene cache,
+  // instead of building a new tree. _primitives_ must already be in the
+  // order the leaves refer to, up to the order within each leaf.
+  // _nodeStorage_ keeps the memory behind _nodes_ alive; the accelerator
+  // never writes to it. With _records_, the leaf records are adopted from
+  // the same storage instead of being built; _primitives_ must then be in
+  // exactly the order the records were built for.
+  BVHAccelerator(std::vector<std::shared_ptr<Primitive>> primitives,
+                 const LinearBVHNode *nodes, int totalNodes,
+                 std::shared_ptr<const void> nodeStorage, int maxPrimsInNode,
+                 BVHSplitMethod splitMethod,
+                 BVHLayout layout = BVHLayout::Binary,
+                 int sahBuckets = DefaultSAHBuckets,
+                 const PrimitiveRecords::Arrays *records = nullptr);
+  BVHBuildNode *recursiveBuild(BVHBuildContext &ctx, MemoryArena &arena,
+                               int start, int end, int depth);
+  BVHBuildNode *HLBVHBuild(BVHBuildContext &ctx);
+  BVHBuildNode *emitLBVH(BVHBuildContext &ctx, BVHBuildNode *&buildNodes,
+                         const MortonPrimitive *mortonPrims, int start,
+                         int nPrimitives, int *totalNodes, int bitIndex);
+  BVHBuildNode *buildUpperSAH(MemoryArena &arena,
+                              std::vector<BVHBuildNode *> &treeletRoots,
+                              int start, int end, int *totalNodes);
+  int flattenBVHTree(BVHBuildNode *node, LinearBVHNode *linearNodes,
+                     int *offset);
+  Bounds3f WorldBound() const override;
+  bool Intersect(const Ray &ray, SurfaceInteraction *isect) const override;
+  bool IntersectP(const Ray &ray) const override;
+
+  // Packet traversal for coherent rays such as camera rays from one tile.
+  // The packet walks the binary tree once, in the traversal order of its
+  // first active ray, testing every box against all active rays at once.
+  // _isects_ holds one entry per packet slot. Both return a mask of the rays
+  // that hit. With a wide layout the active rays are traced one at a time
+  // through the wide nodes instead, so the layout applies either way.
+  int Intersect(RayPacket8 &packet, SurfaceInteraction *isects) const;
+  int IntersectP(const RayPacket8 &packet) const;
+
+  // Stream traversal: groups _rays_ by direction octant and traces each
+  // group in packets of eight. Hit rays have their tMax shortened.
+  void Intersect(const Ray *rays, int nRays, SurfaceInteraction *isects,
+                 bool *hits) const;
+  void IntersectP(const Ray *rays, int nRays, bool *occluded) const;
+
+  // Primitives in the order the leaves refer to. Within a leaf they are
+  // grouped by RecordType.
+  const std::vector<std::shared_ptr<Primitive>> &Primitives() const {
+    return primitives;
+  }
+  const PrimitiveRecords &Records() const { return records; }
+  const LinearBVHNode *Nodes() const { return nodes; }
+  int TotalNodes() const { return totalNodes; }
+  int MaxPrimsInNode() const { return maxPrimsInNode; }
+  BVHSplitMethod SplitMethod() const { return splitMethod; }
+  int SAHBuckets() const { return sahBuckets; }
+  BVHLayout Layout() const { return layout; }
+  // Bytes taken by the wide nodes, if the layout has any.
+  size_t WideNodeBytes() const;
 
  private:
+  void buildWideNodes();
+  bool intersectLeaf(const Ray &ray, int offset, int count,
+                     SurfaceInteraction *isect, int *deferred) const;
+  bool intersectLeafP(const Ray &ray, int offset, int count) const;
+  bool resolveHit(const Ray &ray, Float tMax, int deferred,
+                  SurfaceInteraction *isect) const;
+
   const int maxPrimsInNode;
   const BVHSplitMethod splitMethod;
+  const int sahBuckets;
   std::vector<std::shared_ptr<Primitive>> primitives;
-  LinearBVHNode *nodes = nullptr;
+  PrimitiveRecords records;
+  const LinearBVHNode *nodes = nullptr;
+  int totalNodes = 0;
+  // Owns _nodes_: an aligned allocation for built trees, or whatever the
+  // adopting caller handed over.
+  std::shared_ptr<const void> nodeStorage;
+  const BVHLayout layout;
+  std::unique_ptr<WideBVH<4>> wideNodes4;
+  std::unique_ptr<WideBVH<8>> wideNodes8;
 };
 
 #endif  // PHR_ACCELERATORS_BVH_H
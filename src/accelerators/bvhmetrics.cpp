@@ -0,0 +1,118 @@
+#include "accelerators/bvhmetrics.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+// Surface area of the intersection of _b0_ and _b1_, or 0 if they are
+// disjoint. (Intersect() would sort the corners of an empty result into a
+// valid box.)
+static double overlapArea(const Bounds3f &b0, const Bounds3f &b1) {
+  double d[3];
+  for (int i = 0; i < 3; ++i) {
+    d[i] = double(std::min(b0.pMax[i], b1.pMax[i])) -
+           double(std::max(b0.pMin[i], b1.pMin[i]));
+    if (d[i] < 0) return 0;
+  }
+  return 2 * (d[0] * d[1] + d[0] * d[2] + d[1] * d[2]);
+}
+
+BVHMetrics ComputeBVHMetrics(const BVHAccelerator &bvh) {
+  BVHMetrics m;
+  const LinearBVHNode *nodes = bvh.Nodes();
+  m.nodes = bvh.TotalNodes();
+  m.nodeBytes = size_t(m.nodes) * sizeof(LinearBVHNode);
+  m.wideNodeBytes = bvh.WideNodeBytes();
+  m.recordBytes = bvh.Records().BytesUsed();
+  m.primitiveBytes =
+      bvh.Primitives().size() * sizeof(std::shared_ptr<Primitive>);
+  if (!nodes || m.nodes == 0) return m;
+
+  double rootArea = nodes[0].bounds.SurfaceArea();
+  double depthSum = 0;
+  struct Entry {
+    int node, depth;
+  };
+  std::vector<Entry> toVisit = {{0, 0}};
+  while (!toVisit.empty()) {
+    Entry e = toVisit.back();
+    toVisit.pop_back();
+    const LinearBVHNode &node = nodes[e.node];
+    // Flat boxes (a single axis-aligned triangle, say) have zero area, as
+    // does a root holding one; weight those as if they were the root.
+    double weight =
+        rootArea > 0 ? node.bounds.SurfaceArea() / rootArea : 1.0;
+    m.maxDepth = std::max(m.maxDepth, e.depth);
+    if (node.nPrimitives > 0) {
+      ++m.leaves;
+      m.primitives += node.nPrimitives;
+      m.leafCost += weight * node.nPrimitives;
+      depthSum += double(e.depth) * node.nPrimitives;
+      if (int(m.leafDepths.size()) <= e.depth)
+        m.leafDepths.resize(e.depth + 1);
+      ++m.leafDepths[e.depth];
+      if (int(m.leafSizes.size()) <= node.nPrimitives)
+        m.leafSizes.resize(node.nPrimitives + 1);
+      ++m.leafSizes[node.nPrimitives];
+    } else {
+      ++m.interiorNodes;
+      m.interiorCost += weight * SAHTraversalCost;
+      const Bounds3f &b0 = nodes[e.node + 1].bounds;
+      const Bounds3f &b1 = nodes[node.secondChildOffset].bounds;
+      double overlap = overlapArea(b0, b1);
+      double area = node.bounds.SurfaceArea();
+      if (overlap > 0) ++m.overlappingNodes;
+      if (area > 0) m.siblingOverlap += overlap / area;
+      toVisit.push_back({node.secondChildOffset, e.depth + 1});
+      toVisit.push_back({e.node + 1, e.depth + 1});
+    }
+  }
+  m.sahCost = m.interiorCost + m.leafCost;
+  if (m.primitives > 0) m.averageDepth = depthSum / m.primitives;
+  if (m.interiorNodes > 0) m.siblingOverlap /= m.interiorNodes;
+  return m;
+}
+
+// Prints _counts_ as one line per non-empty bucket, with a bar scaled to the
+// largest.
+static void printHistogram(FILE *out, const char *label,
+                           const std::vector<int> &counts) {
+  int largest = 0, total = 0;
+  for (int c : counts) {
+    largest = std::max(largest, c);
+    total += c;
+  }
+  fprintf(out, "  %s:\n", label);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i] == 0) continue;
+    int bar = int(40. * counts[i] / largest + 0.5);
+    fprintf(out, "    %4zu %10d %5.1f%%%s%s\n", i, counts[i],
+            100. * counts[i] / total, bar ? " " : "",
+            std::string(bar, '#').c_str());
+  }
+}
+
+void ReportBVHMetrics(FILE *out, const BVHMetrics &m) {
+  fprintf(out, "BVH:\n");
+  fprintf(out, "  SAH cost              %12.3f (%.3f interior, %.3f leaves)\n",
+          m.sahCost, m.interiorCost, m.leafCost);
+  fprintf(out, "  Nodes                 %12d (%d interior, %d leaves)\n",
+          m.nodes, m.interiorNodes, m.leaves);
+  fprintf(out, "  Primitives            %12d (%.2f per leaf)\n", m.primitives,
+          m.leaves ? double(m.primitives) / m.leaves : 0.);
+  fprintf(out, "  Depth                 %12d max, %.2f average\n", m.maxDepth,
+          m.averageDepth);
+  fprintf(out, "  Sibling overlap       %11.2f%% of parent area (%.1f%% of "
+          "nodes)\n",
+          100 * m.siblingOverlap,
+          m.interiorNodes ? 100. * m.overlappingNodes / m.interiorNodes : 0.);
+  size_t total =
+      m.nodeBytes + m.wideNodeBytes + m.recordBytes + m.primitiveBytes;
+  fprintf(out, "  Memory                %10.1f KB\n", total / 1024.);
+  fprintf(out, "    nodes %.1f KB, wide nodes %.1f KB, records %.1f KB, "
+          "primitive refs %.1f KB\n",
+          m.nodeBytes / 1024., m.wideNodeBytes / 1024., m.recordBytes / 1024.,
+          m.primitiveBytes / 1024.);
+  printHistogram(out, "Leaves by depth", m.leafDepths);
+  printHistogram(out, "Leaves by size", m.leafSizes);
+}
@@ -0,0 +1,45 @@
+#ifndef PHR_ACCELERATORS_BVHMETRICS_H
+#define PHR_ACCELERATORS_BVHMETRICS_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "accelerators/bvh.h"
+
+// Measures of how good a built BVH is, for comparing split methods and
+// tuning build parameters on real scenes.
+struct BVHMetrics {
+  // Expected cost of a ray that hits the root, in primitive tests: the
+  // surface area heuristic summed over the tree, with interior nodes costing
+  // SAHTraversalCost and leaves their primitive count, each weighted by its
+  // area relative to the root's.
+  double sahCost = 0;
+  // The parts of _sahCost_ spent on interior nodes and on leaves.
+  double interiorCost = 0, leafCost = 0;
+
+  int nodes = 0, interiorNodes = 0, leaves = 0, primitives = 0;
+  int maxDepth = 0;
+  // Mean leaf depth, weighted by primitive count.
+  double averageDepth = 0;
+  // _leafDepths_[d] is the number of leaves at depth d (the root being at
+  // 0), and _leafSizes_[n] the number of leaves holding n primitives.
+  std::vector<int> leafDepths, leafSizes;
+
+  // Mean, over interior nodes, of the surface area of the intersection of
+  // the two children's bounds relative to the parent's; 0 when siblings
+  // never overlap.
+  double siblingOverlap = 0;
+  // Interior nodes whose children's bounds overlap at all.
+  int overlappingNodes = 0;
+
+  // Memory taken by the binary and wide nodes, the leaf primitive records
+  // and the primitive references.
+  size_t nodeBytes = 0, wideNodeBytes = 0, recordBytes = 0,
+         primitiveBytes = 0;
+};
+
+BVHMetrics ComputeBVHMetrics(const BVHAccelerator &bvh);
+void ReportBVHMetrics(FILE *out, const BVHMetrics &metrics);
+
+#endif  // PHR_ACCELERATORS_BVHMETRICS_H
@@ -0,0 +1,124 @@
+#include "accelerators/primitiverecords.h"
+
+#include <stdexcept>
+
+#include "accelerators/bvh.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+
+static RecordType classify(const Primitive &prim) {
+  auto *gp = dynamic_cast<const GeometricPrimitive *>(&prim);
+  const Shape *shape = gp ? gp->GetShape() : nullptr;
+  if (!shape) return RecordType::Primitive;
+
+  if (auto *tri = dynamic_cast<const Triangle *>(shape)) {
+    // Triangle::intersect() rejects hits on triangles with no geometric
+    // normal that IntersectTriangle() alone accepts; such slivers keep going
+    // through their Primitive so the record kernel never disagrees.
+    const TriangleMesh &mesh = tri->GetMesh();
+    const int *v = &mesh.vertexIndices[3 * tri->TriangleIndex()];
+    const Point3f &p0 = mesh.p[v[0]];
+    const Point3f &p1 = mesh.p[v[1]];
+    const Point3f &p2 = mesh.p[v[2]];
+    Vector3f ng = Cross(Vector3f(p2 - p0), Vector3f(p1 - p0));
+    return ng.lengthSquared() == 0 ? RecordType::Primitive
+                                   : RecordType::Triangle;
+  }
+
+  if (dynamic_cast<const Sphere *>(shape)) {
+    // Sphere records are intersected in world space, which only works for
+    // translations.
+    const glm::mat4 &m = shape->worldToObject->GetMatrix();
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 3; ++j)
+        if (m[i][j] != (i == j ? 1.f : 0.f)) return RecordType::Primitive;
+    if (m[3][3] != 1) return RecordType::Primitive;
+    return RecordType::Sphere;
+  }
+  return RecordType::Primitive;
+}
+
+void PrimitiveRecords::Build(
+    std::vector<std::shared_ptr<Primitive>> *primitives,
+    const LinearBVHNode *nodes, int totalNodes) {
+  size_t nPrimitives = primitives->size();
+  if (nPrimitives > IndexMask)
+    throw std::runtime_error("PrimitiveRecords: too many primitives.\n");
+  std::vector<RecordType> types(nPrimitives);
+  for (size_t i = 0; i < nPrimitives; ++i)
+    types[i] = classify(*(*primitives)[i]);
+
+  // Leaves are small, so a stable insertion sort does.
+  for (int n = 0; n < totalNodes; ++n) {
+    const LinearBVHNode &node = nodes[n];
+    int begin = node.primitivesOffset, end = begin + node.nPrimitives;
+    if (node.nPrimitives == 0) continue;
+    for (int i = begin + 1; i < end; ++i) {
+      for (int j = i; j > begin && types[j] < types[j - 1]; --j) {
+        std::swap(types[j], types[j - 1]);
+        std::swap((*primitives)[j], (*primitives)[j - 1]);
+      }
+    }
+  }
+
+  refs.resize(nPrimitives);
+  centerX.clear();
+  centerY.clear();
+  centerZ.clear();
+  radius.clear();
+  sphereClip.clear();
+  triangles.clear();
+  for (size_t i = 0; i < nPrimitives; ++i) {
+    uint32_t index = 0;
+    const Shape *shape =
+        types[i] == RecordType::Primitive
+            ? nullptr
+            : static_cast<const GeometricPrimitive &>(*(*primitives)[i])
+                  .GetShape();
+    if (types[i] == RecordType::Sphere) {
+      auto *sphere = static_cast<const Sphere *>(shape);
+      const glm::mat4 &m = shape->worldToObject->GetMatrix();
+      // Subtracting the negated translation rounds exactly like the
+      // world-to-object transform adding it.
+      index = sphereClip.size();
+      centerX.push_back(-m[0][3]);
+      centerY.push_back(-m[1][3]);
+      centerZ.push_back(-m[2][3]);
+      radius.push_back(sphere->Radius());
+      sphereClip.push_back(
+          {sphere->ZMin(), sphere->ZMax(), sphere->PhiMax()});
+    } else if (types[i] == RecordType::Triangle) {
+      auto *tri = static_cast<const Triangle *>(shape);
+      const TriangleMesh &mesh = tri->GetMesh();
+      const int *v = &mesh.vertexIndices[3 * tri->TriangleIndex()];
+      index = triangles.size();
+      triangles.push_back({mesh.p[v[0]], mesh.p[v[1]], mesh.p[v[2]]});
+    }
+    refs[i] = uint32_t(types[i]) << IndexBits | index;
+  }
+  for (std::vector<Float> *v : {&centerX, &centerY, &centerZ, &radius})
+    v->resize(sphereClip.size() + SphereBatch, 0);
+
+  storage.reset();
+  arrays.refs = refs.data();
+  arrays.centerX = centerX.data();
+  arrays.centerY = centerY.data();
+  arrays.centerZ = centerZ.data();
+  arrays.radius = radius.data();
+  arrays.sphereClip = sphereClip.data();
+  arrays.triangles = triangles.data();
+  arrays.nPrimitives = int(nPrimitives);
+  arrays.nSpheres = int(sphereClip.size());
+  arrays.nTriangles = int(triangles.size());
+}
+
+void PrimitiveRecords::Adopt(const Arrays &adopted,
+                             std::shared_ptr<const void> adoptedStorage) {
+  for (std::vector<Float> *v : {&centerX, &centerY, &centerZ, &radius})
+    std::vector<Float>().swap(*v);
+  std::vector<uint32_t>().swap(refs);
+  std::vector<SphereClip>().swap(sphereClip);
+  std::vector<TriangleRecord>().swap(triangles);
+  arrays = adopted;
+  storage = std::move(adoptedStorage);
+}
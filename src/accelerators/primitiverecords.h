@@ -0,0 +1,214 @@
+#ifndef PHR_ACCELERATORS_PRIMITIVERECORDS_H
+#define PHR_ACCELERATORS_PRIMITIVERECORDS_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/geometry.h"
+#include "core/phr.h"
+#include "core/primitive.h"
+#include "core/simd.h"
+#include "shapes/sphere.h"
+
+struct LinearBVHNode;
+
+// Compact copies of the geometry BVH leaves test, so a leaf loop reads its
+// spheres and triangles from contiguous arrays and intersects them inline
+// instead of going through a shared_ptr<Primitive>, a virtual Intersect(), a
+// shared_ptr<Shape> and a virtual intersect() per primitive.
+//
+// The Primitive array stays the owner. Records carry no pointers; once the
+// closest hit is known, the BVH asks that one Primitive to fill in the
+// SurfaceInteraction. Shapes without a record type are tested through their
+// Primitive as before.
+
+// The clipping parameters of a sphere record, read only for the spheres
+// that survive the SIMD cull.
+struct SphereClip {
+  Float zMin, zMax, phiMax;
+};
+
+// A triangle, with its world-space vertices copied out of the mesh.
+struct TriangleRecord {
+  Point3f p0, p1, p2;
+};
+
+enum class RecordType : uint8_t { Sphere, Triangle, Primitive };
+
+class PrimitiveRecords {
+ public:
+  // The arrays the records are read from. The sphere arrays are structure
+  // of arrays, padded by SphereBatch entries so a batch can be loaded from
+  // any starting sphere.
+  struct Arrays {
+    const uint32_t *refs = nullptr;
+    const Float *centerX = nullptr, *centerY = nullptr, *centerZ = nullptr,
+                *radius = nullptr;
+    const SphereClip *sphereClip = nullptr;
+    const TriangleRecord *triangles = nullptr;
+    int nPrimitives = 0, nSpheres = 0, nTriangles = 0;
+  };
+
+  PrimitiveRecords() = default;
+  // _arrays_ may point into the records' own storage.
+  PrimitiveRecords(const PrimitiveRecords &) = delete;
+  PrimitiveRecords &operator=(const PrimitiveRecords &) = delete;
+
+  // Sorts the primitives of every leaf in _nodes_ by record type, so each
+  // leaf holds a run of spheres, then triangles, then everything else, and
+  // builds the records in that order.
+  void Build(std::vector<std::shared_ptr<Primitive>> *primitives,
+             const LinearBVHNode *nodes, int totalNodes);
+  // Reads the records from _arrays_, such as the pages of a mapped scene
+  // cache, without copying them; _storage_ keeps them alive. They must have
+  // been built for the same primitives in the same order.
+  void Adopt(const Arrays &arrays, std::shared_ptr<const void> storage);
+  const Arrays &Data() const { return arrays; }
+
+  // Primitive _i_, in BVH order, is of type Type(i) and, unless that is
+  // RecordType::Primitive, stored at Index(i) in the array for its type.
+  // The spheres of one leaf have consecutive indices.
+  RecordType Type(int i) const {
+    return RecordType(arrays.refs[i] >> IndexBits);
+  }
+  int Index(int i) const { return int(arrays.refs[i] & IndexMask); }
+  const TriangleRecord *Triangles() const { return arrays.triangles; }
+  int SphereCount() const { return arrays.nSpheres; }
+  int TriangleCount() const { return arrays.nTriangles; }
+
+  // The most spheres CullSpheres() tests at once.
+#if defined(PHR_HAVE_AVX) && !defined(PHR_FLOAT_AS_DOUBLE)
+  static constexpr int SphereBatch = 8;
+#else
+  static constexpr int SphereBatch = 4;
+#endif
+
+  // Returns a mask with bit _i_ set if sphere _first_ + _i_, for _i_ <
+  // _n_ <= SphereBatch, may be hit in (0, ray.tMax]. Every sphere is tested
+  // at once, in single precision and ignoring clipping; the bounds used are
+  // loose enough that a sphere IntersectSphere() would hit is never culled.
+  int CullSpheres(const Ray &ray, int first, int n) const;
+  // The exact test for one sphere, identical to Sphere::intersect().
+  bool IntersectSphere(const Ray &ray, int index, Float *tHit) const {
+    Point3f o(ray.o.x - arrays.centerX[index], ray.o.y - arrays.centerY[index],
+              ray.o.z - arrays.centerZ[index]);
+    const SphereClip &clip = arrays.sphereClip[index];
+    return ::IntersectSphere(o, ray.d, ray.tMax, arrays.radius[index],
+                             clip.zMin, clip.zMax, clip.phiMax, tHit);
+  }
+
+  size_t BytesUsed() const {
+    if (!arrays.refs) return 0;
+    return arrays.nPrimitives * sizeof(uint32_t) +
+           4 * (arrays.nSpheres + SphereBatch) * sizeof(Float) +
+           arrays.nSpheres * sizeof(SphereClip) +
+           arrays.nTriangles * sizeof(TriangleRecord);
+  }
+
+  static constexpr int IndexBits = 30;
+  static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+
+ private:
+  Arrays arrays;
+  // Filled by Build(); adopted records live in _storage_ instead.
+  std::vector<uint32_t> refs;
+  std::vector<Float> centerX, centerY, centerZ, radius;
+  std::vector<SphereClip> sphereClip;
+  std::vector<TriangleRecord> triangles;
+  std::shared_ptr<const void> storage;
+};
+
+#if defined(PHR_HAVE_SSE) && !defined(PHR_FLOAT_AS_DOUBLE)
+
+// The hit distances of a ray o + t * d against a sphere are
+// (-b +- sqrt(b^2 - a * c)) / a with a = d.d, b = d.(o - center) and
+// c = |o - center|^2 - r^2. Single precision errors in the discriminant
+// stay far below _tolerance_, relative to the magnitude of its terms, so
+// widening it by that much gives bounds on t that hold for the exact test.
+static constexpr float SphereCullTolerance = 1e-4f;
+
+inline int PrimitiveRecords::CullSpheres(const Ray &ray, int first,
+                                         int n) const {
+  float dd = ray.d.x * ray.d.x + ray.d.y * ray.d.y + ray.d.z * ray.d.z;
+#ifdef PHR_HAVE_AVX
+  if (n > 4) {
+    __m256 ox = _mm256_sub_ps(_mm256_set1_ps(ray.o.x),
+                              _mm256_loadu_ps(&arrays.centerX[first]));
+    __m256 oy = _mm256_sub_ps(_mm256_set1_ps(ray.o.y),
+                              _mm256_loadu_ps(&arrays.centerY[first]));
+    __m256 oz = _mm256_sub_ps(_mm256_set1_ps(ray.o.z),
+                              _mm256_loadu_ps(&arrays.centerZ[first]));
+    __m256 r = _mm256_loadu_ps(&arrays.radius[first]);
+    __m256 a = _mm256_set1_ps(dd);
+    __m256 b = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ray.d.x), ox),
+                      _mm256_mul_ps(_mm256_set1_ps(ray.d.y), oy)),
+        _mm256_mul_ps(_mm256_set1_ps(ray.d.z), oz));
+    __m256 oc2 = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)),
+        _mm256_mul_ps(oz, oz));
+    __m256 r2 = _mm256_mul_ps(r, r);
+    __m256 b2 = _mm256_mul_ps(b, b);
+    __m256 discrim =
+        _mm256_sub_ps(b2, _mm256_mul_ps(a, _mm256_sub_ps(oc2, r2)));
+    __m256 tolerance = _mm256_mul_ps(
+        _mm256_set1_ps(SphereCullTolerance),
+        _mm256_add_ps(b2, _mm256_mul_ps(a, _mm256_add_ps(oc2, r2))));
+    __m256 s = _mm256_sqrt_ps(_mm256_add_ps(
+        _mm256_max_ps(discrim, _mm256_setzero_ps()), tolerance));
+    __m256 invA = _mm256_set1_ps(1 / dd);
+    __m256 tLow = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(
+                                    _mm256_setzero_ps(), b), s), invA);
+    __m256 tHigh = _mm256_mul_ps(_mm256_sub_ps(s, b), invA);
+    __m256 mask = _mm256_and_ps(
+        _mm256_cmp_ps(discrim, _mm256_sub_ps(_mm256_setzero_ps(), tolerance),
+                      _CMP_GE_OQ),
+        _mm256_and_ps(
+            _mm256_cmp_ps(tLow, _mm256_set1_ps(ray.tMax), _CMP_LE_OQ),
+            _mm256_cmp_ps(tHigh, _mm256_setzero_ps(), _CMP_GT_OQ)));
+    return _mm256_movemask_ps(mask) & ((1 << n) - 1);
+  }
+#endif  // PHR_HAVE_AVX
+  __m128 ox = _mm_sub_ps(_mm_set1_ps(ray.o.x),
+                         _mm_loadu_ps(&arrays.centerX[first]));
+  __m128 oy = _mm_sub_ps(_mm_set1_ps(ray.o.y),
+                         _mm_loadu_ps(&arrays.centerY[first]));
+  __m128 oz = _mm_sub_ps(_mm_set1_ps(ray.o.z),
+                         _mm_loadu_ps(&arrays.centerZ[first]));
+  __m128 r = _mm_loadu_ps(&arrays.radius[first]);
+  __m128 a = _mm_set1_ps(dd);
+  __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(ray.d.x), ox),
+                                   _mm_mul_ps(_mm_set1_ps(ray.d.y), oy)),
+                        _mm_mul_ps(_mm_set1_ps(ray.d.z), oz));
+  __m128 oc2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)),
+                          _mm_mul_ps(oz, oz));
+  __m128 r2 = _mm_mul_ps(r, r);
+  __m128 b2 = _mm_mul_ps(b, b);
+  __m128 discrim = _mm_sub_ps(b2, _mm_mul_ps(a, _mm_sub_ps(oc2, r2)));
+  __m128 tolerance =
+      _mm_mul_ps(_mm_set1_ps(SphereCullTolerance),
+                 _mm_add_ps(b2, _mm_mul_ps(a, _mm_add_ps(oc2, r2))));
+  __m128 s = _mm_sqrt_ps(
+      _mm_add_ps(_mm_max_ps(discrim, _mm_setzero_ps()), tolerance));
+  __m128 invA = _mm_set1_ps(1 / dd);
+  __m128 tLow =
+      _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), b), s), invA);
+  __m128 tHigh = _mm_mul_ps(_mm_sub_ps(s, b), invA);
+  __m128 mask = _mm_and_ps(
+      _mm_cmpge_ps(discrim, _mm_sub_ps(_mm_setzero_ps(), tolerance)),
+      _mm_and_ps(_mm_cmple_ps(tLow, _mm_set1_ps(ray.tMax)),
+                 _mm_cmpgt_ps(tHigh, _mm_setzero_ps())));
+  return _mm_movemask_ps(mask) & ((1 << n) - 1);
+}
+
+#else
+
+inline int PrimitiveRecords::CullSpheres(const Ray &ray, int first,
+                                         int n) const {
+  return (1 << n) - 1;
+}
+
+#endif  // PHR_HAVE_SSE && !PHR_FLOAT_AS_DOUBLE
+
+#endif  // PHR_ACCELERATORS_PRIMITIVERECORDS_H
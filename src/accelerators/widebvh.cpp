@@ -0,0 +1,83 @@
+#include "accelerators/widebvh.h"
+
+#include <vector>
+
+#include "accelerators/bvh.h"
+#include "core/AllocAligned.h"
+
+// Builds the wide node for binary node _index_ by repeatedly opening the
+// interior child with the largest surface area until N slots are used.
+template <int N>
+static int collapse(const LinearBVHNode *binaryNodes, int index,
+                    std::vector<WideBVHNode<N>> *wideNodes) {
+  int myIndex = wideNodes->size();
+  wideNodes->emplace_back();
+
+  int slots[N], nSlots = 0;
+  const LinearBVHNode &root = binaryNodes[index];
+  if (root.nPrimitives > 0) {
+    slots[nSlots++] = index;
+  } else {
+    slots[nSlots++] = index + 1;
+    slots[nSlots++] = root.secondChildOffset;
+  }
+  while (nSlots < N) {
+    int best = -1;
+    Float bestArea = -1;
+    for (int i = 0; i < nSlots; ++i) {
+      const LinearBVHNode &node = binaryNodes[slots[i]];
+      if (node.nPrimitives == 0 && node.bounds.SurfaceArea() > bestArea) {
+        best = i;
+        bestArea = node.bounds.SurfaceArea();
+      }
+    }
+    if (best < 0) break;
+    int opened = slots[best];
+    slots[best] = opened + 1;
+    slots[nSlots++] = binaryNodes[opened].secondChildOffset;
+  }
+
+  WideBVHNode<N> wide;
+  for (int a = 0; a < 6; ++a)
+    for (int i = 0; i < N; ++i) wide.bounds[a][i] = 0;
+  wide.nChildren = nSlots;
+  for (int i = 0; i < N; ++i) {
+    wide.child[i] = -1;
+    wide.nPrimitives[i] = 0;
+  }
+  for (int i = 0; i < nSlots; ++i) {
+    const LinearBVHNode &node = binaryNodes[slots[i]];
+    for (int a = 0; a < 3; ++a) {
+      wide.bounds[2 * a][i] = node.bounds.pMin[a];
+      wide.bounds[2 * a + 1][i] = node.bounds.pMax[a];
+    }
+    if (node.nPrimitives > 0) {
+      wide.child[i] = node.primitivesOffset;
+      wide.nPrimitives[i] = node.nPrimitives;
+    }
+  }
+  // _wideNodes_ may reallocate while the children are collapsed
+  for (int i = 0; i < nSlots; ++i)
+    if (wide.nPrimitives[i] == 0)
+      wide.child[i] = collapse<N>(binaryNodes, slots[i], wideNodes);
+  (*wideNodes)[myIndex] = wide;
+  return myIndex;
+}
+
+template <int N>
+WideBVH<N>::WideBVH(const LinearBVHNode *binaryNodes) {
+  if (!binaryNodes) return;
+  std::vector<WideBVHNode<N>> wideNodes;
+  collapse<N>(binaryNodes, 0, &wideNodes);
+  nNodes = wideNodes.size();
+  nodes = AllocAligned<WideBVHNode<N>>(nNodes);
+  std::copy(wideNodes.begin(), wideNodes.end(), nodes);
+}
+
+template <int N>
+WideBVH<N>::~WideBVH() {
+  FreeAligned(nodes);
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,207 @@
+#ifndef PHR_ACCELERATORS_WIDEBVH_H
+#define PHR_ACCELERATORS_WIDEBVH_H
+
+#include <cstdint>
+
+#include "core/geometry.h"
+#include "core/phr.h"
+#include "core/simd.h"
+#include "core/stats.h"
+
+enum class BVHLayout { Binary, Wide4, Wide8 };
+
+struct LinearBVHNode;
+
+// A node with up to N children whose bounds are stored as structure of
+// arrays, so one slab test covers every child. Valid children occupy the
+// first _nChildren_ slots. For a leaf child, _child_ is the offset of its
+// first primitive and _nPrimitives_ is non-zero; otherwise _child_ indexes
+// another WideBVHNode.
+template <int N>
+struct alignas(64) WideBVHNode {
+  // minX, maxX, minY, maxY, minZ, maxZ
+  float bounds[6][N];
+  int32_t child[N];
+  uint16_t nPrimitives[N];
+  uint8_t nChildren;
+};
+
+// Ray data splatted once per traversal.
+struct WideRay {
+  explicit WideRay(const Ray &ray) {
+    for (int i = 0; i < 3; ++i) {
+      o[i] = ray.o[i];
+      invDir[i] = 1 / ray.d[i];
+    }
+  }
+  float o[3], invDir[3];
+};
+
+// Slab test against every child of _node_. Returns a bit mask of the
+// children hit within [0, tMax] and writes their entry distances to _tNear_.
+template <int N>
+inline int IntersectChildren(const WideBVHNode<N> &node, const WideRay &r,
+                             float tMax, float tNear[N]) {
+  const float farScale = 1 + 2 * gamma(3);
+  int mask = 0;
+  for (int i = 0; i < node.nChildren; ++i) {
+    float t0 = 0, t1 = tMax;
+    for (int a = 0; a < 3; ++a) {
+      float tA = (node.bounds[2 * a][i] - r.o[a]) * r.invDir[a];
+      float tB = (node.bounds[2 * a + 1][i] - r.o[a]) * r.invDir[a];
+      if (tA > tB) std::swap(tA, tB);
+      t0 = tA > t0 ? tA : t0;
+      t1 = tB * farScale < t1 ? tB * farScale : t1;
+    }
+    tNear[i] = t0;
+    if (t0 <= t1) mask |= 1 << i;
+  }
+  return mask;
+}
+
+#ifdef PHR_HAVE_SSE
+template <>
+inline int IntersectChildren<4>(const WideBVHNode<4> &node, const WideRay &r,
+                                float tMax, float tNear[4]) {
+  const __m128 farScale = _mm_set1_ps(1 + 2 * gamma(3));
+  __m128 t0 = _mm_setzero_ps(), t1 = _mm_set1_ps(tMax);
+  for (int a = 0; a < 3; ++a) {
+    __m128 o = _mm_set1_ps(r.o[a]), invDir = _mm_set1_ps(r.invDir[a]);
+    __m128 tA = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[2 * a]), o),
+                           invDir);
+    __m128 tB = _mm_mul_ps(
+        _mm_sub_ps(_mm_load_ps(node.bounds[2 * a + 1]), o), invDir);
+    t0 = _mm_max_ps(t0, _mm_min_ps(tA, tB));
+    t1 = _mm_min_ps(t1, _mm_mul_ps(_mm_max_ps(tA, tB), farScale));
+  }
+  _mm_storeu_ps(tNear, t0);
+  return _mm_movemask_ps(_mm_cmple_ps(t0, t1)) & ((1 << node.nChildren) - 1);
+}
+#endif  // PHR_HAVE_SSE
+
+#ifdef PHR_HAVE_AVX
+template <>
+inline int IntersectChildren<8>(const WideBVHNode<8> &node, const WideRay &r,
+                                float tMax, float tNear[8]) {
+  const __m256 farScale = _mm256_set1_ps(1 + 2 * gamma(3));
+  __m256 t0 = _mm256_setzero_ps(), t1 = _mm256_set1_ps(tMax);
+  for (int a = 0; a < 3; ++a) {
+    __m256 o = _mm256_set1_ps(r.o[a]), invDir = _mm256_set1_ps(r.invDir[a]);
+    __m256 tA = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_load_ps(node.bounds[2 * a]), o), invDir);
+    __m256 tB = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_load_ps(node.bounds[2 * a + 1]), o), invDir);
+    t0 = _mm256_max_ps(t0, _mm256_min_ps(tA, tB));
+    t1 = _mm256_min_ps(t1, _mm256_mul_ps(_mm256_max_ps(tA, tB), farScale));
+  }
+  _mm256_storeu_ps(tNear, t0);
+  return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)) &
+         ((1 << node.nChildren) - 1);
+}
+#elif defined(PHR_HAVE_SSE)
+// Without AVX, eight children are tested as two SSE halves of four.
+template <>
+inline int IntersectChildren<8>(const WideBVHNode<8> &node, const WideRay &r,
+                                float tMax, float tNear[8]) {
+  const __m128 farScale = _mm_set1_ps(1 + 2 * gamma(3));
+  int mask = 0;
+  for (int half = 0; half < 2; ++half) {
+    const int i = 4 * half;
+    __m128 t0 = _mm_setzero_ps(), t1 = _mm_set1_ps(tMax);
+    for (int a = 0; a < 3; ++a) {
+      __m128 o = _mm_set1_ps(r.o[a]), invDir = _mm_set1_ps(r.invDir[a]);
+      __m128 tA = _mm_mul_ps(
+          _mm_sub_ps(_mm_load_ps(&node.bounds[2 * a][i]), o), invDir);
+      __m128 tB = _mm_mul_ps(
+          _mm_sub_ps(_mm_load_ps(&node.bounds[2 * a + 1][i]), o), invDir);
+      t0 = _mm_max_ps(t0, _mm_min_ps(tA, tB));
+      t1 = _mm_min_ps(t1, _mm_mul_ps(_mm_max_ps(tA, tB), farScale));
+    }
+    _mm_storeu_ps(&tNear[i], t0);
+    mask |= _mm_movemask_ps(_mm_cmple_ps(t0, t1)) << i;
+  }
+  return mask & ((1 << node.nChildren) - 1);
+}
+#endif  // PHR_HAVE_AVX
+
+// An N-wide BVH collapsed from a flattened binary BVH. Leaves keep the
+// binary tree's primitive offsets, so both layouts index the same primitive
+// array.
+template <int N>
+class WideBVH {
+ public:
+  explicit WideBVH(const LinearBVHNode *binaryNodes);
+  ~WideBVH();
+  WideBVH(const WideBVH &) = delete;
+  WideBVH &operator=(const WideBVH &) = delete;
+
+  // Visits leaves near to far, calling _intersectLeaf(offset, count)_, which
+  // returns true on a hit and is expected to shrink _ray.tMax_. With _anyHit_
+  // set, traversal stops at the first hit.
+  template <typename IntersectLeaf>
+  bool Intersect(const Ray &ray, IntersectLeaf intersectLeaf,
+                 bool anyHit) const;
+
+  int NodeCount() const { return nNodes; }
+
+ private:
+  WideBVHNode<N> *nodes = nullptr;
+  int nNodes = 0;
+};
+
+template <int N>
+template <typename IntersectLeaf>
+bool WideBVH<N>::Intersect(const Ray &ray, IntersectLeaf intersectLeaf,
+                           bool anyHit) const {
+  if (!nodes) return false;
+  struct StackEntry {
+    int32_t index;
+    uint16_t nPrimitives;
+    float tNear;
+  };
+  // Every level pops one entry and pushes at most N.
+  StackEntry toVisit[64 * N];
+  int toVisitOffset = 0;
+  toVisit[toVisitOffset++] = {0, 0, 0.f};
+
+  WideRay wideRay(ray);
+  bool hit = false;
+  while (toVisitOffset > 0) {
+    const StackEntry entry = toVisit[--toVisitOffset];
+    if (entry.tNear > ray.tMax) continue;
+    if (entry.nPrimitives > 0) {
+      PHR_STAT_INC(LeafVisits);
+      if (intersectLeaf(entry.index, entry.nPrimitives)) {
+        hit = true;
+        if (anyHit) return true;
+      }
+      continue;
+    }
+
+    const WideBVHNode<N> &node = nodes[entry.index];
+    PHR_STAT_INC(NodesVisited);
+    PHR_STAT_ADD(BoxTests, node.nChildren);
+    float tNear[N];
+    int mask = IntersectChildren<N>(node, wideRay, ray.tMax, tNear);
+
+    // Push the children far to near so the nearest one is visited first
+    int order[N], nHit = 0;
+    for (int i = 0; i < node.nChildren; ++i) {
+      if (!(mask & (1 << i))) continue;
+      int j = nHit++;
+      while (j > 0 && tNear[order[j - 1]] < tNear[i]) {
+        order[j] = order[j - 1];
+        --j;
+      }
+      order[j] = i;
+    }
+    for (int k = 0; k < nHit; ++k) {
+      int i = order[k];
+      toVisit[toVisitOffset++] = {node.child[i], node.nPrimitives[i],
+                                  tNear[i]};
+    }
+  }
+  return hit;
+}
+
+#endif  // PHR_ACCELERATORS_WIDEBVH_H
@@ -0,0 +1,414 @@
+// Micro-benchmarks for the intersection hot paths. Results are written as
+// Google Benchmark JSON by default so runs can be diffed for regressions:
+//
+//   phr_bench [--benchmark_filter=regex] [--benchmark_out=results.json]
+//             [--benchmark_format=console|json|csv]
+//
+// The BVH benchmarks run on synthetic scenes of 1K to 10M spheres; the 10M
+// scenes need several GB of memory, so leave them out on small machines with
+// --benchmark_filter=-spheres:10000000.
+//
+// BM_SamplerConvergence reports, as the "rmse" counter, the error each
+// sampler leaves in a per-pixel integral at a given sample count, next to
+// std::mt19937 as the baseline.
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "accelerators/bvh.h"
+#include "core/Efloat.h"
+#include "core/geometry.h"
+#include "core/interaction.h"
+#include "core/primitive.h"
+#include "core/sampler.h"
+#include "core/transform.h"
+#include "core/transformcache.h"
+#include "shapes/sphere.h"
+
+namespace {
+
+// Number of distinct inputs each kernel benchmark cycles through, so the
+// branch predictor cannot learn a single outcome.
+constexpr int nInputs = 1024;
+
+Vector3f randomDirection(std::mt19937 &rng) {
+  std::normal_distribution<Float> normal;
+  Vector3f d;
+  do {
+    d = Vector3f(normal(rng), normal(rng), normal(rng));
+  } while (d.lengthSquared() == 0);
+  return Normalize(d);
+}
+
+// Rays from random points in [-extent, extent]^3 aimed at random points in
+// [-target, target]^3, so a tunable fraction of them hit a shape at the
+// origin.
+std::vector<Ray> makeRays(int count, Float extent, Float target,
+                          uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<Float> origin(-extent, extent);
+  std::uniform_real_distribution<Float> aim(-target, target);
+  std::vector<Ray> rays;
+  rays.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    Point3f o(origin(rng), origin(rng), origin(rng));
+    Point3f p(aim(rng), aim(rng), aim(rng));
+    Vector3f d = p - o;
+    if (d.lengthSquared() == 0) d = randomDirection(rng);
+    rays.push_back(Ray(o, Normalize(d)));
+  }
+  return rays;
+}
+
+// Rays starting outside the unit sphere, about half of which hit it.
+struct SphereFixture {
+  SphereFixture()
+      : objectToWorld(Translate(Vector3f(0.5f, -0.25f, 1))),
+        worldToObject(Inverse(objectToWorld)),
+        sphere(&objectToWorld, &worldToObject, false, 1, -1, 1, 360),
+        rays(makeRays(nInputs, 8, 1.5f, 7)) {
+    for (Ray &r : rays) r.o = r.o + Vector3f(0.5f, -0.25f, 1);
+  }
+
+  Transform objectToWorld, worldToObject;
+  Sphere sphere;
+  std::vector<Ray> rays;
+};
+
+const SphereFixture &sphereFixture() {
+  static SphereFixture fixture;
+  return fixture;
+}
+
+void BM_SphereIntersect(benchmark::State &state) {
+  const SphereFixture &f = sphereFixture();
+  int i = 0, hits = 0;
+  for (auto _ : state) {
+    Float tHit;
+    SurfaceInteraction isect;
+    hits += f.sphere.intersect(f.rays[i], &tHit, &isect, false);
+    benchmark::DoNotOptimize(isect);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hitRate"] = Float(hits) / state.iterations();
+}
+BENCHMARK(BM_SphereIntersect);
+
+void BM_SphereIntersectP(benchmark::State &state) {
+  const SphereFixture &f = sphereFixture();
+  int i = 0, hits = 0;
+  for (auto _ : state) {
+    bool hit = f.sphere.intersectP(f.rays[i], false);
+    benchmark::DoNotOptimize(hit);
+    hits += hit;
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hitRate"] = Float(hits) / state.iterations();
+}
+BENCHMARK(BM_SphereIntersectP);
+
+struct BoundsFixture {
+  BoundsFixture()
+      : bounds(Point3f(-1, -1, -1), Point3f(1, 1, 1)),
+        rays(makeRays(nInputs, 8, 1.5f, 11)) {
+    for (const Ray &r : rays) {
+      Vector3f invDir(1 / r.d.x, 1 / r.d.y, 1 / r.d.z);
+      invDirs.push_back(invDir);
+      dirIsNeg.push_back({invDir.x < 0, invDir.y < 0, invDir.z < 0});
+    }
+  }
+
+  Bounds3f bounds;
+  std::vector<Ray> rays;
+  std::vector<Vector3f> invDirs;
+  std::vector<std::array<int, 3>> dirIsNeg;
+};
+
+const BoundsFixture &boundsFixture() {
+  static BoundsFixture fixture;
+  return fixture;
+}
+
+void BM_Bounds3IntersectP(benchmark::State &state) {
+  const BoundsFixture &f = boundsFixture();
+  int i = 0;
+  for (auto _ : state) {
+    Float t0 = 0, t1 = 0;
+    bool hit = f.bounds.IntersectP(f.rays[i], &t0, &t1);
+    benchmark::DoNotOptimize(hit);
+    benchmark::DoNotOptimize(t0);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Bounds3IntersectP);
+
+void BM_Bounds3IntersectPInvDir(benchmark::State &state) {
+  const BoundsFixture &f = boundsFixture();
+  int i = 0;
+  for (auto _ : state) {
+    bool hit = f.bounds.IntersectP(f.rays[i], f.invDirs[i],
+                                   f.dirIsNeg[i].data());
+    benchmark::DoNotOptimize(hit);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Bounds3IntersectPInvDir);
+
+void BM_TransformRay(benchmark::State &state) {
+  const SphereFixture &f = sphereFixture();
+  int i = 0;
+  for (auto _ : state) {
+    Vector3f oErr, dErr;
+    Ray r = f.worldToObject(f.rays[i], &oErr, &dErr);
+    benchmark::DoNotOptimize(r);
+    benchmark::DoNotOptimize(oErr);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransformRay);
+
+// Coefficients of the sphere quadratic for the fixture rays, so both solvers
+// see the same mix of real and complex roots.
+struct QuadraticFixture {
+  QuadraticFixture() {
+    for (const Ray &r : sphereFixture().rays) {
+      Float a = Dot(r.d, r.d);
+      Float b = 2 * Dot(r.d, Vector3f(r.o));
+      Float c = Dot(Vector3f(r.o), Vector3f(r.o)) - 1;
+      coefficients.push_back({a, b, c});
+    }
+  }
+  std::vector<std::array<Float, 3>> coefficients;
+};
+
+const QuadraticFixture &quadraticFixture() {
+  static QuadraticFixture fixture;
+  return fixture;
+}
+
+void BM_Quadratic(benchmark::State &state) {
+  const QuadraticFixture &f = quadraticFixture();
+  int i = 0;
+  for (auto _ : state) {
+    const std::array<Float, 3> &c = f.coefficients[i];
+    Float t0 = 0, t1 = 0;
+    bool found = Quadratic(c[0], c[1], c[2], &t0, &t1);
+    benchmark::DoNotOptimize(found);
+    benchmark::DoNotOptimize(t0);
+    benchmark::DoNotOptimize(t1);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Quadratic);
+
+void BM_QuadraticEFloat(benchmark::State &state) {
+  const QuadraticFixture &f = quadraticFixture();
+  int i = 0;
+  for (auto _ : state) {
+    const std::array<Float, 3> &c = f.coefficients[i];
+    EFloat t0(0), t1(0);
+    bool found =
+        Quadratic(EFloat(c[0]), EFloat(c[1]), EFloat(c[2]), &t0, &t1);
+    benchmark::DoNotOptimize(found);
+    benchmark::DoNotOptimize(t0);
+    benchmark::DoNotOptimize(t1);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QuadraticEFloat);
+
+// _n_ spheres scattered in a unit-density cube, sized so they cover a
+// similar fraction of it at every scale.
+struct SphereScene {
+  explicit SphereScene(int n) {
+    std::mt19937 rng(n);
+    Float extent = std::cbrt(Float(n));
+    std::uniform_real_distribution<Float> pos(-extent / 2, extent / 2);
+    std::uniform_real_distribution<Float> radius(0.1f, 0.4f);
+    primitives.reserve(n);
+    for (int i = 0; i < n; ++i) {
+      const Transform *o2w, *w2o;
+      transforms.Lookup(Translate(Vector3f(pos(rng), pos(rng), pos(rng))),
+                        &o2w, &w2o);
+      Float r = radius(rng);
+      primitives.push_back(std::make_shared<GeometricPrimitive>(
+          std::make_shared<Sphere>(o2w, w2o, false, r, -r, r, 360), nullptr,
+          nullptr));
+    }
+    rays = makeRays(nInputs, extent, extent / 2, n + 1);
+  }
+
+  TransformCache transforms;
+  std::vector<std::shared_ptr<Primitive>> primitives;
+  std::vector<Ray> rays;
+};
+
+// Scenes are generated once per size and shared by every BVH benchmark.
+const SphereScene &sphereScene(int n) {
+  static std::map<int, std::unique_ptr<SphereScene>> scenes;
+  std::unique_ptr<SphereScene> &scene = scenes[n];
+  if (!scene) scene = std::make_unique<SphereScene>(n);
+  return *scene;
+}
+
+void BM_BVHBuild(benchmark::State &state) {
+  const SphereScene &scene = sphereScene(int(state.range(0)));
+  BVHSplitMethod splitMethod = BVHSplitMethod(state.range(1));
+  for (auto _ : state) {
+    BVHAccelerator bvh(scene.primitives, 4, splitMethod);
+    benchmark::DoNotOptimize(bvh.WorldBound());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Traversal benchmarks reuse one SAH tree per scene size and layout.
+const BVHAccelerator &sphereBVH(int n, BVHLayout layout) {
+  static std::map<std::pair<int, int>, std::unique_ptr<BVHAccelerator>> bvhs;
+  std::unique_ptr<BVHAccelerator> &bvh = bvhs[{n, int(layout)}];
+  if (!bvh)
+    bvh = std::make_unique<BVHAccelerator>(sphereScene(n).primitives, 4,
+                                           BVHSplitMethod::SAH, true, layout);
+  return *bvh;
+}
+
+void BM_BVHIntersect(benchmark::State &state) {
+  const SphereScene &scene = sphereScene(int(state.range(0)));
+  const BVHAccelerator &bvh =
+      sphereBVH(int(state.range(0)), BVHLayout(state.range(1)));
+  int i = 0, hits = 0;
+  for (auto _ : state) {
+    Ray ray = scene.rays[i];
+    SurfaceInteraction isect;
+    hits += bvh.Intersect(ray, &isect);
+    benchmark::DoNotOptimize(isect);
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hitRate"] = Float(hits) / state.iterations();
+}
+
+void BM_BVHIntersectP(benchmark::State &state) {
+  const SphereScene &scene = sphereScene(int(state.range(0)));
+  const BVHAccelerator &bvh =
+      sphereBVH(int(state.range(0)), BVHLayout(state.range(1)));
+  int i = 0, hits = 0;
+  for (auto _ : state) {
+    bool hit = bvh.IntersectP(scene.rays[i]);
+    benchmark::DoNotOptimize(hit);
+    hits += hit;
+    i = (i + 1) % nInputs;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hitRate"] = Float(hits) / state.iterations();
+}
+
+// The integrand of the sampler benchmarks over [0, 1)^4: a quarter disc of
+// radius _r_ in the first two dimensions, for the discontinuities of
+// geometric edges, times a smooth ramp in the other two. Its integral is
+// Pi * r^2 / 4.
+Float convergenceIntegrand(Float r, const Float u[4]) {
+  Float disc = u[0] * u[0] + u[1] * u[1] < r * r ? 1 : 0;
+  return disc * (0.5f + u[2]) * (0.5f + u[3]);
+}
+
+// Sampler arguments of BM_SamplerConvergence: one more than the SamplerType,
+// or 0 for std::mt19937.
+constexpr int nSamplerArgs = 5;
+const char *samplerNames[nSamplerArgs] = {"mt19937", "independent",
+                                          "stratified", "sobol", "pmj02"};
+
+// Estimates the integral with _spp_ samples in each of 256 "pixels", each
+// with its own disc radius, and reports the RMS error over them.
+void BM_SamplerConvergence(benchmark::State &state) {
+  const int samplerArg = int(state.range(0)), spp = int(state.range(1));
+  std::unique_ptr<Sampler> sampler;
+  if (samplerArg > 0)
+    sampler = CreateSampler(SamplerType(samplerArg - 1), spp);
+  const int nPixels = 256;
+  double sumSquaredError = 0;
+  for (auto _ : state) {
+    sumSquaredError = 0;
+    for (int p = 0; p < nPixels; ++p) {
+      Point2i pixel(p % 16, p / 16);
+      Float r = 0.3f + 0.7f * (p + 0.5f) / nPixels;
+      std::mt19937 rng(p);
+      std::uniform_real_distribution<Float> uniform;
+      double sum = 0;
+      for (int i = 0; i < spp; ++i) {
+        Float u[4];
+        for (int dim = 0; dim < 4; ++dim)
+          u[dim] = sampler ? sampler->Get1D(pixel, i, dim) : uniform(rng);
+        sum += convergenceIntegrand(r, u);
+      }
+      double error = sum / spp - Pi * r * r / 4;
+      sumSquaredError += error * error;
+    }
+    benchmark::DoNotOptimize(sumSquaredError);
+  }
+  state.SetLabel(samplerNames[samplerArg]);
+  state.SetItemsProcessed(state.iterations() * nPixels * spp);
+  state.counters["rmse"] = std::sqrt(sumSquaredError / nPixels);
+}
+
+void registerSamplerBenchmarks() {
+  for (int s = 0; s < nSamplerArgs; ++s)
+    for (int64_t spp = 1; spp <= 1024; spp *= 4)
+      benchmark::RegisterBenchmark("BM_SamplerConvergence",
+                                   BM_SamplerConvergence)
+          ->Args({s, spp})
+          ->ArgNames({"sampler", "spp"});
+}
+
+const std::vector<int64_t> sceneSizes = {1 << 10, 1 << 14, 1 << 18, 1 << 20,
+                                         10000000};
+
+void registerBVHBenchmarks() {
+  for (int64_t n : sceneSizes) {
+    for (BVHSplitMethod m : {BVHSplitMethod::SAH, BVHSplitMethod::HLBVH,
+                             BVHSplitMethod::Middle,
+                             BVHSplitMethod::EqualCounts})
+      benchmark::RegisterBenchmark("BM_BVHBuild", BM_BVHBuild)
+          ->Args({n, int64_t(m)})
+          ->ArgNames({"spheres", "split"})
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+    for (BVHLayout layout :
+         {BVHLayout::Binary, BVHLayout::Wide4, BVHLayout::Wide8}) {
+      benchmark::RegisterBenchmark("BM_BVHIntersect", BM_BVHIntersect)
+          ->Args({n, int64_t(layout)})
+          ->ArgNames({"spheres", "layout"});
+      benchmark::RegisterBenchmark("BM_BVHIntersectP", BM_BVHIntersectP)
+          ->Args({n, int64_t(layout)})
+          ->ArgNames({"spheres", "layout"});
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  // JSON unless the command line asks for something else; later flags win.
+  std::vector<char *> args(argv, argv + argc);
+  char jsonFormat[] = "--benchmark_format=json";
+  args.insert(args.begin() + 1, jsonFormat);
+  int nArgs = int(args.size());
+  benchmark::Initialize(&nArgs, args.data());
+  if (benchmark::ReportUnrecognizedArguments(nArgs, args.data())) return 1;
+  registerBVHBenchmarks();
+  registerSamplerBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
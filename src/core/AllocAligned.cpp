@@ -26,7 +26,3 @@ void FreeAligned(void *ptr) {
 #endif
 }
 
-template <typename T>
-void FreeAligned(T *ptr) {
-  FreeAligned((void *)ptr);
-}
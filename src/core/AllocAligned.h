@@ -15,5 +15,7 @@ T *AllocAligned(size_t count) {
 void FreeAligned(void *ptr);
 
 template <typename T>
-void FreeAligned(T *ptr);
+void FreeAligned(T *ptr) {
+  FreeAligned((void *)ptr);
+}
 #endif  // ALLOCALIGNED_H
@@ -0,0 +1,22 @@
+#include "core/camera.h"
+
+#include <glm/glm.hpp>
+
+PerspectiveCamera::PerspectiveCamera(const Point3f &pos, const Point3f &look,
+                                     const Vector3f &upDir, Float fov,
+                                     const Point2i &resolution)
+    : origin(pos),
+      tanHalfFov(std::tan(glm::radians(fov) / 2)),
+      aspect(Float(resolution.x) / Float(resolution.y)),
+      resolution(resolution) {
+  forward = Normalize(Vector3f(look - pos));
+  right = Normalize(Cross(Normalize(upDir), forward));
+  up = Cross(forward, right);
+}
+
+Ray PerspectiveCamera::GenerateRay(const Point2f &pFilm, Float time) const {
+  Float sx = (2 * pFilm.x / resolution.x - 1) * aspect * tanHalfFov;
+  Float sy = (1 - 2 * pFilm.y / resolution.y) * tanHalfFov;
+  Vector3f d = Normalize(Vector3f(forward + right * sx + up * sy));
+  return Ray(origin, d, Infinity, time);
+}
@@ -0,0 +1,29 @@
+#ifndef PHR_CORE_CAMERA_H
+#define PHR_CORE_CAMERA_H
+
+#include "core/geometry.h"
+#include "core/phr.h"
+
+// A pinhole camera. The basis is built directly from the look-at parameters
+// rather than through a camera-to-world _Transform_, since camera rays are
+// generated for every sample and only need an origin and a direction.
+class PerspectiveCamera {
+ public:
+  PerspectiveCamera(const Point3f &pos, const Point3f &look,
+                    const Vector3f &up, Float fov, const Point2i &resolution);
+
+  // _pFilm_ is in raster space, (0, 0) being the top-left corner of the image.
+  // _time_ is in the shutter interval [0, 1]; renders that take one sample
+  // per pixel use the middle of it.
+  Ray GenerateRay(const Point2f &pFilm, Float time = 0.5f) const;
+
+  const Point2i &Resolution() const { return resolution; }
+
+ private:
+  Point3f origin;
+  Vector3f forward, right, up;
+  Float tanHalfFov, aspect;
+  Point2i resolution;
+};
+
+#endif  // PHR_CORE_CAMERA_H
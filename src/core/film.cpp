@@ -0,0 +1,181 @@
+#include "core/film.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "core/AllocAligned.h"
+#include "core/imageio.h"
+#include "core/simd.h"
+
+// The sRGB curve is too expensive to evaluate per channel for every displayed
+// frame, so linear values are quantized to 12 bits and looked up instead. The
+// table steps are small enough that no output differs from evaluating
+// GammaCorrect() exactly by more than one code.
+static constexpr int LUTSize = 4096;
+
+static const uint8_t *sRGBTable() {
+  static const struct Table {
+    Table() {
+      for (int i = 0; i < LUTSize; ++i) {
+        Float v = GammaCorrect(Float(i) / (LUTSize - 1));
+        values[i] = uint8_t(Clamp(255.f * v + 0.5f, 0.f, 255.f));
+      }
+    }
+    uint8_t values[LUTSize];
+  } table;
+  return table.values;
+}
+
+static inline uint32_t pack(const uint8_t *lut, int r, int g, int b) {
+  return uint32_t(lut[r]) | uint32_t(lut[g]) << 8 | uint32_t(lut[b]) << 16 |
+         0xff000000u;
+}
+
+static inline int quantize(Float v) {
+  // Written so that NaNs fail both comparisons and map to 0.
+  v = v < Float(LUTSize - 1) ? v : Float(LUTSize - 1);
+  return v > 0 ? int(v + 0.5f) : 0;
+}
+
+void ToRGBA8(const Float *rgb, Float scale, size_t nPixels, uint32_t *rgba) {
+  const uint8_t *lut = sRGBTable();
+  scale *= LUTSize - 1;
+  size_t i = 0;
+#if defined(PHR_HAVE_SSE) && !defined(PHR_FLOAT_AS_DOUBLE)
+  // Four pixels are twelve floats: three vectors, scaled, clamped and
+  // rounded to table indices together.
+  const __m128 vScale = _mm_set1_ps(scale);
+  const __m128 vZero = _mm_setzero_ps();
+  const __m128 vMax = _mm_set1_ps(Float(LUTSize - 1));
+  alignas(16) int32_t idx[12];
+  for (; i + 4 <= nPixels; i += 4) {
+    const Float *p = rgb + 3 * i;
+    for (int j = 0; j < 3; ++j) {
+      __m128 v = _mm_mul_ps(_mm_loadu_ps(p + 4 * j), vScale);
+      // _mm_max_ps returns its second operand for NaN.
+      v = _mm_min_ps(_mm_max_ps(v, vZero), vMax);
+      _mm_store_si128((__m128i *)(idx + 4 * j), _mm_cvtps_epi32(v));
+    }
+    for (int j = 0; j < 4; ++j)
+      rgba[i + j] = pack(lut, idx[3 * j], idx[3 * j + 1], idx[3 * j + 2]);
+  }
+#endif
+  for (; i < nPixels; ++i) {
+    const Float *p = rgb + 3 * i;
+    rgba[i] = pack(lut, quantize(p[0] * scale), quantize(p[1] * scale),
+                   quantize(p[2] * scale));
+  }
+}
+
+Film::~Film() {
+  FreeAligned(rgb);
+  FreeAligned(display);
+}
+
+void Film::swap(Film &other) noexcept {
+  std::swap(resolution, other.resolution);
+  std::swap(capacity, other.capacity);
+  std::swap(rgb, other.rgb);
+  std::swap(display, other.display);
+}
+
+void Film::reserve(const Point2i &size) {
+  if (size.x <= capacity.x && size.y <= capacity.y) return;
+  auto roundUp = [](int v) {
+    return (v + Granularity - 1) / Granularity * Granularity;
+  };
+  Point2i newCapacity(std::max(capacity.x, roundUp(size.x)),
+                      std::max(capacity.y, roundUp(size.y)));
+  size_t nPixels = size_t(newCapacity.x) * newCapacity.y;
+  Float *newRGB = AllocAligned<Float>(3 * nPixels);
+  uint32_t *newDisplay = AllocAligned<uint32_t>(nPixels);
+  if (!newRGB || !newDisplay) {
+    FreeAligned(newRGB);
+    FreeAligned(newDisplay);
+    throw std::runtime_error("Film: out of memory.\n");
+  }
+  // Nothing needs to survive: Resize() clears the samples and CopyDisplay()
+  // overwrites the display buffer. The display is still zeroed, since
+  // textures are uploaded at the full capacity.
+  std::fill_n(newDisplay, nPixels, uint32_t(0));
+  FreeAligned(rgb);
+  FreeAligned(display);
+  rgb = newRGB;
+  display = newDisplay;
+  capacity = newCapacity;
+}
+
+void Film::Resize(const Point2i &res) {
+  reserve(res);
+  resolution = res;
+  for (int y = 0; y < resolution.y; ++y)
+    std::fill_n(&rgb[3 * size_t(y) * capacity.x], 3 * resolution.x, Float(0));
+}
+
+void Film::Resolve(Float scale) {
+  for (int y = 0; y < resolution.y; ++y) {
+    size_t row = size_t(y) * capacity.x;
+    ToRGBA8(&rgb[3 * row], scale, resolution.x, &display[row]);
+  }
+  padDisplay();
+}
+
+void Film::Resolve(Float scale, const Bounds2i &bounds) {
+  for (int y = bounds.pMin.y; y < bounds.pMax.y; ++y) {
+    size_t offset = size_t(y) * capacity.x + bounds.pMin.x;
+    ToRGBA8(&rgb[3 * offset], scale, bounds.pMax.x - bounds.pMin.x,
+            &display[offset]);
+  }
+}
+
+void Film::padDisplay() {
+  if (resolution.x <= 0 || resolution.y <= 0) return;
+  if (resolution.x < capacity.x)
+    for (int y = 0; y < resolution.y; ++y) {
+      uint32_t *row = &display[size_t(y) * capacity.x];
+      row[resolution.x] = row[resolution.x - 1];
+    }
+  if (resolution.y < capacity.y) {
+    int width = std::min(resolution.x + 1, capacity.x);
+    memcpy(&display[size_t(resolution.y) * capacity.x],
+           &display[size_t(resolution.y - 1) * capacity.x],
+           width * sizeof(uint32_t));
+  }
+}
+
+void Film::CopyDisplay(const Film &src) {
+  reserve(src.capacity);
+  resolution = src.resolution;
+  for (int y = 0; y < resolution.y; ++y)
+    memcpy(&display[size_t(y) * capacity.x],
+           &src.display[size_t(y) * src.capacity.x],
+           resolution.x * sizeof(uint32_t));
+  padDisplay();
+}
+
+VarianceFilm::VarianceFilm(const Point2i &resolution)
+    : resolution(resolution),
+      pixels(size_t(std::max(resolution.x, 0)) * std::max(resolution.y, 0)) {}
+
+Float VarianceFilm::RelativeError(const Point2i &p, Float floor) const {
+  const Pixel &px = pixel(p);
+  if (px.n < 2) return Infinity;
+  Float standardError = std::sqrt(px.m2 / (px.n - 1) / px.n);
+  return standardError / (Luminance(px.mean) + floor);
+}
+
+void VarianceFilm::GetRGB(std::vector<Float> *rgb) const {
+  rgb->resize(3 * pixels.size());
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    (*rgb)[3 * i] = pixels[i].mean.x;
+    (*rgb)[3 * i + 1] = pixels[i].mean.y;
+    (*rgb)[3 * i + 2] = pixels[i].mean.z;
+  }
+}
+
+void VarianceFilm::GetSampleCounts(std::vector<int> *counts) const {
+  counts->resize(pixels.size());
+  for (size_t i = 0; i < pixels.size(); ++i) (*counts)[i] = pixels[i].n;
+}
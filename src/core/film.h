@@ -0,0 +1,131 @@
+#ifndef PHR_CORE_FILM_H
+#define PHR_CORE_FILM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "core/geometry.h"
+#include "core/phr.h"
+
+// Converts _nPixels_ linear RGB triples, each multiplied by _scale_, to
+// gamma-corrected R8G8B8A8 words (red in the low byte, alpha opaque). Uses SSE
+// where available.
+void ToRGBA8(const Float *rgb, Float scale, size_t nPixels, uint32_t *rgba);
+
+// An accumulation buffer of summed linear RGB samples, plus the 8-bit buffer
+// it is resolved to for display. Both are laid out with a row stride of
+// Capacity().x pixels, and the capacity only ever grows (in steps of
+// Granularity pixels per axis), so resizing a viewport back and forth
+// reuses one allocation and keeps the stride, and any texture created at the
+// capacity, unchanged.
+class Film {
+ public:
+  static constexpr int Granularity = 64;
+
+  Film() = default;
+  ~Film();
+  Film(const Film &) = delete;
+  Film &operator=(const Film &) = delete;
+  Film(Film &&other) noexcept { swap(other); }
+  Film &operator=(Film &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+  void swap(Film &other) noexcept;
+
+  // Sets the resolution and zeroes the accumulated samples, growing the
+  // buffers only if _resolution_ does not fit the current capacity.
+  void Resize(const Point2i &resolution);
+
+  void AddSample(const Point2i &p, const Vector3f &L) {
+    Float *pixel = &rgb[3 * (size_t(p.y) * capacity.x + p.x)];
+    pixel[0] += L.x;
+    pixel[1] += L.y;
+    pixel[2] += L.z;
+  }
+
+  // Converts the accumulated sums, multiplied by _scale_ (one over the
+  // sample count), into the display buffer. The last column and row are
+  // repeated just outside Resolution(), so a texture sampled with linear
+  // filtering up to the image edge does not blend in stale pixels.
+  void Resolve(Float scale);
+  // Converts only the pixels in _bounds_, which must lie inside
+  // Resolution(), and leaves the edge padding alone; for publishing part of
+  // a pass while other threads still add samples elsewhere.
+  void Resolve(Float scale, const Bounds2i &bounds);
+  // Takes over the resolution and display buffer of _src_, growing this
+  // film's capacity to match and padding the edges as Resolve() does. The
+  // accumulated samples are not copied.
+  void CopyDisplay(const Film &src);
+
+  const Point2i &Resolution() const { return resolution; }
+  const Point2i &Capacity() const { return capacity; }
+  const Float *RGB() const { return rgb; }
+  const uint32_t *Display() const { return display; }
+
+ private:
+  void reserve(const Point2i &size);
+  void padDisplay();
+
+  Point2i resolution = Point2i(0, 0), capacity = Point2i(0, 0);
+  Float *rgb = nullptr;
+  uint32_t *display = nullptr;
+};
+
+// Per-pixel running statistics of the samples for adaptive sampling: the
+// mean of their linear RGB, and the variance of their luminance, both
+// updated with Welford's algorithm, so they stay accurate over thousands of
+// samples without keeping sums of squares. Each pixel is only ever updated
+// by the thread rendering its tile.
+class VarianceFilm {
+ public:
+  explicit VarianceFilm(const Point2i &resolution);
+
+  void AddSample(const Point2i &p, const Vector3f &L) {
+    Pixel &px = pixels[size_t(p.y) * resolution.x + p.x];
+    Float y = Luminance(L);
+    Float yMean = Luminance(px.mean);
+    Float invN = Float(1) / ++px.n;
+    px.mean = px.mean + (L - px.mean) * invN;
+    px.m2 += (y - yMean) * (y - Luminance(px.mean));
+  }
+
+  int SampleCount(const Point2i &p) const { return pixel(p).n; }
+  Vector3f Mean(const Point2i &p) const { return pixel(p).mean; }
+  // The unbiased sample variance of the luminance of the pixel's samples.
+  Float Variance(const Point2i &p) const {
+    const Pixel &px = pixel(p);
+    return px.n > 1 ? px.m2 / (px.n - 1) : 0;
+  }
+  // The estimated standard error of the pixel's mean luminance, relative to
+  // the mean plus _floor_, which keeps nearly black pixels from demanding
+  // samples for noise nobody can see.
+  Float RelativeError(const Point2i &p, Float floor = 0.01f) const;
+
+  // The means as three Floats per pixel and the sample counts as one int
+  // per pixel, rows top to bottom.
+  void GetRGB(std::vector<Float> *rgb) const;
+  void GetSampleCounts(std::vector<int> *counts) const;
+
+  const Point2i &Resolution() const { return resolution; }
+
+  static Float Luminance(const Vector3f &L) {
+    return 0.212671f * L.x + 0.715160f * L.y + 0.072169f * L.z;
+  }
+
+ private:
+  struct Pixel {
+    Vector3f mean = Vector3f(0, 0, 0);
+    Float m2 = 0;
+    int n = 0;
+  };
+  const Pixel &pixel(const Point2i &p) const {
+    return pixels[size_t(p.y) * resolution.x + p.x];
+  }
+
+  Point2i resolution;
+  std::vector<Pixel> pixels;
+};
+
+#endif  // PHR_CORE_FILM_H
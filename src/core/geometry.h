@@ -13,8 +13,6 @@
 #include "glm/geometric.hpp"
 #include "phr.h"
 
-// TODO Implement Quaternion and AnimatedTransforms
-
 // This function creates a local coordinate system given a vector in 3D space.
 // We can construct the two other vectors by applying the cross-product,since
 // they are orthogonal to both. Note that the vectors generated are unique up to
@@ -71,6 +69,21 @@ inline Vector3<T> Abs(const Vector3<T> &v) {
   return Vector3<T>(std::abs(v.x), std::abs(v.y), std::abs(v.z));
 }
 
+template <typename T>
+inline T MaxComponent(const Vector3<T> &v) {
+  return std::max(v.x, std::max(v.y, v.z));
+}
+
+template <typename T>
+inline int MaxDimension(const Vector3<T> &v) {
+  return (v.x > v.y) ? ((v.x > v.z) ? 0 : 2) : ((v.y > v.z) ? 1 : 2);
+}
+
+template <typename T>
+inline Vector3<T> Permute(const Vector3<T> &v, int x, int y, int z) {
+  return Vector3<T>(v[x], v[y], v[z]);
+}
+
 inline void CoordinateSystem(const glm::vec3 &v1, glm::vec3 *v2,
                              glm::vec3 *v3) {
   if (std::abs(v1.x) > std::abs(v1.y)) {
@@ -98,6 +111,11 @@ class Point2 : public glm::tvec2<T> {
   explicit Point2(const Point3<T> &p) : glm::tvec2<T>(p.x, p.y) {}
 };
 
+template <typename T>
+inline Point3<T> Permute(const Point3<T> &p, int x, int y, int z) {
+  return Point3<T>(p[x], p[y], p[z]);
+}
+
 typedef Point2<Float> Point2f;
 typedef Point2<int> Point2i;
 
@@ -373,11 +391,18 @@ inline bool Bounds3<T>::IntersectP(const Ray &ray, const Vector3f &invDir,
   float tzMin = (bounds[dirIntNeg[2]].z - ray.o.z) * invDir.z;
   float tzMax = (bounds[1 - dirIntNeg[2]].z - ray.o.z) * invDir.z;
 
-  // TODO Update tmax and tyMax for bounding box intersection
-
+  // Update _tMax_ and _tyMax_ to ensure robust bounds intersection
+  tMax *= 1 + 2 * gamma(3);
+  tyMax *= 1 + 2 * gamma(3);
   if (tMin > tyMax || tyMin > tMax) return false;
   if (tyMin > tMin) tMin = tyMin;
   if (tyMax < tMax) tMax = tyMax;
+
+  tzMax *= 1 + 2 * gamma(3);
+  if (tMin > tzMax || tzMin > tMax) return false;
+  if (tzMin > tMin) tMin = tzMin;
+  if (tzMax < tMax) tMax = tzMax;
+  return (tMin < ray.tMax) && (tMax > 0);
 }
 
 template <typename T>
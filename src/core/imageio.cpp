@@ -0,0 +1,43 @@
+#include "core/imageio.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+static bool HasExtension(const std::string &value, const std::string &ending) {
+  if (ending.size() > value.size()) return false;
+  return std::equal(ending.rbegin(), ending.rend(), value.rbegin(),
+                    [](char a, char b) { return std::tolower(a) == b; });
+}
+
+static void WritePPM(const std::string &name, const Float *rgb,
+                     const Point2i &resolution) {
+  FILE *fp = fopen(name.c_str(), "wb");
+  if (!fp)
+    throw std::runtime_error("WriteImage: unable to open \"" + name +
+                             "\" for writing.\n");
+
+  fprintf(fp, "P6\n%d %d\n255\n", resolution.x, resolution.y);
+  std::vector<uint8_t> row(3 * resolution.x);
+  for (int y = 0; y < resolution.y; ++y) {
+    for (int x = 0; x < 3 * resolution.x; ++x) {
+      Float v = GammaCorrect(rgb[3 * y * resolution.x + x]);
+      row[x] = (uint8_t)Clamp(255.f * v + 0.5f, 0.f, 255.f);
+    }
+    fwrite(row.data(), 1, row.size(), fp);
+  }
+  bool failed = ferror(fp);
+  if (fclose(fp) != 0 || failed)
+    throw std::runtime_error("WriteImage: error writing \"" + name + "\".\n");
+}
+
+void WriteImage(const std::string &name, const Float *rgb,
+                const Point2i &resolution) {
+  if (HasExtension(name, ".ppm"))
+    WritePPM(name, rgb, resolution);
+  else
+    throw std::runtime_error("WriteImage: \"" + name +
+                             "\" has an unsupported extension.\n");
+}
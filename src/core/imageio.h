@@ -0,0 +1,22 @@
+#ifndef PHR_CORE_IMAGEIO_H
+#define PHR_CORE_IMAGEIO_H
+
+#include <cmath>
+#include <string>
+
+#include "core/geometry.h"
+#include "core/phr.h"
+
+// The sRGB transfer curve, taking linear values in [0, 1] to display values.
+inline Float GammaCorrect(Float value) {
+  if (value <= 0.0031308f) return 12.92f * value;
+  return 1.055f * std::pow(value, (Float)(1.f / 2.4f)) - 0.055f;
+}
+
+// Writes linear RGB (three Floats per pixel, rows top to bottom) to _name_.
+// Only binary PPM is supported for now; the values are gamma corrected and
+// quantized to 8 bits. Throws std::runtime_error on failure.
+void WriteImage(const std::string &name, const Float *rgb,
+                const Point2i &resolution);
+
+#endif  // PHR_CORE_IMAGEIO_H
@@ -4,14 +4,12 @@
 #include "core/shape.h"
 #include "geometry.h"
 
-MediumInterface* getMediumInterface() { return nullptr; }
-
 SurfaceInteraction::SurfaceInteraction(
     const Point3f& p, const Vector3f& pError, const Point2f& uv,
     const Vector3f& wo, const Vector3f& dpdu, const Vector3f& dpdv,
     const Normal3f& dndu, const Normal3f& dndv, Float time, const Shape* shape)
     : Interaction(p, Normal3f(Normalize(Cross(dpdu, dpdv))), pError, wo, time,
-                  *getMediumInterface()),
+                  MediumInterface()),
       uv(uv),
       dpdu(dpdu),
       dpdv(dpdv),
@@ -0,0 +1,88 @@
+#include "core/lowdiscrepancy.h"
+
+namespace {
+
+// The primitive polynomial and initial direction numbers of one Sobol'
+// dimension, from Joe and Kuo's new-joe-kuo-6.21201 table.
+struct SobolPolynomial {
+  int degree;
+  uint32_t a;
+  uint32_t m[3];
+};
+
+// The generator matrix columns of each dimension, and the XOR of the
+// columns picked by each byte of the index, so a sample is four table
+// lookups. Shuffled indices have random high bits, which a loop over the
+// bits would spend 32 mispredicted iterations on.
+struct SobolMatrices {
+  uint32_t v[NSobolDimensions][32];
+  uint32_t bytes[NSobolDimensions][4][256];
+};
+
+// Dimension 0 is the van der Corput sequence, which has no polynomial.
+constexpr SobolPolynomial sobolPolynomials[NSobolDimensions - 1] = {
+    {1, 0, {1}}, {2, 1, {1, 3}}, {3, 1, {1, 3, 1}}};
+
+constexpr SobolMatrices computeSobolMatrices() {
+  SobolMatrices s{};
+  for (int k = 0; k < 32; ++k) s.v[0][k] = 1u << (31 - k);
+  for (int d = 1; d < NSobolDimensions; ++d) {
+    const SobolPolynomial &p = sobolPolynomials[d - 1];
+    uint32_t *v = s.v[d];
+    for (int k = 0; k < p.degree; ++k) v[k] = p.m[k] << (31 - k);
+    for (int k = p.degree; k < 32; ++k) {
+      v[k] = v[k - p.degree] ^ (v[k - p.degree] >> p.degree);
+      for (int i = 1; i < p.degree; ++i)
+        if ((p.a >> (p.degree - 1 - i)) & 1) v[k] ^= v[k - i];
+    }
+  }
+  for (int d = 0; d < NSobolDimensions; ++d)
+    for (int b = 0; b < 4; ++b)
+      for (int x = 0; x < 256; ++x) {
+        uint32_t r = 0;
+        for (int k = 0; k < 8; ++k)
+          if ((x >> k) & 1) r ^= s.v[d][8 * b + k];
+        s.bytes[d][b][x] = r;
+      }
+  return s;
+}
+
+constexpr SobolMatrices sobolMatrices = computeSobolMatrices();
+
+}  // namespace
+
+uint32_t SobolSample(uint32_t index, int dim) {
+  const uint32_t(*t)[256] = sobolMatrices.bytes[dim];
+  return t[0][index & 0xff] ^ t[1][(index >> 8) & 0xff] ^
+         t[2][(index >> 16) & 0xff] ^ t[3][index >> 24];
+}
+
+int PermutationElement(uint32_t i, uint32_t n, uint32_t seed) {
+  uint32_t w = n - 1;
+  w |= w >> 1;
+  w |= w >> 2;
+  w |= w >> 4;
+  w |= w >> 8;
+  w |= w >> 16;
+  do {
+    i ^= seed;
+    i *= 0xe170893d;
+    i ^= seed >> 16;
+    i ^= (i & w) >> 4;
+    i ^= seed >> 8;
+    i *= 0x0929eb3f;
+    i ^= seed >> 23;
+    i ^= (i & w) >> 1;
+    i *= 1 | seed >> 27;
+    i *= 0x6935fa69;
+    i ^= (i & w) >> 11;
+    i *= 0x74dcb303;
+    i ^= (i & w) >> 2;
+    i *= 0x9e501cc3;
+    i ^= (i & w) >> 2;
+    i *= 0xc860a3df;
+    i &= w;
+    i ^= i >> 5;
+  } while (i >= n);
+  return int((i + seed) % n);
+}
@@ -0,0 +1,70 @@
+#ifndef PHR_CORE_LOWDISCREPANCY_H
+#define PHR_CORE_LOWDISCREPANCY_H
+
+#include <cstdint>
+
+#include "core/phr.h"
+
+// The largest Float below one, which sample values are clamped to.
+static constexpr Float OneMinusEpsilon = 0x1.fffffep-1;
+
+// A 64-bit finalizer with full avalanche, for seeding.
+inline uint64_t MixBits(uint64_t v) {
+  v ^= (v >> 31);
+  v *= 0x7fb5d329728ea185ull;
+  v ^= (v >> 27);
+  v *= 0x81dadef4bc2dd44dull;
+  v ^= (v >> 33);
+  return v;
+}
+
+// Hashes up to four integers into a 64-bit seed.
+inline uint64_t HashSeed(uint64_t a, uint64_t b, uint64_t c = 0,
+                         uint64_t d = 0) {
+  return MixBits(a ^ MixBits(b ^ MixBits(c ^ MixBits(d))));
+}
+
+inline uint32_t ReverseBits32(uint32_t n) {
+  n = (n << 16) | (n >> 16);
+  n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+  n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+  n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+  n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+  return n;
+}
+
+// Maps the top 24 bits of _v_ to [0, 1).
+inline Float BitsToUnitFloat(uint32_t v) {
+  return std::min(Float(v >> 8) * Float(0x1p-24), OneMinusEpsilon);
+}
+
+// A nested uniform (Owen) scramble of the bits of _v_, after Laine and
+// Karras with the hash constants of Vegdahl: each output bit is flipped
+// according to a hash of the bits above it only, so every elementary
+// interval of the input maps to one of the output, and the stratification of
+// a (t, m, s)-net survives. Different seeds give independent scrambles.
+inline uint32_t OwenScramble(uint32_t v, uint32_t seed) {
+  v = ReverseBits32(v);
+  v ^= v * 0x3d20adeau;
+  v += seed;
+  v *= (seed >> 16) | 1;
+  v ^= v * 0x05526c56u;
+  v ^= v * 0x53a22864u;
+  return ReverseBits32(v);
+}
+
+// The number of Sobol' dimensions SobolSample() has generator matrices for.
+static constexpr int NSobolDimensions = 4;
+
+// Component _dim_ (< NSobolDimensions) of point _index_ of the Sobol'
+// sequence, as a 32-bit fixed-point fraction. Dimensions 0 and 1 on their
+// own are a (0, 2)-sequence: every power-of-two run of points starting at a
+// multiple of its length puts one point in each elementary interval.
+uint32_t SobolSample(uint32_t index, int dim);
+
+// The element at position _i_ of a pseudo-random permutation of [0, _n_)
+// picked by _seed_, in constant expected time (Kensler, "Correlated
+// Multi-Jittered Sampling", 2013).
+int PermutationElement(uint32_t i, uint32_t n, uint32_t seed);
+
+#endif  // PHR_CORE_LOWDISCREPANCY_H
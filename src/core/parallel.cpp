@@ -0,0 +1,71 @@
+#include "core/parallel.h"
+
+#include <algorithm>
+
+int NumSystemCores() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ParallelChunks(
+    int64_t count, int nChunks,
+    const std::function<void(int64_t, int64_t, int)> &func) {
+  nChunks = std::max(1, nChunks);
+  std::vector<std::thread> threads;
+  for (int c = 1; c < nChunks; ++c)
+    threads.emplace_back(func, count * c / nChunks, count * (c + 1) / nChunks,
+                         c);
+  func(0, count / nChunks, 0);
+  for (std::thread &thread : threads) thread.join();
+}
+
+ThreadPool::ThreadPool(int nThreads) {
+  if (nThreads <= 0) nThreads = NumSystemCores();
+  for (int i = 1; i < nThreads; ++i)
+    threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    shutdown = true;
+  }
+  workAvailable.notify_all();
+  for (std::thread &thread : threads) thread.join();
+}
+
+void ThreadPool::RunOnAll(const std::function<void(int)> &func) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job = &func;
+    activeWorkers = int(threads.size());
+    ++generation;
+  }
+  workAvailable.notify_all();
+
+  func(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  workDone.wait(lock, [this] { return activeWorkers == 0; });
+  job = nullptr;
+}
+
+void ThreadPool::workerLoop(int threadIndex) {
+  uint64_t seenGeneration = 0;
+  while (true) {
+    const std::function<void(int)> *func;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workAvailable.wait(lock, [&] {
+        return shutdown || generation != seenGeneration;
+      });
+      if (shutdown) return;
+      seenGeneration = generation;
+      func = job;
+    }
+
+    (*func)(threadIndex);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--activeWorkers == 0) workDone.notify_one();
+  }
+}
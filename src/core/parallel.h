@@ -0,0 +1,49 @@
+#ifndef PHR_CORE_PARALLEL_H
+#define PHR_CORE_PARALLEL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int NumSystemCores();
+
+// Splits [0, count) into _nChunks_ contiguous ranges and runs
+// _func(begin, end, chunkIndex)_ for each on its own thread, the caller taking
+// chunk 0. Unlike ThreadPool::RunOnAll() this may be called from anywhere,
+// including from inside another parallel section.
+void ParallelChunks(
+    int64_t count, int nChunks,
+    const std::function<void(int64_t, int64_t, int)> &func);
+
+// A fixed set of worker threads that sleep between jobs. The thread that calls
+// RunOnAll() takes part as worker 0, so a pool of size 1 spawns no threads.
+class ThreadPool {
+ public:
+  // _nThreads_ <= 0 uses every core in the machine.
+  explicit ThreadPool(int nThreads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  int Size() const { return int(threads.size()) + 1; }
+
+  // Calls _func(threadIndex)_ once on every worker and returns when all calls
+  // have finished. Not reentrant: _func_ must not call RunOnAll() itself.
+  void RunOnAll(const std::function<void(int)> &func);
+
+ private:
+  void workerLoop(int threadIndex);
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable workAvailable, workDone;
+  const std::function<void(int)> *job = nullptr;
+  uint64_t generation = 0;
+  int activeWorkers = 0;
+  bool shutdown = false;
+};
+
+#endif  // PHR_CORE_PARALLEL_H
@@ -35,6 +35,78 @@ void GeometricPrimitive::computeScatterFunctions(
 
 Bounds3f GeometricPrimitive::WorldBound() const { return shape->worldBound(); }
 
+std::vector<std::shared_ptr<Primitive>> CreateGeometricPrimitives(
+    const std::vector<std::shared_ptr<Shape>>& shapes,
+    const std::shared_ptr<Material>& material,
+    const std::shared_ptr<AreaLight>& areaLight) {
+  auto block = std::make_shared<std::vector<GeometricPrimitive>>();
+  block->reserve(shapes.size());
+  for (const std::shared_ptr<Shape>& shape : shapes)
+    block->emplace_back(shape, material, areaLight);
+  std::vector<std::shared_ptr<Primitive>> prims;
+  prims.reserve(shapes.size());
+  for (GeometricPrimitive& prim : *block) prims.emplace_back(block, &prim);
+  return prims;
+}
+
+TransformedPrimitive::TransformedPrimitive(
+    std::shared_ptr<Primitive> primitive, const Transform* primitiveToWorld,
+    const Transform* worldToPrimitive)
+    : primitive(primitive),
+      primitiveToWorld(primitiveToWorld),
+      worldToPrimitive(worldToPrimitive),
+      worldBound((*primitiveToWorld)(primitive->WorldBound())) {}
+
+TransformedPrimitive::TransformedPrimitive(
+    std::shared_ptr<Primitive> primitive,
+    const AnimatedTransform& primitiveToWorld)
+    : primitive(primitive),
+      primitiveToWorld(nullptr),
+      worldToPrimitive(nullptr),
+      motion(std::make_unique<AnimatedTransform>(primitiveToWorld)),
+      worldBound(motion->MotionBounds(primitive->WorldBound())) {}
+
+bool TransformedPrimitive::Intersect(const Ray& r,
+                                     SurfaceInteraction* isect) const {
+  if (motion) {
+    Transform toWorld;
+    motion->Interpolate(r.time, &toWorld);
+    return intersect(r, toWorld, Inverse(toWorld), isect);
+  }
+  return intersect(r, *primitiveToWorld, *worldToPrimitive, isect);
+}
+
+bool TransformedPrimitive::intersect(const Ray& r, const Transform& toWorld,
+                                     const Transform& toPrimitive,
+                                     SurfaceInteraction* isect) const {
+  Vector3f oError, dError;
+  Ray ray = toPrimitive(r, &oError, &dError);
+  if (!primitive->Intersect(ray, isect)) return false;
+  r.tMax = ray.tMax;
+  if (!toWorld.isIdentity()) *isect = toWorld(*isect);
+  return true;
+}
+
+bool TransformedPrimitive::IntersectP(const Ray& r) const {
+  Vector3f oError, dError;
+  if (motion) {
+    Transform toWorld;
+    motion->Interpolate(r.time, &toWorld);
+    return primitive->IntersectP(Inverse(toWorld)(r, &oError, &dError));
+  }
+  return primitive->IntersectP((*worldToPrimitive)(r, &oError, &dError));
+}
+
+void TransformedPrimitive::computeScatterFunctions(
+    SurfaceInteraction* /*isect*/, MemoryArena& /*arena*/,
+    TransportMode /*mode*/, bool /*allowMultipleLobes*/) const {
+  throw std::runtime_error(
+      "TransformedPrimitive::computeScatterFunctions() called. This is an "
+      "error.\n");
+}
+
+Bounds3f TransformedPrimitive::WorldBound() const { return worldBound; }
+
 const AreaLight* Aggregate::GetAreaLight() const {
   throw std::runtime_error(
       "Aggregate::GetAreaLight() called. This is an error.\n");
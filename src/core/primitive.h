@@ -3,10 +3,12 @@
 #define CORE_PRIMITIVE_H
 
 #include <memory>
+#include <vector>
 
 #include "core/geometry.h"
 #include "core/interaction.h"
 #include "core/shape.h"
+#include "core/transform.h"
 
 class AreaLight;
 class Material;
@@ -43,6 +45,7 @@ class GeometricPrimitive : public Primitive {
                                TransportMode mode,
                                bool allowMultipleLobes) const override;
   Bounds3f WorldBound() const override;
+  const Shape* GetShape() const { return shape.get(); }
 
  private:
   std::shared_ptr<Shape> shape;
@@ -50,7 +53,53 @@ class GeometricPrimitive : public Primitive {
   std::shared_ptr<AreaLight> areaLight;
 };
 
-// TODO: Need to write TransformedPrimitive
+// Wraps each of _shapes_ in a GeometricPrimitive with the given _material_
+// and _areaLight_. The primitives are stored in one array whose reference
+// count the returned pointers share, so a large mesh does not pay an
+// allocation per triangle.
+std::vector<std::shared_ptr<Primitive>> CreateGeometricPrimitives(
+    const std::vector<std::shared_ptr<Shape>>& shapes,
+    const std::shared_ptr<Material>& material,
+    const std::shared_ptr<AreaLight>& areaLight);
+
+// An instance of _primitive_, usually an aggregate such as a BVHAccelerator
+// shared by many instances, placed in the world by _primitiveToWorld_. Rays
+// are transformed into the primitive's space once here, not once per shape,
+// and only the closest hit is transformed back. Since the transforms are
+// affine, ray parameters are the same in both spaces.
+//
+// A moving instance interpolates its transform at each ray's time instead,
+// and reports the bounds of its whole motion as its world bound.
+class TransformedPrimitive : public Primitive {
+ public:
+  TransformedPrimitive(std::shared_ptr<Primitive> primitive,
+                       const Transform* primitiveToWorld,
+                       const Transform* worldToPrimitive);
+  TransformedPrimitive(std::shared_ptr<Primitive> primitive,
+                       const AnimatedTransform& primitiveToWorld);
+  bool Intersect(const Ray& r, SurfaceInteraction* isect) const override;
+  bool IntersectP(const Ray& r) const override;
+  const AreaLight* GetAreaLight() const override { return nullptr; }
+  void computeScatterFunctions(SurfaceInteraction* isect, MemoryArena& arena,
+                               TransportMode mode,
+                               bool allowMultipleLobes) const override;
+  Bounds3f WorldBound() const override;
+  const Primitive* GetPrimitive() const { return primitive.get(); }
+  // Null for moving instances, which have Motion() instead.
+  const Transform* PrimitiveToWorld() const { return primitiveToWorld; }
+  const AnimatedTransform* Motion() const { return motion.get(); }
+
+ private:
+  bool intersect(const Ray& r, const Transform& toWorld,
+                 const Transform& toPrimitive,
+                 SurfaceInteraction* isect) const;
+
+  std::shared_ptr<Primitive> primitive;
+  const Transform* primitiveToWorld;
+  const Transform* worldToPrimitive;
+  std::unique_ptr<const AnimatedTransform> motion;
+  Bounds3f worldBound;
+};
 
 // TODO: Cause an error, when any of the class functions are called.
 class Aggregate : public Primitive {
@@ -0,0 +1,164 @@
+#include "core/progressive.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "core/camera.h"
+#include "core/interaction.h"
+#include "core/parallel.h"
+#include "core/renderer.h"
+#include "core/tilescheduler.h"
+#include "core/util/MemoryArena.h"
+
+ProgressiveRenderer::ProgressiveRenderer(
+    const Scene &scene, int nThreads,
+    std::chrono::milliseconds publishInterval, int tileSize)
+    : scene(scene),
+      nThreads(nThreads),
+      tileSize(tileSize),
+      publishInterval(publishInterval),
+      thread([this]() { renderLoop(); }) {}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    shutdown = true;
+    ++generation;
+  }
+  settingsChanged.notify_one();
+  thread.join();
+}
+
+void ProgressiveRenderer::Restart(const ProgressiveSettings &newSettings) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    settings = newSettings;
+    ++generation;
+  }
+  {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    frameReady = false;
+  }
+  samplesCompleted = 0;
+  settingsChanged.notify_one();
+}
+
+bool ProgressiveRenderer::TakeFrame(Film *display, int *samples) {
+  std::lock_guard<std::mutex> lock(frameMutex);
+  if (!frameReady) return false;
+  display->swap(frame);
+  *samples = frameSamples;
+  frameReady = false;
+  return true;
+}
+
+void ProgressiveRenderer::publish(Film &film, int samples,
+                                  uint64_t frameGeneration) {
+  film.Resolve(Float(1) / samples);
+
+  // Checking the generation under _frameMutex_ orders this against the
+  // frameReady reset in Restart(): either the reset comes later, or this
+  // pass is seen to be stale and dropped.
+  std::lock_guard<std::mutex> lock(frameMutex);
+  if (generation.load() != frameGeneration) return;
+  frame.CopyDisplay(film);
+  frameSamples = samples;
+  frameReady = true;
+}
+
+void ProgressiveRenderer::publishTile(Film &film, const Bounds2i &tile,
+                                      uint64_t frameGeneration) {
+  std::lock_guard<std::mutex> tileLock(tileMutex);
+  film.Resolve(1, tile);
+  auto now = std::chrono::steady_clock::now();
+  if (now - lastTilePublish < publishInterval) return;
+  lastTilePublish = now;
+
+  std::lock_guard<std::mutex> lock(frameMutex);
+  if (generation.load() != frameGeneration) return;
+  frame.CopyDisplay(film);
+  frameSamples = 0;
+  frameReady = true;
+}
+
+void ProgressiveRenderer::renderLoop() {
+  using Clock = std::chrono::steady_clock;
+  ThreadPool pool(nThreads);
+  ArenaPool arenas(pool.Size());
+  std::unique_ptr<PerspectiveCamera> camera;
+  std::unique_ptr<TileScheduler> scheduler;
+  std::unique_ptr<Sampler> sampler;
+  Film film;
+  ProgressiveSettings current;
+  uint64_t currentGeneration = 0;
+  int samples = 0;
+  Clock::time_point lastPublish;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      settingsChanged.wait(lock, [&]() {
+        return shutdown || generation.load() != currentGeneration ||
+               (camera && samples < current.maxSamples);
+      });
+      if (shutdown) return;
+      if (generation.load() != currentGeneration) {
+        current = settings;
+        currentGeneration = generation.load();
+        samples = 0;
+        samplesCompleted = 0;
+        camera.reset();
+        scheduler.reset();
+        if (current.resolution.x <= 0 || current.resolution.y <= 0) continue;
+        const CameraDescription &cd = current.camera;
+        camera = std::make_unique<PerspectiveCamera>(
+            cd.pos, cd.look, cd.up, cd.fov, current.resolution);
+        scheduler = std::make_unique<TileScheduler>(pool, current.resolution,
+                                                    tileSize);
+        sampler = CreateSampler(current.sampler, current.maxSamples);
+        film.Resize(current.resolution);
+        // Black until the first pass fills the tiles in.
+        film.Resolve(1);
+        lastTilePublish = Clock::now();
+      }
+    }
+
+    const int pass = samples;
+    scheduler->Run([&](const Bounds2i &tile, int threadIndex) {
+      MemoryArena &arena = arenas[threadIndex];
+      for (int y = tile.pMin.y; y < tile.pMax.y; ++y) {
+        if (generation.load(std::memory_order_relaxed) != currentGeneration)
+          return;
+        for (int x = tile.pMin.x; x < tile.pMax.x; ++x) {
+          Point2i pixel(x, y);
+          Point2f u = sampler->Get2D(pixel, pass, FilmSampleDimension);
+          Ray ray = camera->GenerateRay(
+              Point2f(x + u.x, y + u.y),
+              sampler->Get1D(pixel, pass, TimeSampleDimension));
+          SurfaceInteraction isect;
+          Vector3f L = scene.Intersect(ray, &isect)
+                           ? ShadeHit(ray, isect, arena)
+                           : current.background;
+          if (current.spectrum != SpectrumMode::RGB)
+            L = SpectralShade(
+                L, current.spectrum,
+                sampler->Get1D(pixel, pass, WavelengthSampleDimension));
+          arena.Reset();
+          film.AddSample(Point2i(x, y), L);
+        }
+      }
+      if (pass == 0) publishTile(film, tile, currentGeneration);
+    });
+    // A cancelled pass leaves the film half updated, but it is cleared as soon
+    // as the new settings are picked up.
+    if (generation.load() != currentGeneration) continue;
+
+    samplesCompleted = ++samples;
+    Clock::time_point now = Clock::now();
+    if (samples == 1 || samples == current.maxSamples ||
+        now - lastPublish >= publishInterval) {
+      publish(film, samples, currentGeneration);
+      lastPublish = now;
+    }
+  }
+}
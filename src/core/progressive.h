@@ -0,0 +1,104 @@
+#ifndef PHR_CORE_PROGRESSIVE_H
+#define PHR_CORE_PROGRESSIVE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "core/film.h"
+#include "core/geometry.h"
+#include "core/phr.h"
+#include "core/renderer.h"
+#include "core/sampler.h"
+#include "core/scene.h"
+
+struct ProgressiveSettings {
+  Point2i resolution;
+  CameraDescription camera;
+  // Returned for rays that leave the scene.
+  Vector3f background = Vector3f(0, 0, 0);
+  // Accumulation stops once every pixel has this many samples.
+  int maxSamples = 1024;
+  SpectrumMode spectrum = SpectrumMode::RGB;
+  // Built for maxSamples samples per pixel.
+  SamplerType sampler = SamplerType::Sobol;
+};
+
+// Renders a scene progressively on background threads for interactive
+// display. Each pass adds one sample per pixel to a Film, pass i taking
+// sample i of the sampler for the pixel position, the time in the shutter
+// interval (for motion blur) and, for SpectrumMode::Hero, the wavelengths,
+// so the first n passes are exactly the first n samples of the pattern, as
+// in Render(). Completed passes are resolved to 8-bit sRGB and handed to the
+// display side through TakeFrame() at most once per _publishInterval_, plus
+// the first and last passes. So that a slow scene shows something right
+// after a Restart(), the first pass is also published while in flight, at
+// the same cadence, with the tiles finished so far and black elsewhere.
+//
+// Restart() cancels the pass in flight, which workers notice between rows,
+// so parameter and viewport changes take effect within one row of work
+// rather than one frame.
+class ProgressiveRenderer {
+ public:
+  // _nThreads_ <= 0 uses every core in the machine.
+  explicit ProgressiveRenderer(
+      const Scene &scene, int nThreads = 0,
+      std::chrono::milliseconds publishInterval =
+          std::chrono::milliseconds(100),
+      int tileSize = 16);
+  // Cancels the current pass and waits for the workers to stop.
+  ~ProgressiveRenderer();
+  ProgressiveRenderer(const ProgressiveRenderer &) = delete;
+  ProgressiveRenderer &operator=(const ProgressiveRenderer &) = delete;
+
+  // Throws away the accumulated samples and starts over with _settings_.
+  // Returns immediately.
+  void Restart(const ProgressiveSettings &settings);
+
+  // If a pass has been published since the last call, swaps it into
+  // _display_, whose display buffer and resolution are then valid, and
+  // returns true. _*samples_ is 0 for a partial first pass. The film previously in _display_ is recycled for later
+  // passes. Frames from before the last Restart() are never returned.
+  bool TakeFrame(Film *display, int *samples);
+
+  // Samples per pixel accumulated since the last Restart().
+  int SamplesCompleted() const { return samplesCompleted.load(); }
+
+ private:
+  void renderLoop();
+  void publish(Film &film, int samples, uint64_t frameGeneration);
+  // Resolves _tile_ of the first pass, just finished, and publishes the
+  // partial film if _publishInterval_ has passed. Called by the workers.
+  void publishTile(Film &film, const Bounds2i &tile, uint64_t frameGeneration);
+
+  const Scene &scene;
+  const int nThreads, tileSize;
+  const std::chrono::milliseconds publishInterval;
+
+  // Guards _settings_ and _shutdown_; _generation_ is bumped under it by
+  // every Restart() and read without it by the workers.
+  std::mutex mutex;
+  std::condition_variable settingsChanged;
+  ProgressiveSettings settings;
+  std::atomic<uint64_t> generation{0};
+  std::atomic<int> samplesCompleted{0};
+  bool shutdown = false;
+
+  // Serializes the workers' publishTile() calls, which write disjoint parts
+  // of the film's display buffer but read all of it to publish.
+  std::mutex tileMutex;
+  std::chrono::steady_clock::time_point lastTilePublish;
+
+  // The latest published pass.
+  std::mutex frameMutex;
+  Film frame;
+  int frameSamples = 0;
+  bool frameReady = false;
+
+  std::thread thread;
+};
+
+#endif  // PHR_CORE_PROGRESSIVE_H
@@ -0,0 +1,65 @@
+#include "core/quaternion.h"
+
+#include <cmath>
+
+#include "core/transform.h"
+
+Quaternion::Quaternion(const Transform &t) {
+  const glm::mat4 &m = t.GetMatrix();
+  Float trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0) {
+    // Compute w from the matrix trace, then v.
+    Float s = std::sqrt(trace + 1);
+    w = s / 2;
+    s = 0.5f / s;
+    v.x = (m[2][1] - m[1][2]) * s;
+    v.y = (m[0][2] - m[2][0]) * s;
+    v.z = (m[1][0] - m[0][1]) * s;
+  } else {
+    // Compute the largest of x, y and z first, then the rest.
+    const int next[3] = {1, 2, 0};
+    Float q[3];
+    int i = 0;
+    if (m[1][1] > m[0][0]) i = 1;
+    if (m[2][2] > m[i][i]) i = 2;
+    int j = next[i];
+    int k = next[j];
+    Float s = std::sqrt((m[i][i] - (m[j][j] + m[k][k])) + 1);
+    q[i] = s * 0.5f;
+    if (s != 0) s = 0.5f / s;
+    w = (m[k][j] - m[j][k]) * s;
+    q[j] = (m[j][i] + m[i][j]) * s;
+    q[k] = (m[k][i] + m[i][k]) * s;
+    v.x = q[0];
+    v.y = q[1];
+    v.z = q[2];
+  }
+}
+
+Transform Quaternion::ToTransform() const {
+  Float xx = v.x * v.x, yy = v.y * v.y, zz = v.z * v.z;
+  Float xy = v.x * v.y, xz = v.x * v.z, yz = v.y * v.z;
+  Float wx = v.x * w, wy = v.y * w, wz = v.z * w;
+
+  glm::mat4 m(1.f);
+  m[0][0] = 1 - 2 * (yy + zz);
+  m[0][1] = 2 * (xy - wz);
+  m[0][2] = 2 * (xz + wy);
+  m[1][0] = 2 * (xy + wz);
+  m[1][1] = 1 - 2 * (xx + zz);
+  m[1][2] = 2 * (yz - wx);
+  m[2][0] = 2 * (xz - wy);
+  m[2][1] = 2 * (yz + wx);
+  m[2][2] = 1 - 2 * (xx + yy);
+  // Rotations are orthogonal, so the inverse is the transpose.
+  return Transform(m, glm::transpose(m));
+}
+
+Quaternion Slerp(Float t, const Quaternion &q1, const Quaternion &q2) {
+  Float cosTheta = Dot(q1, q2);
+  if (cosTheta > .9995f) return Normalize((1 - t) * q1 + t * q2);
+  Float theta = std::acos(Clamp(cosTheta, -1, 1));
+  Float thetap = theta * t;
+  Quaternion qperp = Normalize(q2 - q1 * cosTheta);
+  return q1 * std::cos(thetap) + qperp * std::sin(thetap);
+}
@@ -0,0 +1,62 @@
+#ifndef PHR_CORE_QUATERNION_H
+#define PHR_CORE_QUATERNION_H
+
+#include "core/geometry.h"
+#include "core/phr.h"
+
+class Transform;
+
+// A rotation, as the unit quaternion (v sin(theta / 2), cos(theta / 2)) of a
+// rotation by theta about the axis v.
+struct Quaternion {
+  Quaternion() : v(0, 0, 0), w(1) {}
+  Quaternion(const Vector3f &v, Float w) : v(v), w(w) {}
+  // The rotation part of _t_, which must be a rotation matrix.
+  explicit Quaternion(const Transform &t);
+
+  Quaternion &operator+=(const Quaternion &q) {
+    v = v + q.v;
+    w += q.w;
+    return *this;
+  }
+  Quaternion operator+(const Quaternion &q) const {
+    return Quaternion(v + q.v, w + q.w);
+  }
+  Quaternion operator-(const Quaternion &q) const {
+    return Quaternion(v - q.v, w - q.w);
+  }
+  Quaternion operator-() const { return Quaternion(-v, -w); }
+  Quaternion operator*(Float f) const { return Quaternion(v * f, w * f); }
+  Quaternion operator/(Float f) const { return Quaternion(v / f, w / f); }
+  bool operator==(const Quaternion &q) const { return v == q.v && w == q.w; }
+
+  Transform ToTransform() const;
+
+  Vector3f v;
+  Float w;
+};
+
+inline Quaternion operator*(Float f, const Quaternion &q) { return q * f; }
+
+inline Float Dot(const Quaternion &q1, const Quaternion &q2) {
+  return Dot(q1.v, q2.v) + q1.w * q2.w;
+}
+
+inline Quaternion Normalize(const Quaternion &q) {
+  return q / std::sqrt(Dot(q, q));
+}
+
+// The angle between the unit quaternions _q1_ and _q2_, which is half the
+// angle of the rotation taking one to the other. Computed from the chord
+// rather than with acos(Dot()), which loses all precision for nearby
+// rotations.
+inline Float AngleBetween(const Quaternion &q1, const Quaternion &q2) {
+  Quaternion d = q1 - q2, s = q1 + q2;
+  return 2 * std::atan2(std::sqrt(Dot(d, d)), std::sqrt(Dot(s, s)));
+}
+
+// Spherical linear interpolation from _q1_ at _t_ = 0 to _q2_ at _t_ = 1,
+// which turns at a constant rate.
+Quaternion Slerp(Float t, const Quaternion &q1, const Quaternion &q2);
+
+#endif  // PHR_CORE_QUATERNION_H
@@ -0,0 +1,86 @@
+#ifndef PHR_CORE_RAYPACKET_H
+#define PHR_CORE_RAYPACKET_H
+
+#include "core/geometry.h"
+#include "core/phr.h"
+#include "core/simd.h"
+
+// Eight rays traced together. The _rays_ are what primitives see; the
+// structure-of-arrays copies of their origins, inverse directions and tMax
+// feed the box tests, which check all eight rays against one box at once.
+// Only rays whose bit is set in _activeMask_ take part.
+struct alignas(32) RayPacket8 {
+  static constexpr int Size = 8;
+
+  RayPacket8() : activeMask(0) {}
+
+  void Set(int i, const Ray &ray) {
+    rays[i] = ray;
+    for (int a = 0; a < 3; ++a) {
+      o[a][i] = ray.o[a];
+      invDir[a][i] = 1 / ray.d[a];
+    }
+    tMax[i] = ray.tMax;
+    activeMask |= 1 << i;
+  }
+  // Copies ray _i_'s tMax back after a primitive has shortened it.
+  void SyncTMax(int i) { tMax[i] = rays[i].tMax; }
+
+  Ray rays[Size];
+  float o[3][Size], invDir[3][Size], tMax[Size];
+  int activeMask;
+};
+
+// Returns a mask of the rays in _activeMask_ that hit _b_ within their
+// [0, tMax] range.
+inline int IntersectBounds(const Bounds3f &b, const RayPacket8 &p,
+                           int activeMask) {
+  const float farScale = 1 + 2 * gamma(3);
+#if defined(PHR_HAVE_AVX)
+  __m256 t0 = _mm256_setzero_ps(), t1 = _mm256_load_ps(p.tMax);
+  for (int a = 0; a < 3; ++a) {
+    __m256 o = _mm256_load_ps(p.o[a]), invDir = _mm256_load_ps(p.invDir[a]);
+    __m256 tA = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(b.pMin[a]), o),
+                              invDir);
+    __m256 tB = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(b.pMax[a]), o),
+                              invDir);
+    t0 = _mm256_max_ps(t0, _mm256_min_ps(tA, tB));
+    t1 = _mm256_min_ps(
+        t1, _mm256_mul_ps(_mm256_max_ps(tA, tB), _mm256_set1_ps(farScale)));
+  }
+  return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)) & activeMask;
+#elif defined(PHR_HAVE_SSE)
+  int mask = 0;
+  for (int half = 0; half < 2; ++half) {
+    const int i = 4 * half;
+    __m128 t0 = _mm_setzero_ps(), t1 = _mm_load_ps(&p.tMax[i]);
+    for (int a = 0; a < 3; ++a) {
+      __m128 o = _mm_load_ps(&p.o[a][i]), invDir = _mm_load_ps(&p.invDir[a][i]);
+      __m128 tA = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(b.pMin[a]), o), invDir);
+      __m128 tB = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(b.pMax[a]), o), invDir);
+      t0 = _mm_max_ps(t0, _mm_min_ps(tA, tB));
+      t1 = _mm_min_ps(t1, _mm_mul_ps(_mm_max_ps(tA, tB),
+                                     _mm_set1_ps(farScale)));
+    }
+    mask |= _mm_movemask_ps(_mm_cmple_ps(t0, t1)) << i;
+  }
+  return mask & activeMask;
+#else
+  int mask = 0;
+  for (int i = 0; i < RayPacket8::Size; ++i) {
+    if (!(activeMask & (1 << i))) continue;
+    float t0 = 0, t1 = p.tMax[i];
+    for (int a = 0; a < 3; ++a) {
+      float tA = (b.pMin[a] - p.o[a][i]) * p.invDir[a][i];
+      float tB = (b.pMax[a] - p.o[a][i]) * p.invDir[a][i];
+      if (tA > tB) std::swap(tA, tB);
+      t0 = tA > t0 ? tA : t0;
+      t1 = tB * farScale < t1 ? tB * farScale : t1;
+    }
+    if (t0 <= t1) mask |= 1 << i;
+  }
+  return mask;
+#endif
+}
+
+#endif  // PHR_CORE_RAYPACKET_H
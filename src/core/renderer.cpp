@@ -0,0 +1,262 @@
+#include "core/renderer.h"
+
+#include <algorithm>
+
+#include "core/interaction.h"
+#include "core/primitive.h"
+#include "core/spectrums/heroSpectrum.h"
+#include "core/spectrums/spectrum.h"
+#include "samplers/independent.h"
+
+Vector3f ShadeRay(const Ray &ray, const Scene &scene, MemoryArena &arena) {
+  SurfaceInteraction isect;
+  if (!scene.Intersect(ray, &isect)) return Vector3f(0, 0, 0);
+  return ShadeHit(ray, isect, arena);
+}
+
+Vector3f ShadeHit(const Ray &ray, SurfaceInteraction &isect,
+                  MemoryArena &arena) {
+  if (isect.primitive)
+    isect.primitive->computeScatterFunctions(&isect, arena, TransportMode(),
+                                             true);
+  Vector3f n = Normalize(Vector3f(isect.shading.n));
+  Float cosTheta = std::abs(Dot(n, Normalize(ray.d)));
+  return Vector3f(0.5f * (n.x + 1) * cosTheta, 0.5f * (n.y + 1) * cosTheta,
+                  0.5f * (n.z + 1) * cosTheta);
+}
+
+Vector3f SpectralShade(const Vector3f &rgb, SpectrumMode mode, Float u) {
+  Float in[3] = {rgb.x, rgb.y, rgb.z}, out[3];
+  switch (mode) {
+    case SpectrumMode::Sampled:
+      SampledSpectrum::FromRGB(in).ToRGB(out);
+      break;
+    case SpectrumMode::Hero: {
+      HeroWavelengths wl = HeroWavelengths::Sample(u);
+      HeroSpectrum::FromRGB(in, wl).ToRGB(wl, out);
+      break;
+    }
+    case SpectrumMode::RGB:
+    default:
+      return rgb;
+  }
+  return Vector3f(out[0], out[1], out[2]);
+}
+
+namespace {
+
+// Sample _index_ of _pixel_.
+struct CameraSample {
+  Point2i pixel;
+  int index;
+};
+
+// What Render() and RenderAdaptive() share: generating the camera rays of a
+// batch of samples, tracing them, in packets of eight when asked to, and
+// passing the radiance of each sample, through the spectral mode, to a
+// callback. Without a sampler the rays go through pixel centres.
+class SampleTracer {
+ public:
+  SampleTracer(const Scene &scene, const PerspectiveCamera &camera,
+               const Sampler *sampler, SpectrumMode spectrumMode,
+               bool usePackets)
+      : scene(scene),
+        camera(camera),
+        sampler(sampler),
+        spectrumMode(spectrumMode),
+        usePackets(usePackets) {}
+
+  template <typename AddSample>
+  void Trace(const CameraSample *samples, int n, MemoryArena &arena,
+             AddSample addSample) const {
+    if (!usePackets) {
+      for (int i = 0; i < n; ++i) {
+        Vector3f L = ShadeRay(cameraRay(samples[i]), scene, arena);
+        addSample(samples[i], spectral(samples[i], L));
+        arena.Reset();
+      }
+      return;
+    }
+    for (int i0 = 0; i0 < n; i0 += RayPacket8::Size) {
+      int m = std::min(RayPacket8::Size, n - i0);
+      RayPacket8 packet;
+      for (int i = 0; i < m; ++i) packet.Set(i, cameraRay(samples[i0 + i]));
+      SurfaceInteraction isects[RayPacket8::Size];
+      int hitMask = scene.Intersect(packet, isects);
+      for (int i = 0; i < m; ++i) {
+        Vector3f L = (hitMask & (1 << i))
+                         ? ShadeHit(packet.rays[i], isects[i], arena)
+                         : Vector3f(0, 0, 0);
+        addSample(samples[i0 + i], spectral(samples[i0 + i], L));
+        arena.Reset();
+      }
+    }
+  }
+
+ private:
+  Ray cameraRay(const CameraSample &s) const {
+    const Point2i &p = s.pixel;
+    if (!sampler) return camera.GenerateRay(Point2f(p.x + 0.5f, p.y + 0.5f));
+    Point2f u = sampler->Get2D(p, s.index, FilmSampleDimension);
+    return camera.GenerateRay(Point2f(p.x + u.x, p.y + u.y),
+                              sampler->Get1D(p, s.index, TimeSampleDimension));
+  }
+
+  Vector3f spectral(const CameraSample &s, const Vector3f &L) const {
+    if (spectrumMode == SpectrumMode::RGB) return L;
+    // Pixel centres still need random wavelengths.
+    const Sampler &wavelengths = sampler ? *sampler : centreSampler;
+    return SpectralShade(
+        L, spectrumMode,
+        wavelengths.Get1D(s.pixel, s.index, WavelengthSampleDimension));
+  }
+
+  const Scene &scene;
+  const PerspectiveCamera &camera;
+  const Sampler *sampler;
+  const SpectrumMode spectrumMode;
+  const bool usePackets;
+  const IndependentSampler centreSampler{1};
+};
+
+}  // namespace
+
+void Render(const Scene &scene, const PerspectiveCamera &camera,
+            TileScheduler &scheduler, std::vector<Float> *rgb,
+            bool usePackets, ArenaPool *arenas, SpectrumMode spectrumMode,
+            const Sampler *sampler) {
+  const Point2i &res = camera.Resolution();
+  rgb->assign(3 * res.x * res.y, 0);
+  std::unique_ptr<ArenaPool> ownArenas;
+  if (!arenas) {
+    ownArenas = std::make_unique<ArenaPool>(scheduler.ThreadCount());
+    arenas = ownArenas.get();
+  }
+  SampleTracer tracer(scene, camera, sampler, spectrumMode, usePackets);
+  const int spp = sampler ? sampler->SamplesPerPixel() : 1;
+  const Float invSpp = Float(1) / spp;
+  auto addSample = [&](const CameraSample &s, const Vector3f &L) {
+    Float *pixel = &(*rgb)[3 * (s.pixel.y * res.x + s.pixel.x)];
+    pixel[0] += L.x * invSpp;
+    pixel[1] += L.y * invSpp;
+    pixel[2] += L.z * invSpp;
+  };
+  scheduler.Run([&](const Bounds2i &tile, int threadIndex) {
+    MemoryArena &arena = (*arenas)[threadIndex];
+    // Each batch holds the same sample of eight neighbouring pixels.
+    for (int y = tile.pMin.y; y < tile.pMax.y; ++y)
+      for (int x0 = tile.pMin.x; x0 < tile.pMax.x; x0 += RayPacket8::Size) {
+        int n = std::min(RayPacket8::Size, tile.pMax.x - x0);
+        for (int index = 0; index < spp; ++index) {
+          CameraSample batch[RayPacket8::Size];
+          for (int i = 0; i < n; ++i) batch[i] = {Point2i(x0 + i, y), index};
+          tracer.Trace(batch, n, arena, addSample);
+        }
+      }
+  });
+}
+
+int64_t RenderAdaptive(const Scene &scene, const PerspectiveCamera &camera,
+                       TileScheduler &scheduler, const Sampler &sampler,
+                       const AdaptiveSettings &settings, VarianceFilm *film,
+                       bool usePackets, ArenaPool *arenas,
+                       SpectrumMode spectrumMode) {
+  const Point2i &res = camera.Resolution();
+  *film = VarianceFilm(res);
+  std::unique_ptr<ArenaPool> ownArenas;
+  if (!arenas) {
+    ownArenas = std::make_unique<ArenaPool>(scheduler.ThreadCount());
+    arenas = ownArenas.get();
+  }
+  SampleTracer tracer(scene, camera, &sampler, spectrumMode, usePackets);
+  const int64_t budget = int64_t(sampler.SamplesPerPixel()) * res.x * res.y;
+  const int minSamples =
+      Clamp(settings.minSamples, 1, sampler.SamplesPerPixel());
+  const int maxSamples = std::max(settings.maxSamples, minSamples);
+
+  // The sample count each pixel is to reach in the current round.
+  std::vector<int> target(size_t(res.x) * res.y, minSamples);
+  auto renderTile = [&](const Bounds2i &tile, int threadIndex) {
+    MemoryArena &arena = (*arenas)[threadIndex];
+    auto addSample = [&](const CameraSample &s, const Vector3f &L) {
+      film->AddSample(s.pixel, L);
+    };
+    // After the first round only scattered pixels are still refined, so
+    // batches are filled with consecutive samples of the same pixel, which
+    // are more coherent than a sparse row.
+    CameraSample batch[RayPacket8::Size];
+    int n = 0;
+    for (int y = tile.pMin.y; y < tile.pMax.y; ++y)
+      for (int x = tile.pMin.x; x < tile.pMax.x; ++x) {
+        Point2i p(x, y);
+        int first = film->SampleCount(p);
+        for (int index = first; index < target[size_t(y) * res.x + x];
+             ++index) {
+          batch[n++] = {p, index};
+          if (n == RayPacket8::Size) {
+            tracer.Trace(batch, n, arena, addSample);
+            n = 0;
+          }
+        }
+      }
+    tracer.Trace(batch, n, arena, addSample);
+  };
+
+  // Every pixel takes the minimum first, so its error can be estimated.
+  int64_t used = int64_t(minSamples) * res.x * res.y;
+  scheduler.Run(renderTile);
+
+  std::vector<Float> error(target.size());
+  std::vector<Float> tileError(scheduler.TileCount());
+  std::vector<int64_t> tileCost(scheduler.TileCount());
+  std::vector<int> order, selected;
+  for (;;) {
+    for (int y = 0; y < res.y; ++y)
+      for (int x = 0; x < res.x; ++x)
+        error[size_t(y) * res.x + x] = film->RelativeError(Point2i(x, y));
+    // A pixel is refined while its own error or a neighbour's is above the
+    // threshold, so a small feature that the first samples of one pixel all
+    // missed is still found through the pixels around it. Doubling the count
+    // keeps every pixel at a power-of-two multiple of the minimum, where the
+    // low-discrepancy samplers are best stratified.
+    auto localError = [&](int x, int y) {
+      Float e = 0;
+      for (int dy = std::max(y - 1, 0); dy <= std::min(y + 1, res.y - 1); ++dy)
+        for (int dx = std::max(x - 1, 0); dx <= std::min(x + 1, res.x - 1);
+             ++dx)
+          e = std::max(e, error[size_t(dy) * res.x + dx]);
+      return e;
+    };
+    order.clear();
+    for (int t = 0; t < scheduler.TileCount(); ++t) {
+      const Bounds2i &tile = scheduler.Tile(t);
+      tileError[t] = 0;
+      tileCost[t] = 0;
+      for (int y = tile.pMin.y; y < tile.pMax.y; ++y)
+        for (int x = tile.pMin.x; x < tile.pMax.x; ++x) {
+          int n = film->SampleCount(Point2i(x, y));
+          Float e = n < maxSamples ? localError(x, y) : 0;
+          int next = e > settings.threshold ? std::min(2 * n, maxSamples) : n;
+          target[size_t(y) * res.x + x] = next;
+          tileError[t] = std::max(tileError[t], e);
+          tileCost[t] += next - n;
+        }
+      if (tileCost[t] > 0) order.push_back(t);
+    }
+    // The samples the converged tiles saved go to the noisiest of the rest
+    // first. Tiles that do not fit in what is left of the budget sit this
+    // round out.
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      return tileError[a] > tileError[b];
+    });
+    selected.clear();
+    for (int t : order) {
+      if (used + tileCost[t] > budget) continue;
+      used += tileCost[t];
+      selected.push_back(t);
+    }
+    if (selected.empty()) break;
+    scheduler.Run(selected, renderTile);
+  }
+  return used;
+}
@@ -0,0 +1,85 @@
+#ifndef PHR_CORE_RENDERER_H
+#define PHR_CORE_RENDERER_H
+
+#include <vector>
+
+#include "core/camera.h"
+#include "core/film.h"
+#include "core/geometry.h"
+#include "core/sampler.h"
+#include "core/scene.h"
+#include "core/tilescheduler.h"
+#include "core/util/MemoryArena.h"
+
+// There are no lights or materials yet, so a hit is shaded by its normal,
+// scaled by the cosine to the viewer. Misses are black. Scattering functions
+// for the hit are allocated from _arena_, which the caller resets once the
+// sample is done.
+Vector3f ShadeHit(const Ray &ray, SurfaceInteraction &isect,
+                  MemoryArena &arena);
+Vector3f ShadeRay(const Ray &ray, const Scene &scene, MemoryArena &arena);
+
+// How colour is carried from the shading result to the film.
+enum class SpectrumMode {
+  // Linear RGB throughout.
+  RGB,
+  // A SampledSpectrum of nSpectralSamples coefficients, converted to RGB
+  // exactly.
+  Sampled,
+  // Four hero wavelengths per camera ray, converted through the CIE curves;
+  // unbiased, but each sample carries colour noise.
+  Hero,
+};
+
+// Takes the linear RGB shading result _rgb_ through the spectral
+// representation _mode_ and back, as a renderer with spectral materials
+// would: upsampled as a reflectance, then integrated against the matching
+// curves. _u_ picks the hero wavelengths.
+Vector3f SpectralShade(const Vector3f &rgb, SpectrumMode mode, Float u);
+
+// Renders the image one tile at a time on _scheduler_. _rgb_ is resized to
+// three Floats per pixel, rows top to bottom. With _usePackets_, camera rays
+// are traced eight at a time along each tile row.
+//
+// Without a _sampler_, each pixel gets one sample through its centre at
+// mid-shutter. With one, it gets _sampler_->SamplesPerPixel() samples at the
+// film positions, times and wavelengths the sampler gives, averaged with a
+// box filter.
+//
+// Each worker allocates per-sample memory from its own arena in _arenas_,
+// reset after every sample; pass a pool to read its high-water marks
+// afterwards. Without one, Render() uses a pool of its own.
+void Render(const Scene &scene, const PerspectiveCamera &camera,
+            TileScheduler &scheduler, std::vector<Float> *rgb,
+            bool usePackets = true, ArenaPool *arenas = nullptr,
+            SpectrumMode spectrumMode = SpectrumMode::RGB,
+            const Sampler *sampler = nullptr);
+
+struct AdaptiveSettings {
+  // A pixel stops taking samples once VarianceFilm::RelativeError() is at
+  // most this, for it and for its neighbours.
+  Float threshold = 0.01f;
+  // Samples every pixel takes before its error is estimated, at most the
+  // sampler's SamplesPerPixel().
+  int minSamples = 16;
+  // The most samples any one pixel takes.
+  int maxSamples = 4096;
+};
+
+// Renders with the same budget of samples as Render() with _sampler_,
+// SamplesPerPixel() for every pixel, but spent where the image is noisy.
+// Every pixel takes _settings_.minSamples samples; then, round by round,
+// the pixels whose error is still above the threshold double their count.
+// Tiles where every pixel has converged drop out, and the samples they
+// saved go to the tiles with the largest error first, until the budget is
+// spent or nothing is left to refine. _film_ is reset to the camera
+// resolution and receives the samples; the image is its mean, and its
+// sample counts show where the budget went. Returns the number of samples
+// taken. The result does not depend on the number of threads.
+int64_t RenderAdaptive(const Scene &scene, const PerspectiveCamera &camera,
+                       TileScheduler &scheduler, const Sampler &sampler,
+                       const AdaptiveSettings &settings, VarianceFilm *film,
+                       bool usePackets = true, ArenaPool *arenas = nullptr,
+                       SpectrumMode spectrumMode = SpectrumMode::RGB);
+
+#endif  // PHR_CORE_RENDERER_H
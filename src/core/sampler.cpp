@@ -0,0 +1,29 @@
+#include "core/sampler.h"
+
+#include "core/lowdiscrepancy.h"
+#include "samplers/independent.h"
+#include "samplers/pmj02.h"
+#include "samplers/sobol.h"
+#include "samplers/stratified.h"
+
+uint32_t Sampler::pixelSeed(const Point2i &pixel, uint32_t a,
+                            uint32_t b) const {
+  uint64_t p = (uint64_t(uint32_t(pixel.x)) << 32) | uint32_t(pixel.y);
+  uint64_t s = (uint64_t(seed) << 32) | b;
+  return uint32_t(HashSeed(p, a, s));
+}
+
+std::unique_ptr<Sampler> CreateSampler(SamplerType type, int samplesPerPixel,
+                                       uint32_t seed) {
+  switch (type) {
+    case SamplerType::Stratified:
+      return std::make_unique<StratifiedSampler>(samplesPerPixel, seed);
+    case SamplerType::Sobol:
+      return std::make_unique<SobolSampler>(samplesPerPixel, seed);
+    case SamplerType::PMJ02:
+      return std::make_unique<PMJ02Sampler>(samplesPerPixel, seed);
+    case SamplerType::Independent:
+    default:
+      return std::make_unique<IndependentSampler>(samplesPerPixel, seed);
+  }
+}
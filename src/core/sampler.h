@@ -0,0 +1,56 @@
+#ifndef PHR_CORE_SAMPLER_H
+#define PHR_CORE_SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+
+#include "core/geometry.h"
+#include "core/phr.h"
+
+enum class SamplerType { Independent, Stratified, Sobol, PMJ02 };
+
+// The sample dimensions the renderers consume: the film position, then the
+// time in the shutter interval and the hero wavelength.
+static constexpr int FilmSampleDimension = 0;
+static constexpr int TimeSampleDimension = 2;
+static constexpr int WavelengthSampleDimension = 3;
+
+// Generates the sample values of a pixel sampling pattern. A sample is
+// addressed by its pixel, its index within the pixel and its dimension, and
+// any of them can be evaluated directly, in constant time, without
+// generating the ones before it. Samplers hold no mutable state, so one
+// instance can be shared by every thread, and an image comes out bit-exact
+// whichever tiles each thread ends up rendering.
+//
+// Dimensions are stratified jointly in pairs, (0, 1), (2, 3) and so on, by
+// the samplers that stratify at all. Each pixel's pattern is decorrelated
+// from its neighbours' by hashing the pixel with _seed_.
+class Sampler {
+ public:
+  Sampler(int samplesPerPixel, uint32_t seed)
+      : samplesPerPixel(samplesPerPixel), seed(seed) {}
+  virtual ~Sampler() {}
+
+  // Sample _index_ of _pixel_ in dimension _dim_, in [0, 1). Indices past
+  // SamplesPerPixel() start a fresh, independent pattern.
+  virtual Float Get1D(const Point2i &pixel, int index, int dim) const = 0;
+  // Dimensions _dim_ and _dim_ + 1, where _dim_ is even.
+  Point2f Get2D(const Point2i &pixel, int index, int dim) const {
+    return Point2f(Get1D(pixel, index, dim), Get1D(pixel, index, dim + 1));
+  }
+
+  // The number of samples each pixel's pattern is designed for.
+  int SamplesPerPixel() const { return samplesPerPixel; }
+
+ protected:
+  // A 32-bit hash of _pixel_, _a_, _b_ and _seed_.
+  uint32_t pixelSeed(const Point2i &pixel, uint32_t a, uint32_t b = 0) const;
+
+  const int samplesPerPixel;
+  const uint32_t seed;
+};
+
+std::unique_ptr<Sampler> CreateSampler(SamplerType type, int samplesPerPixel,
+                                       uint32_t seed = 0);
+
+#endif  // PHR_CORE_SAMPLER_H
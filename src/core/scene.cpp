@@ -0,0 +1,150 @@
+#include "core/scene.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "shapes/objmesh.h"
+#include "shapes/sphere.h"
+
+Scene::Scene(std::unique_ptr<TransformCache> transforms,
+             std::shared_ptr<Primitive> aggregate,
+             const CameraDescription &camera,
+             std::vector<std::string> sourceFiles)
+    : camera(camera),
+      transforms(std::move(transforms)),
+      aggregate(aggregate),
+      bvh(dynamic_cast<const BVHAccelerator *>(aggregate.get())),
+      worldBound(aggregate->WorldBound()),
+      sourceFiles(std::move(sourceFiles)) {}
+
+int Scene::Intersect(RayPacket8 &packet, SurfaceInteraction *isects) const {
+  if (bvh) return bvh->Intersect(packet, isects);
+  int hitMask = 0;
+  for (int i = 0; i < RayPacket8::Size; ++i)
+    if ((packet.activeMask & (1 << i)) &&
+        aggregate->Intersect(packet.rays[i], &isects[i]))
+      hitMask |= 1 << i;
+  return hitMask;
+}
+
+// Reads "<tx ty tz> [<scale> [<angle> <ax ay az>]]" into _objectToWorld_.
+// With _complete_ set, the scale and rotation must be given too.
+static bool readPlacement(std::istream &in, bool complete,
+                          Transform *objectToWorld) {
+  Vector3f translation, axis;
+  Float scale, angle;
+  if (!(in >> translation.x >> translation.y >> translation.z)) return false;
+  *objectToWorld = Translate(translation);
+  if (!(in >> scale)) return !complete;
+  if (in >> angle) {
+    if (!(in >> axis.x >> axis.y >> axis.z)) return false;
+    *objectToWorld = *objectToWorld * Rotate(angle, axis);
+  } else if (complete) {
+    return false;
+  }
+  *objectToWorld = *objectToWorld * Scale(scale, scale, scale);
+  return true;
+}
+
+std::unique_ptr<Scene> LoadScene(const std::string &filename,
+                                 BVHSplitMethod splitMethod,
+                                 BVHLayout layout, int sahBuckets) {
+  std::ifstream in(filename);
+  if (!in)
+    throw std::runtime_error("LoadScene: unable to open \"" + filename +
+                             "\".\n");
+
+  CameraDescription camera;
+  auto transforms = std::make_unique<TransformCache>();
+  std::vector<std::shared_ptr<Primitive>> primitives;
+  std::vector<std::string> sourceFiles = {filename};
+  std::map<std::string, std::shared_ptr<Primitive>> objects;
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    std::istringstream ss(line);
+    std::string keyword;
+    if (!(ss >> keyword) || keyword[0] == '#') continue;
+
+    bool ok = false;
+    if (keyword == "camera") {
+      ok = bool(ss >> camera.pos.x >> camera.pos.y >> camera.pos.z >>
+                camera.look.x >> camera.look.y >> camera.look.z >>
+                camera.up.x >> camera.up.y >> camera.up.z >> camera.fov);
+    } else if (keyword == "sphere") {
+      Float x, y, z, radius;
+      ok = bool(ss >> x >> y >> z >> radius);
+      if (ok) {
+        const Transform *objectToWorld, *worldToObject;
+        transforms->Lookup(Translate(Vector3f(x, y, z)), &objectToWorld,
+                           &worldToObject);
+        std::shared_ptr<Shape> shape =
+            std::make_shared<Sphere>(objectToWorld, worldToObject, false,
+                                     radius, -radius, radius, 360);
+        primitives.push_back(
+            std::make_shared<GeometricPrimitive>(shape, nullptr, nullptr));
+      }
+    } else if (keyword == "mesh" || keyword == "object") {
+      std::string name, meshFile;
+      ok = bool(keyword == "mesh" ? ss >> meshFile : ss >> name >> meshFile);
+      if (ok) {
+        // Relative paths are resolved against the scene file's directory.
+        size_t slash = filename.find_last_of('/');
+        if (meshFile[0] != '/' && slash != std::string::npos)
+          meshFile = filename.substr(0, slash + 1) + meshFile;
+        const Transform *identity = transforms->Lookup(Transform());
+        sourceFiles.push_back(meshFile);
+        std::vector<std::shared_ptr<Primitive>> meshPrimitives =
+            CreateGeometricPrimitives(
+                CreateOBJMesh(identity, identity, false, meshFile), nullptr,
+                nullptr);
+        if (keyword == "mesh")
+          primitives.insert(primitives.end(), meshPrimitives.begin(),
+                            meshPrimitives.end());
+        else
+          objects[name] = std::make_shared<BVHAccelerator>(
+              meshPrimitives, 4, splitMethod, true, layout, sahBuckets);
+      }
+    } else if (keyword == "instance" || keyword == "moving") {
+      std::string name;
+      Transform start, end;
+      ok = bool(ss >> name) &&
+           readPlacement(ss, keyword == "moving", &start) &&
+           (keyword == "instance" || readPlacement(ss, true, &end));
+      if (ok) {
+        auto object = objects.find(name);
+        if (object == objects.end())
+          throw std::runtime_error(filename + ":" +
+                                   std::to_string(lineNumber) +
+                                   ": unknown object \"" + name + "\".\n");
+        if (keyword == "instance") {
+          const Transform *primitiveToWorld, *worldToPrimitive;
+          transforms->Lookup(start, &primitiveToWorld, &worldToPrimitive);
+          primitives.push_back(std::make_shared<TransformedPrimitive>(
+              object->second, primitiveToWorld, worldToPrimitive));
+        } else {
+          AnimatedTransform motion(transforms->Lookup(start), 0,
+                                   transforms->Lookup(end), 1);
+          primitives.push_back(
+              std::make_shared<TransformedPrimitive>(object->second, motion));
+        }
+      }
+    }
+    if (!ok)
+      throw std::runtime_error(filename + ":" + std::to_string(lineNumber) +
+                               ": unable to parse \"" + line + "\".\n");
+  }
+  if (primitives.empty())
+    throw std::runtime_error("LoadScene: \"" + filename +
+                             "\" has no shapes.\n");
+
+  std::shared_ptr<Primitive> aggregate =
+      std::make_shared<BVHAccelerator>(primitives, 4, splitMethod,
+                                       true, layout, sahBuckets);
+  return std::make_unique<Scene>(std::move(transforms), aggregate, camera,
+                                 std::move(sourceFiles));
+}
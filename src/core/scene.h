@@ -0,0 +1,83 @@
+#ifndef PHR_CORE_SCENE_H
+#define PHR_CORE_SCENE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "accelerators/bvh.h"
+#include "core/geometry.h"
+#include "core/interaction.h"
+#include "core/primitive.h"
+#include "core/raypacket.h"
+#include "core/transform.h"
+#include "core/transformcache.h"
+
+struct CameraDescription {
+  Point3f pos = Point3f(0, 0, -5);
+  Point3f look = Point3f(0, 0, 0);
+  Vector3f up = Vector3f(0, 1, 0);
+  Float fov = 45;
+};
+
+// Owns everything a render needs: the shapes, the transforms they point at,
+// and the aggregate built over them.
+class Scene {
+ public:
+  // _sourceFiles_ lists the files the scene was read from, so caches built
+  // from it can tell when they are out of date.
+  Scene(std::unique_ptr<TransformCache> transforms,
+        std::shared_ptr<Primitive> aggregate, const CameraDescription &camera,
+        std::vector<std::string> sourceFiles = {});
+
+  bool Intersect(const Ray &ray, SurfaceInteraction *isect) const {
+    return aggregate->Intersect(ray, isect);
+  }
+  bool IntersectP(const Ray &ray) const { return aggregate->IntersectP(ray); }
+  // Packet traversal when the aggregate is a BVHAccelerator, otherwise one
+  // ray at a time. Returns a mask of the rays that hit.
+  int Intersect(RayPacket8 &packet, SurfaceInteraction *isects) const;
+  const Bounds3f &WorldBound() const { return worldBound; }
+  // The aggregate as a BVHAccelerator, or nullptr if it is something else.
+  const BVHAccelerator *BVH() const { return bvh; }
+  const std::vector<std::string> &SourceFiles() const { return sourceFiles; }
+  const TransformCache &Transforms() const { return *transforms; }
+
+ public:
+  const CameraDescription camera;
+
+ private:
+  std::unique_ptr<TransformCache> transforms;
+  std::shared_ptr<Primitive> aggregate;
+  const BVHAccelerator *bvh;
+  Bounds3f worldBound;
+  std::vector<std::string> sourceFiles;
+};
+
+// Reads a line-based scene description. Each non-empty line that does not
+// start with '#' is one of:
+//
+//   camera <px py pz> <lx ly lz> <ux uy uz> <fov>
+//   sphere <cx cy cz> <radius>
+//   mesh <file.obj>
+//   object <name> <file.obj>
+//   instance <name> <tx ty tz> [<scale> [<angle> <ax ay az>]]
+//   moving <name> <tx ty tz> <scale> <angle> <ax ay az>
+//                 <tx ty tz> <scale> <angle> <ax ay az>
+//
+// Mesh paths are relative to the directory of the scene file. An object is a
+// mesh with its own BVH that is not drawn by itself; each instance of it is
+// one TransformedPrimitive in the scene BVH, placed by scaling it uniformly,
+// rotating it _angle_ degrees about the axis, then translating it. A moving
+// instance goes from its first placement at shutter open (time 0) to its
+// second at shutter close (time 1).
+// The shapes are put in a BVH built with _splitMethod_, using _sahBuckets_
+// buckets per axis, and traversed in _layout_. Throws std::runtime_error if
+// the file cannot be read or is malformed.
+std::unique_ptr<Scene> LoadScene(
+    const std::string &filename,
+    BVHSplitMethod splitMethod = BVHSplitMethod::SAH,
+    BVHLayout layout = BVHLayout::Binary,
+    int sahBuckets = DefaultSAHBuckets);
+
+#endif  // PHR_CORE_SCENE_H
@@ -0,0 +1,550 @@
+#include "core/scenecache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "core/AllocAligned.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+
+namespace {
+
+constexpr char cacheMagic[8] = {'P', 'H', 'R', 'S', 'C', 'E', 'N', 'E'};
+constexpr uint32_t cacheVersion = 2;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t floatSize;
+  uint32_t nodeSize;
+  uint32_t maxPrimsInNode;
+  uint32_t splitMethod;
+  uint32_t sahBuckets;
+  // PrimitiveRecords::SphereBatch, the padding of the sphere record arrays
+  uint32_t sphereBatch;
+  uint32_t pad;
+  uint64_t fileSize;
+  Float camera[10];
+  uint64_t nSources, nSpheres, nMeshes, nPrimitives, nNodes;
+  uint64_t sourcesOffset, spheresOffset, meshesOffset, primitivesOffset,
+      nodesOffset;
+  // The BVH's PrimitiveRecords, one reference per primitive plus the sphere
+  // and triangle records, adopted as they are on load.
+  uint64_t nSphereRecords, nTriangleRecords;
+  uint64_t recordRefsOffset, sphereCenterOffset[3], sphereRadiusOffset,
+      sphereClipOffset, triangleRecordsOffset;
+};
+
+// Size and modification time of a file the scene was read from. The path
+// itself is stored right after the record.
+struct CacheSource {
+  int64_t modified;
+  uint64_t size;
+  uint64_t pathLength;
+};
+
+struct CacheTransform {
+  float m[16], mInv[16];
+};
+
+struct CacheSphere {
+  CacheTransform objectToWorld;
+  Float radius, zMin, zMax, phiMax;
+  uint32_t reverseOrientation;
+  uint32_t pad;
+};
+
+// Offsets are from the start of the file; nOffset and uvOffset are zero when
+// the mesh has no normals or uvs.
+struct CacheMesh {
+  CacheTransform objectToWorld;
+  uint64_t indicesOffset, pOffset, nOffset, uvOffset;
+  uint32_t nTriangles, nVertices;
+  uint32_t reverseOrientation;
+  uint32_t pad;
+};
+
+enum CachePrimitiveKind : uint32_t { CacheSpherePrim, CacheTrianglePrim };
+
+// One per BVH primitive, in leaf order. _shape_ indexes the sphere or mesh
+// table; _index_ is the triangle within the mesh.
+struct CachePrimitive {
+  uint32_t kind;
+  uint32_t shape;
+  uint32_t index;
+};
+
+uint64_t alignToCacheLine(uint64_t offset) {
+  return (offset + PBRT_L1_CACHE_LINE_SIZE - 1) &
+         ~uint64_t(PBRT_L1_CACHE_LINE_SIZE - 1);
+}
+
+CacheTransform toCache(const Transform &t) {
+  CacheTransform ct;
+  std::memcpy(ct.m, &t.GetMatrix(), sizeof(ct.m));
+  std::memcpy(ct.mInv, &t.GetInverseMatrix(), sizeof(ct.mInv));
+  return ct;
+}
+
+Transform fromCache(const CacheTransform &ct) {
+  glm::mat4 m, mInv;
+  std::memcpy(&m, ct.m, sizeof(ct.m));
+  std::memcpy(&mInv, ct.mInv, sizeof(ct.mInv));
+  return Transform(m, mInv);
+}
+
+// Reads the stamp of _path_; returns false if the file is gone.
+bool sourceStamp(const std::string &path, CacheSource *source) {
+  std::error_code ec;
+  auto modified = std::filesystem::last_write_time(path, ec);
+  if (ec) return false;
+  uintmax_t size = std::filesystem::file_size(path, ec);
+  if (ec) return false;
+  source->modified = int64_t(modified.time_since_epoch().count());
+  source->size = size;
+  return true;
+}
+
+bool hasMovingInstance(const std::vector<std::shared_ptr<Primitive>> &prims) {
+  for (const std::shared_ptr<Primitive> &prim : prims) {
+    auto tp = dynamic_cast<const TransformedPrimitive *>(prim.get());
+    if (tp && tp->Motion()) return true;
+  }
+  return false;
+}
+
+// Builds the file image section by section. Each section starts on a cache
+// line; the bytes are only copied out when the file is written.
+class CacheLayout {
+ public:
+  uint64_t Add(const void *data, uint64_t bytes) {
+    uint64_t offset = alignToCacheLine(size);
+    sections.push_back({offset, data, bytes});
+    size = offset + bytes;
+    return offset;
+  }
+  uint64_t Size() const { return alignToCacheLine(size); }
+
+  void Write(std::ofstream &out) const {
+    static const char zeros[PBRT_L1_CACHE_LINE_SIZE] = {};
+    uint64_t written = 0;
+    for (const Section &s : sections) {
+      out.write(zeros, s.offset - written);
+      out.write(static_cast<const char *>(s.data), s.bytes);
+      written = s.offset + s.bytes;
+    }
+    out.write(zeros, Size() - written);
+  }
+
+ private:
+  struct Section {
+    uint64_t offset;
+    const void *data;
+    uint64_t bytes;
+  };
+  std::vector<Section> sections;
+  uint64_t size = 0;
+};
+
+// Maps _filename_ read-only. Returns nullptr if the file cannot be opened.
+std::shared_ptr<const void> mapFile(const std::string &filename,
+                                    uint64_t *size) {
+#ifndef _WIN32
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+  *size = uint64_t(st.st_size);
+  void *ptr = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED)
+    throw std::runtime_error("LoadSceneCache: unable to map \"" + filename +
+                             "\".\n");
+  uint64_t length = *size;
+  return std::shared_ptr<const void>(ptr, [length](const void *p) {
+    munmap(const_cast<void *>(p), length);
+  });
+#else
+  // No mmap; read the file into an aligned buffer instead.
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  if (!in) return nullptr;
+  *size = uint64_t(in.tellg());
+  if (*size == 0) return nullptr;
+  char *data = AllocAligned<char>(*size);
+  std::shared_ptr<const void> storage(
+      data, [](const void *p) { FreeAligned(const_cast<void *>(p)); });
+  in.seekg(0);
+  if (!in.read(data, *size))
+    throw std::runtime_error("LoadSceneCache: unable to read \"" + filename +
+                             "\".\n");
+  return storage;
+#endif
+}
+
+// Bounds-checked view of a mapped cache file.
+class CacheView {
+ public:
+  CacheView(const std::string &filename, const void *base, uint64_t size)
+      : filename(filename),
+        base(static_cast<const uint8_t *>(base)),
+        size(size) {}
+
+  // Returns the _count_ records of type T at _offset_, checking that they are
+  // inside the file.
+  template <typename T>
+  const T *Get(uint64_t offset, uint64_t count) const {
+    if (offset % alignof(T) != 0 || offset > size ||
+        count > (size - offset) / sizeof(T))
+      throw Corrupt();
+    return reinterpret_cast<const T *>(base + offset);
+  }
+
+  std::runtime_error Corrupt() const {
+    return std::runtime_error("LoadSceneCache: \"" + filename +
+                              "\" is corrupt.\n");
+  }
+
+ private:
+  const std::string &filename;
+  const uint8_t *base;
+  uint64_t size;
+};
+
+}  // namespace
+
+void WriteSceneCache(const std::string &filename, const Scene &scene) {
+  const BVHAccelerator *bvh = scene.BVH();
+  if (!bvh)
+    throw std::runtime_error(
+        "WriteSceneCache: the scene aggregate is not a BVHAccelerator.\n");
+
+  // Sphere and mesh tables, plus the leaf-order primitive references
+  std::vector<CacheSphere> spheres;
+  std::vector<CacheMesh> meshes;
+  std::vector<const TriangleMesh *> meshData;
+  std::map<const Shape *, uint32_t> sphereIndex;
+  std::map<const TriangleMesh *, uint32_t> meshIndex;
+  std::vector<CachePrimitive> prims;
+  prims.reserve(bvh->Primitives().size());
+  for (const std::shared_ptr<Primitive> &prim : bvh->Primitives()) {
+    const GeometricPrimitive *gp =
+        dynamic_cast<const GeometricPrimitive *>(prim.get());
+    const Shape *shape = gp ? gp->GetShape() : nullptr;
+    if (const Sphere *sphere = dynamic_cast<const Sphere *>(shape)) {
+      auto inserted = sphereIndex.emplace(shape, uint32_t(spheres.size()));
+      if (inserted.second)
+        spheres.push_back({toCache(*sphere->objectToWorld), sphere->Radius(),
+                           sphere->ZMin(), sphere->ZMax(), sphere->PhiMax(),
+                           sphere->reverseOrientation, 0});
+      prims.push_back({CacheSpherePrim, inserted.first->second, 0});
+    } else if (const Triangle *tri = dynamic_cast<const Triangle *>(shape)) {
+      const TriangleMesh *mesh = &tri->GetMesh();
+      auto inserted = meshIndex.emplace(mesh, uint32_t(meshes.size()));
+      if (inserted.second) {
+        CacheMesh cm = {};
+        cm.objectToWorld = toCache(*tri->objectToWorld);
+        cm.nTriangles = uint32_t(mesh->nTriangles);
+        cm.nVertices = uint32_t(mesh->nVertices);
+        cm.reverseOrientation = tri->reverseOrientation;
+        meshes.push_back(cm);
+        meshData.push_back(mesh);
+      }
+      prims.push_back({CacheTrianglePrim, inserted.first->second,
+                       uint32_t(tri->TriangleIndex())});
+    } else if (dynamic_cast<const TransformedPrimitive *>(prim.get())) {
+      throw std::runtime_error(
+          hasMovingInstance(bvh->Primitives())
+              ? "WriteSceneCache: scenes with moving instances cannot be "
+                "cached.\n"
+              : "WriteSceneCache: scenes with instances cannot be cached.\n");
+    } else {
+      throw std::runtime_error(
+          "WriteSceneCache: only spheres and triangles can be cached.\n");
+    }
+  }
+
+  std::vector<CacheSource> sources;
+  std::vector<std::string> sourcePaths;
+  for (const std::string &file : scene.SourceFiles()) {
+    CacheSource source;
+    std::string path = std::filesystem::absolute(file).string();
+    if (!sourceStamp(path, &source))
+      throw std::runtime_error("WriteSceneCache: unable to stat \"" + file +
+                               "\".\n");
+    source.pathLength = path.size();
+    sources.push_back(source);
+    sourcePaths.push_back(path);
+  }
+
+  CacheHeader header = {};
+  std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+  header.version = cacheVersion;
+  header.floatSize = sizeof(Float);
+  header.nodeSize = sizeof(LinearBVHNode);
+  header.maxPrimsInNode = uint32_t(bvh->MaxPrimsInNode());
+  header.splitMethod = uint32_t(bvh->SplitMethod());
+  header.sahBuckets = uint32_t(bvh->SAHBuckets());
+  const CameraDescription &cd = scene.camera;
+  Float camera[10] = {cd.pos.x,  cd.pos.y,  cd.pos.z, cd.look.x, cd.look.y,
+                      cd.look.z, cd.up.x,   cd.up.y,  cd.up.z,   cd.fov};
+  std::memcpy(header.camera, camera, sizeof(camera));
+  header.nSources = sources.size();
+  header.nSpheres = spheres.size();
+  header.nMeshes = meshes.size();
+  header.nPrimitives = prims.size();
+  header.nNodes = uint64_t(bvh->TotalNodes());
+  const PrimitiveRecords::Arrays &records = bvh->Records().Data();
+  header.sphereBatch = PrimitiveRecords::SphereBatch;
+  header.nSphereRecords = uint64_t(records.nSpheres);
+  header.nTriangleRecords = uint64_t(records.nTriangles);
+
+  // Sections are only copied out by Write(), so the header and mesh records
+  // can still be filled in with offsets after they have been added.
+  CacheLayout layout;
+  layout.Add(&header, sizeof(header));
+  header.sourcesOffset = layout.Add(nullptr, 0);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    layout.Add(&sources[i], sizeof(CacheSource));
+    layout.Add(sourcePaths[i].data(), sourcePaths[i].size());
+  }
+  header.spheresOffset =
+      layout.Add(spheres.data(), spheres.size() * sizeof(CacheSphere));
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    const TriangleMesh *mesh = meshData[i];
+    meshes[i].indicesOffset =
+        layout.Add(mesh->vertexIndices, 3 * mesh->nTriangles * sizeof(int));
+    meshes[i].pOffset = layout.Add(mesh->p, mesh->nVertices * sizeof(Point3f));
+    if (mesh->n)
+      meshes[i].nOffset =
+          layout.Add(mesh->n, mesh->nVertices * sizeof(Normal3f));
+    if (mesh->uv)
+      meshes[i].uvOffset =
+          layout.Add(mesh->uv, mesh->nVertices * sizeof(Point2f));
+  }
+  header.meshesOffset =
+      layout.Add(meshes.data(), meshes.size() * sizeof(CacheMesh));
+  header.primitivesOffset =
+      layout.Add(prims.data(), prims.size() * sizeof(CachePrimitive));
+  header.nodesOffset =
+      layout.Add(bvh->Nodes(), header.nNodes * sizeof(LinearBVHNode));
+  header.recordRefsOffset =
+      layout.Add(records.refs, header.nPrimitives * sizeof(uint32_t));
+  // An empty BVH never builds its records, so there is no padding either.
+  uint64_t paddedSpheres =
+      records.refs ? header.nSphereRecords + header.sphereBatch : 0;
+  const Float *centers[3] = {records.centerX, records.centerY,
+                             records.centerZ};
+  for (int a = 0; a < 3; ++a)
+    header.sphereCenterOffset[a] =
+        layout.Add(centers[a], paddedSpheres * sizeof(Float));
+  header.sphereRadiusOffset =
+      layout.Add(records.radius, paddedSpheres * sizeof(Float));
+  header.sphereClipOffset = layout.Add(
+      records.sphereClip, header.nSphereRecords * sizeof(SphereClip));
+  header.triangleRecordsOffset =
+      layout.Add(records.triangles,
+                 header.nTriangleRecords * sizeof(TriangleRecord));
+  header.fileSize = layout.Size();
+
+  std::string tmpName = filename + ".tmp";
+  {
+    std::ofstream out(tmpName, std::ios::binary | std::ios::trunc);
+    if (!out)
+      throw std::runtime_error("WriteSceneCache: unable to open \"" + tmpName +
+                               "\" for writing.\n");
+    layout.Write(out);
+    if (!out)
+      throw std::runtime_error("WriteSceneCache: unable to write \"" +
+                               tmpName + "\".\n");
+  }
+  if (std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+    std::remove(tmpName.c_str());
+    throw std::runtime_error("WriteSceneCache: unable to rename \"" + tmpName +
+                             "\" to \"" + filename + "\".\n");
+  }
+}
+
+std::unique_ptr<Scene> LoadSceneCache(const std::string &filename,
+                                      BVHSplitMethod splitMethod,
+                                      BVHLayout layout, int sahBuckets) {
+  uint64_t fileSize = 0;
+  std::shared_ptr<const void> mapping = mapFile(filename, &fileSize);
+  if (!mapping || fileSize < sizeof(CacheHeader)) return nullptr;
+  CacheView view(filename, mapping.get(), fileSize);
+
+  const CacheHeader &header = *view.Get<CacheHeader>(0, 1);
+  if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+      header.version != cacheVersion || header.floatSize != sizeof(Float) ||
+      header.nodeSize != sizeof(LinearBVHNode) ||
+      header.splitMethod != uint32_t(splitMethod) ||
+      header.sahBuckets != uint32_t(sahBuckets) ||
+      header.sphereBatch != uint32_t(PrimitiveRecords::SphereBatch))
+    return nullptr;
+
+  if (header.fileSize != fileSize) throw view.Corrupt();
+
+  // The cache is stale if any source file changed after it was written.
+  std::vector<std::string> sourceFiles;
+  uint64_t offset = header.sourcesOffset;
+  for (uint64_t i = 0; i < header.nSources; ++i) {
+    offset = alignToCacheLine(offset);
+    const CacheSource *source = view.Get<CacheSource>(offset, 1);
+    offset = alignToCacheLine(offset + sizeof(CacheSource));
+    const char *path = view.Get<char>(offset, source->pathLength);
+    offset += source->pathLength;
+    sourceFiles.emplace_back(path, source->pathLength);
+    CacheSource current;
+    if (!sourceStamp(sourceFiles.back(), &current) ||
+        current.modified != source->modified || current.size != source->size)
+      return nullptr;
+  }
+
+  const CacheSphere *spheres =
+      view.Get<CacheSphere>(header.spheresOffset, header.nSpheres);
+  const CacheMesh *meshes =
+      view.Get<CacheMesh>(header.meshesOffset, header.nMeshes);
+  const CachePrimitive *prims =
+      view.Get<CachePrimitive>(header.primitivesOffset, header.nPrimitives);
+  const LinearBVHNode *nodes =
+      view.Get<LinearBVHNode>(header.nodesOffset, header.nNodes);
+  if (header.nPrimitives > uint64_t(std::numeric_limits<int>::max()) ||
+      header.nNodes > uint64_t(std::numeric_limits<int>::max()))
+    throw view.Corrupt();
+  // Traversal trusts the node array, so make sure it stays inside the file.
+  for (uint64_t i = 0; i < header.nNodes; ++i) {
+    const LinearBVHNode &node = nodes[i];
+    if (node.nPrimitives > 0
+            ? uint64_t(node.primitivesOffset) + node.nPrimitives >
+                  header.nPrimitives
+            : (int64_t(node.secondChildOffset) <= int64_t(i) + 1 ||
+               uint64_t(node.secondChildOffset) >= header.nNodes ||
+               node.axis > 2))
+      throw view.Corrupt();
+  }
+
+  // Leaf traversal indexes the records without checks too. Every reference
+  // must name a record of its primitive's kind, and the spheres leading a
+  // leaf must be consecutive since they are culled as one batch.
+  PrimitiveRecords::Arrays records;
+  if (header.nPrimitives > 0) {
+    if (header.nSphereRecords > PrimitiveRecords::IndexMask ||
+        header.nTriangleRecords > PrimitiveRecords::IndexMask)
+      throw view.Corrupt();
+    uint64_t paddedSpheres = header.nSphereRecords + header.sphereBatch;
+    records.refs =
+        view.Get<uint32_t>(header.recordRefsOffset, header.nPrimitives);
+    records.centerX =
+        view.Get<Float>(header.sphereCenterOffset[0], paddedSpheres);
+    records.centerY =
+        view.Get<Float>(header.sphereCenterOffset[1], paddedSpheres);
+    records.centerZ =
+        view.Get<Float>(header.sphereCenterOffset[2], paddedSpheres);
+    records.radius = view.Get<Float>(header.sphereRadiusOffset, paddedSpheres);
+    records.sphereClip = view.Get<SphereClip>(header.sphereClipOffset,
+                                              header.nSphereRecords);
+    records.triangles = view.Get<TriangleRecord>(header.triangleRecordsOffset,
+                                                 header.nTriangleRecords);
+    records.nPrimitives = int(header.nPrimitives);
+    records.nSpheres = int(header.nSphereRecords);
+    records.nTriangles = int(header.nTriangleRecords);
+    for (uint64_t i = 0; i < header.nPrimitives; ++i) {
+      uint32_t type = records.refs[i] >> PrimitiveRecords::IndexBits;
+      uint32_t index = records.refs[i] & PrimitiveRecords::IndexMask;
+      if (type == uint32_t(RecordType::Sphere)
+              ? prims[i].kind != CacheSpherePrim ||
+                    index >= header.nSphereRecords
+              : type == uint32_t(RecordType::Triangle)
+                    ? prims[i].kind != CacheTrianglePrim ||
+                          index >= header.nTriangleRecords
+                    : type != uint32_t(RecordType::Primitive))
+        throw view.Corrupt();
+    }
+    for (uint64_t i = 0; i < header.nNodes; ++i) {
+      const LinearBVHNode &node = nodes[i];
+      uint32_t first = node.primitivesOffset;
+      for (uint32_t j = 1; j < node.nPrimitives; ++j) {
+        uint32_t ref = records.refs[first + j];
+        if (ref >> PrimitiveRecords::IndexBits !=
+            uint32_t(RecordType::Sphere))
+          break;
+        if (ref != records.refs[first + j - 1] + 1) throw view.Corrupt();
+      }
+    }
+  }
+
+  auto transforms = std::make_unique<TransformCache>();
+
+  std::vector<std::shared_ptr<Shape>> sphereShapes(header.nSpheres);
+  for (uint64_t i = 0; i < header.nSpheres; ++i) {
+    const CacheSphere &cs = spheres[i];
+    const Transform *o2w, *w2o;
+    transforms->Lookup(fromCache(cs.objectToWorld), &o2w, &w2o);
+    sphereShapes[i] = std::make_shared<Sphere>(
+        o2w, w2o, cs.reverseOrientation != 0, cs.radius, cs.zMin, cs.zMax,
+        cs.phiMax >= 2 * Pi ? 360 : cs.phiMax * 180 / Pi);
+  }
+
+  std::vector<std::vector<std::shared_ptr<Shape>>> meshTriangles(
+      header.nMeshes);
+  for (uint64_t i = 0; i < header.nMeshes; ++i) {
+    const CacheMesh &cm = meshes[i];
+    const int *indices =
+        view.Get<int>(cm.indicesOffset, 3 * uint64_t(cm.nTriangles));
+    for (uint64_t j = 0; j < 3 * uint64_t(cm.nTriangles); ++j)
+      if (indices[j] < 0 || uint32_t(indices[j]) >= cm.nVertices)
+        throw view.Corrupt();
+    const Point3f *p = view.Get<Point3f>(cm.pOffset, cm.nVertices);
+    const Normal3f *n =
+        cm.nOffset ? view.Get<Normal3f>(cm.nOffset, cm.nVertices) : nullptr;
+    const Point2f *uv =
+        cm.uvOffset ? view.Get<Point2f>(cm.uvOffset, cm.nVertices) : nullptr;
+    const Transform *o2w, *w2o;
+    transforms->Lookup(fromCache(cm.objectToWorld), &o2w, &w2o);
+    meshTriangles[i] = CreateTriangles(
+        o2w, w2o, cm.reverseOrientation != 0,
+        std::make_shared<TriangleMesh>(cm.nTriangles, indices, cm.nVertices, p,
+                                       n, uv, mapping));
+  }
+
+  std::vector<std::shared_ptr<Shape>> shapes(header.nPrimitives);
+  for (uint64_t i = 0; i < header.nPrimitives; ++i) {
+    const CachePrimitive &cp = prims[i];
+    if (cp.kind == CacheSpherePrim && cp.shape < header.nSpheres)
+      shapes[i] = sphereShapes[cp.shape];
+    else if (cp.kind == CacheTrianglePrim && cp.shape < header.nMeshes &&
+             cp.index < meshes[cp.shape].nTriangles)
+      shapes[i] = meshTriangles[cp.shape][cp.index];
+    else
+      throw view.Corrupt();
+  }
+  std::vector<std::shared_ptr<Primitive>> primitives =
+      CreateGeometricPrimitives(shapes, nullptr, nullptr);
+
+  std::shared_ptr<Primitive> aggregate = std::make_shared<BVHAccelerator>(
+      std::move(primitives), header.nNodes ? nodes : nullptr,
+      int(header.nNodes), mapping, int(header.maxPrimsInNode), splitMethod,
+      layout, sahBuckets, header.nPrimitives > 0 ? &records : nullptr);
+
+  CameraDescription camera;
+  const Float *c = header.camera;
+  camera.pos = Point3f(c[0], c[1], c[2]);
+  camera.look = Point3f(c[3], c[4], c[5]);
+  camera.up = Vector3f(c[6], c[7], c[8]);
+  camera.fov = c[9];
+  return std::make_unique<Scene>(std::move(transforms), aggregate, camera,
+                                 std::move(sourceFiles));
+}
@@ -0,0 +1,47 @@
+#ifndef PHR_CORE_SCENECACHE_H
+#define PHR_CORE_SCENECACHE_H
+
+#include <memory>
+#include <string>
+
+#include "accelerators/bvh.h"
+#include "core/scene.h"
+
+// Binary scene caches let repeated renders of a static scene skip parsing and
+// the BVH build. A cache holds the camera, the sphere records, the world-space
+// vertex and index buffers of every triangle mesh, the primitive order of the
+// BVH, its flattened LinearBVHNode array and its leaf PrimitiveRecords, each
+// section aligned to a cache line. Loading maps the file read-only and
+// traverses the nodes, leaf records and vertex buffers straight from the
+// mapped pages.
+//
+// Loading is still linear in the scene size: it validates every node and
+// record, creates a Sphere (with a TransformCache lookup) per sphere, a
+// Triangle per mesh triangle and a GeometricPrimitive per primitive, and the
+// wide layouts rebuild their nodes from the binary ones. None of that
+// touches the geometry itself, so it stays a small fraction of a build.
+//
+// The format is tied to the build that wrote it: the version, sizeof(Float),
+// sizeof(LinearBVHNode) and the sphere record padding are all checked before
+// anything else is read.
+
+// Writes _scene_, whose aggregate must be a BVHAccelerator over spheres and
+// triangles, to _filename_. The file is written under a temporary name and
+// renamed into place, so concurrent readers never see a partial cache. Throws
+// std::runtime_error on failure, including for scenes with instances or
+// moving instances, whose shared BVHs and transforms the format has no
+// section for.
+void WriteSceneCache(const std::string &filename, const Scene &scene);
+
+// Maps the cache in _filename_ and rebuilds the scene around it. Returns
+// nullptr if there is no cache, if it was written by a different format
+// version or with a different _splitMethod_ or _sahBuckets_, or if any of
+// the files the scene was loaded from changed since. Throws
+// std::runtime_error if the file is corrupt.
+std::unique_ptr<Scene> LoadSceneCache(
+    const std::string &filename,
+    BVHSplitMethod splitMethod = BVHSplitMethod::SAH,
+    BVHLayout layout = BVHLayout::Binary,
+    int sahBuckets = DefaultSAHBuckets);
+
+#endif  // PHR_CORE_SCENECACHE_H
@@ -17,7 +17,9 @@ class Shape {
 
   virtual Bounds3f objectBound() const = 0;
 
-  Bounds3f worldBound() const { return (*objectToWorld)(objectBound()); }
+  virtual Bounds3f worldBound() const {
+    return (*objectToWorld)(objectBound());
+  }
 
   virtual bool intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
                          bool testAlphaTexture = true) const = 0;
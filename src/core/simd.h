@@ -0,0 +1,19 @@
+#ifndef PHR_CORE_SIMD_H
+#define PHR_CORE_SIMD_H
+
+// Compile-time SIMD selection. SSE is part of the x86-64 baseline; AVX is
+// only available when the compiler targets it (see PHR_ENABLE_AVX2). Code
+// using these macros must keep a scalar path for other targets.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define PHR_HAVE_SSE
+#endif
+#if defined(__AVX__)
+#define PHR_HAVE_AVX
+#endif
+#if defined(__AVX2__)
+#define PHR_HAVE_AVX2
+#endif
+
+#endif  // PHR_CORE_SIMD_H
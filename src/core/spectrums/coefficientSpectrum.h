@@ -1,91 +1,324 @@
-#ifndef PHR_CORE_SPECTRUM_COEFFICIENT_SPECTRUM_H
-#define PHR_CORE_SPECTRUM_COEFFICIENT_SPECTRUM_H
+#ifndef PHR_CORE_SPECTRUMS_COEFFICIENTSPECTRUM_H
+#define PHR_CORE_SPECTRUMS_COEFFICIENTSPECTRUM_H
 
 #include <cmath>
 
 #include "core/phr.h"
-#include "spectrum.h"
+#include "core/simd.h"
 
-// TODO: Add Lerp functionality
-static const int nCIESamples = 471;
-extern const Float CIE_X[nCIESamples];
-extern const Float CIE_Y[nCIESamples];
-extern const Float CIE_Z[nCIESamples];
+// Spectrum arithmetic is done a vector at a time: SSE where available, plus
+// AVX for the leading whole 8-sample blocks when the compiler targets it.
+#if defined(PHR_HAVE_SSE) && !defined(PHR_FLOAT_AS_DOUBLE)
+#define PHR_SPECTRUM_SSE
+static constexpr int SpectrumVectorWidth = 4;
+#ifdef PHR_HAVE_AVX
+#define PHR_SPECTRUM_AVX
+static constexpr int SpectrumAlignment = 32;
+#else
+static constexpr int SpectrumAlignment = 16;
+#endif
+#else
+static constexpr int SpectrumVectorWidth = 1;
+static constexpr int SpectrumAlignment = alignof(Float);
+#endif
 
+// The per-sample operations CoefficientSpectrum maps over its coefficients,
+// with one overload per vector width compiled in.
+struct SpectrumAdd {
+  Float operator()(Float a, Float b) const { return a + b; }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a, __m128 b) const { return _mm_add_ps(a, b); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a, __m256 b) const { return _mm256_add_ps(a, b); }
+#endif
+};
+
+struct SpectrumSub {
+  Float operator()(Float a, Float b) const { return a - b; }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a, __m128 b) const { return _mm_sub_ps(a, b); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a, __m256 b) const { return _mm256_sub_ps(a, b); }
+#endif
+};
+
+struct SpectrumMul {
+  Float operator()(Float a, Float b) const { return a * b; }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a, __m128 b) const { return _mm_mul_ps(a, b); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a, __m256 b) const { return _mm256_mul_ps(a, b); }
+#endif
+};
+
+struct SpectrumDiv {
+  Float operator()(Float a, Float b) const { return a / b; }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a, __m128 b) const { return _mm_div_ps(a, b); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a, __m256 b) const { return _mm256_div_ps(a, b); }
+#endif
+};
+
+struct SpectrumScale {
+  Float s;
+  Float operator()(Float a) const { return a * s; }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a) const { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a) const {
+    return _mm256_mul_ps(a, _mm256_set1_ps(s));
+  }
+#endif
+};
+
+struct SpectrumDivide {
+  Float s;
+  Float operator()(Float a) const { return a / s; }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a) const { return _mm_div_ps(a, _mm_set1_ps(s)); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a) const {
+    return _mm256_div_ps(a, _mm256_set1_ps(s));
+  }
+#endif
+};
+
+struct SpectrumSqrt {
+  Float operator()(Float a) const { return std::sqrt(a); }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a) const { return _mm_sqrt_ps(a); }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a) const { return _mm256_sqrt_ps(a); }
+#endif
+};
+
+// Like ::Clamp(), NaNs are passed through: min and max return their second
+// operand when either is NaN.
+struct SpectrumClamp {
+  Float low, high;
+  Float operator()(Float a) const { return ::Clamp(a, low, high); }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a) const {
+    return _mm_max_ps(_mm_set1_ps(low), _mm_min_ps(_mm_set1_ps(high), a));
+  }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a) const {
+    return _mm256_max_ps(_mm256_set1_ps(low),
+                         _mm256_min_ps(_mm256_set1_ps(high), a));
+  }
+#endif
+};
+
+// (1 - t) * a + t * b, as ::Lerp() computes it.
+struct SpectrumLerp {
+  Float t;
+  Float operator()(Float a, Float b) const { return ::Lerp(t, a, b); }
+#ifdef PHR_SPECTRUM_SSE
+  __m128 operator()(__m128 a, __m128 b) const {
+    return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1 - t), a),
+                      _mm_mul_ps(_mm_set1_ps(t), b));
+  }
+#endif
+#ifdef PHR_SPECTRUM_AVX
+  __m256 operator()(__m256 a, __m256 b) const {
+    return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(1 - t), a),
+                         _mm256_mul_ps(_mm256_set1_ps(t), b));
+  }
+#endif
+};
+
+// A spectrum represented by _nSpectrumSamples_ coefficients, each scaled
+// independently. The coefficients are stored aligned and padded to a whole
+// number of vectors, so every operation runs on full registers with no
+// scalar tail; a three-sample spectrum is a single SSE register. What the
+// padding lanes hold is unspecified, and comparisons and reductions ignore
+// them.
 template <int nSpectrumSamples>
 class CoefficientSpectrum {
  public:
-  CoefficientSpectrum(Float v = 0.f) {
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      c[i] = v;
-    }
-  }
+  static constexpr int nSamples = nSpectrumSamples;
+  static constexpr int nPadded = (nSpectrumSamples + SpectrumVectorWidth - 1) /
+                                 SpectrumVectorWidth * SpectrumVectorWidth;
 
-  static void Init() {
-    for (int i = 0; i < nSpectralSamples; ++i) {
-      Float w10 = Lerp(Float(i) / Float(nSpectralSamples), sampledLambdaStart,
-                       sampledLambdaEnd);
-      Float w11 = Lerp(Float)
-    }
+  CoefficientSpectrum(Float v = 0.f) {
+    for (int i = 0; i < nPadded; ++i) c[i] = v;
   }
 
   bool IsBlack() const {
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      if (c[i] != 0.) return false;
-      return true;
+#ifdef PHR_SPECTRUM_SSE
+    for (int i = 0; i < nPadded; i += 4) {
+      int nonZero = _mm_movemask_ps(
+          _mm_cmpneq_ps(_mm_load_ps(&c[i]), _mm_setzero_ps()));
+      if (i + 4 > nSamples) nonZero &= (1 << (nSamples - i)) - 1;
+      if (nonZero) return false;
     }
+#else
+    for (int i = 0; i < nSamples; ++i)
+      if (c[i] != 0.) return false;
+#endif
+    return true;
   }
 
   CoefficientSpectrum Clamp(Float low = 0, Float high = Infinity) const {
-    CoefficientSpectrum ret;
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      ret.c[i] = ::Clamp(c[i], low, high);
-    }
+    return map(*this, SpectrumClamp{low, high});
+  }
+  Float MaxComponentValue() const {
+    Float m = c[0];
+    for (int i = 1; i < nSamples; ++i) m = std::max(m, c[i]);
+    return m;
   }
 
   friend CoefficientSpectrum Sqrt(const CoefficientSpectrum &s) {
-    CoefficientSpectrum ret;
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      ret.c[i] = std::sqrt(s.c[i]);
-    }
+    return map(s, SpectrumSqrt());
   }
   friend CoefficientSpectrum Pow(const CoefficientSpectrum &s, Float pow) {
     CoefficientSpectrum ret;
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      ret.c[i] = std::pow(s.c[i], pow);
-    }
+    for (int i = 0; i < nSamples; ++i) ret.c[i] = std::pow(s.c[i], pow);
+    return ret;
   }
   friend CoefficientSpectrum Exp(const CoefficientSpectrum &s) {
     CoefficientSpectrum ret;
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      ret.c[i] = std::exp(s.c[i]);
-    }
+    for (int i = 0; i < nSamples; ++i) ret.c[i] = std::exp(s.c[i]);
+    return ret;
+  }
+  friend CoefficientSpectrum Lerp(Float t, const CoefficientSpectrum &s1,
+                                  const CoefficientSpectrum &s2) {
+    return map(s1, s2, SpectrumLerp{t});
+  }
+  // The sum of the products of the coefficients of _s1_ and _s2_.
+  friend Float Dot(const CoefficientSpectrum &s1,
+                   const CoefficientSpectrum &s2) {
+    int i = 0;
+    Float sum = 0;
+#ifdef PHR_SPECTRUM_SSE
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= nSamples; i += 4)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(&s1.c[i]),
+                                       _mm_load_ps(&s2.c[i])));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < nSamples; ++i) sum += s1.c[i] * s2.c[i];
+    return sum;
   }
 
   CoefficientSpectrum &operator+=(const CoefficientSpectrum &s2) {
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      c[i] += s2.c[i];
-    }
+    return *this = map(*this, s2, SpectrumAdd());
   }
   CoefficientSpectrum operator+(const CoefficientSpectrum &s2) const {
-    CoefficientSpectrum ret = *this;
-    for (int i = 0; i < nSpectrumSamples; ++i) {
-      ret.c[i] += s2.c[i];
-    }
-    return ret;
+    return map(*this, s2, SpectrumAdd());
+  }
+  CoefficientSpectrum &operator-=(const CoefficientSpectrum &s2) {
+    return *this = map(*this, s2, SpectrumSub());
+  }
+  CoefficientSpectrum operator-(const CoefficientSpectrum &s2) const {
+    return map(*this, s2, SpectrumSub());
+  }
+  CoefficientSpectrum &operator*=(const CoefficientSpectrum &s2) {
+    return *this = map(*this, s2, SpectrumMul());
+  }
+  CoefficientSpectrum operator*(const CoefficientSpectrum &s2) const {
+    return map(*this, s2, SpectrumMul());
+  }
+  CoefficientSpectrum &operator/=(const CoefficientSpectrum &s2) {
+    return *this = map(*this, s2, SpectrumDiv());
+  }
+  CoefficientSpectrum operator/(const CoefficientSpectrum &s2) const {
+    return map(*this, s2, SpectrumDiv());
+  }
+  CoefficientSpectrum &operator*=(Float a) {
+    return *this = map(*this, SpectrumScale{a});
+  }
+  CoefficientSpectrum operator*(Float a) const {
+    return map(*this, SpectrumScale{a});
+  }
+  friend CoefficientSpectrum operator*(Float a, const CoefficientSpectrum &s) {
+    return s * a;
+  }
+  CoefficientSpectrum &operator/=(Float a) {
+    return *this = map(*this, SpectrumDivide{a});
+  }
+  CoefficientSpectrum operator/(Float a) const {
+    return map(*this, SpectrumDivide{a});
+  }
+  CoefficientSpectrum operator-() const {
+    return map(*this, SpectrumScale{-1});
+  }
+
+  bool operator==(const CoefficientSpectrum &s2) const {
+    for (int i = 0; i < nSamples; ++i)
+      if (c[i] != s2.c[i]) return false;
+    return true;
+  }
+  bool operator!=(const CoefficientSpectrum &s2) const {
+    return !(*this == s2);
   }
 
   Float &operator[](int i) { return c[i]; }
+  Float operator[](int i) const { return c[i]; }
 
   bool isNan() const {
-    for (int i = 0; i < nSpectrumSamples; ++i)
+    for (int i = 0; i < nSamples; ++i)
       if (std::isnan(c[i])) return true;
     return false;
   }
 
  protected:
-  static const int nSamples = nSpectrumSamples;
-  Float c[nSpectrumSamples];  // a constant across all wavelangths
-  SampledSpectrum X, Y, Z;
+  // Applies _op_ to every coefficient of _a_ (and _b_), a vector at a time.
+  template <typename Op>
+  static CoefficientSpectrum map(const CoefficientSpectrum &a, Op op) {
+    CoefficientSpectrum ret{Uninitialized()};
+    int i = 0;
+#ifdef PHR_SPECTRUM_AVX
+    for (; i + 8 <= nPadded; i += 8)
+      _mm256_store_ps(&ret.c[i], op(_mm256_load_ps(&a.c[i])));
+#endif
+#ifdef PHR_SPECTRUM_SSE
+    for (; i < nPadded; i += 4)
+      _mm_store_ps(&ret.c[i], op(_mm_load_ps(&a.c[i])));
+#else
+    for (; i < nPadded; ++i) ret.c[i] = op(a.c[i]);
+#endif
+    return ret;
+  }
+  template <typename Op>
+  static CoefficientSpectrum map(const CoefficientSpectrum &a,
+                                 const CoefficientSpectrum &b, Op op) {
+    CoefficientSpectrum ret{Uninitialized()};
+    int i = 0;
+#ifdef PHR_SPECTRUM_AVX
+    for (; i + 8 <= nPadded; i += 8)
+      _mm256_store_ps(&ret.c[i],
+                      op(_mm256_load_ps(&a.c[i]), _mm256_load_ps(&b.c[i])));
+#endif
+#ifdef PHR_SPECTRUM_SSE
+    for (; i < nPadded; i += 4)
+      _mm_store_ps(&ret.c[i], op(_mm_load_ps(&a.c[i]), _mm_load_ps(&b.c[i])));
+#else
+    for (; i < nPadded; ++i) ret.c[i] = op(a.c[i], b.c[i]);
+#endif
+    return ret;
+  }
+
+  // Skips the fill for results map() overwrites entirely.
+  struct Uninitialized {};
+  explicit CoefficientSpectrum(Uninitialized) {}
+
+  // Spectra shorter than one AVX vector are only ever loaded with SSE.
+  static constexpr int alignment = nPadded >= 8
+                                       ? SpectrumAlignment
+                                       : alignof(Float) * SpectrumVectorWidth;
+  alignas(alignment) Float c[nPadded];
 };
-#endif  // !PHR_CORE_SPECTRUM_COEFFICIENT_SPECTRUM_H
+
+#endif  // PHR_CORE_SPECTRUMS_COEFFICIENTSPECTRUM_H
@@ -0,0 +1,54 @@
+#include "core/spectrums/heroSpectrum.h"
+
+#include <algorithm>
+
+HeroWavelengths HeroWavelengths::Sample(Float u) {
+  HeroWavelengths wl;
+  const Float range = sampledLambdaEnd - sampledLambdaStart;
+  for (int i = 0; i < Count; ++i) {
+    Float up = u + Float(i) / Count;
+    if (up >= 1) up -= 1;
+    wl.lambda[i] = Lerp(up, sampledLambdaStart, sampledLambdaEnd);
+    wl.pdf[i] = 1 / range;
+  }
+  return wl;
+}
+
+// Linear interpolation in a table of _n_ values, the first at _lambda0_
+// and the rest _spacing_ nm apart. Wavelengths past either end are clamped.
+static Float interpolate(const Float *table, int n, Float lambda0,
+                         Float spacing, Float lambda) {
+  Float x = Clamp((lambda - lambda0) / spacing, 0, n - 1);
+  int i = std::min(int(x), n - 2);
+  return Lerp(x - i, table[i], table[i + 1]);
+}
+
+HeroSpectrum HeroSpectrum::FromRGB(const Float rgb[3],
+                                   const HeroWavelengths &wl) {
+  const Float spacing = Float(sampledLambdaEnd - sampledLambdaStart) /
+                        (nRGB2SpectSamples - 1);
+  return SmitsRGBToSpectrum<HeroSpectrum>(rgb, [&](RGBBasis b) {
+    const Float *table = RGBRefl2Spect(b);
+    HeroSpectrum s;
+    for (int i = 0; i < HeroWavelengths::Count; ++i)
+      s.c[i] = interpolate(table, nRGB2SpectSamples, sampledLambdaStart,
+                           spacing, wl.lambda[i]);
+    return s;
+  });
+}
+
+void HeroSpectrum::ToXYZ(const HeroWavelengths &wl, Float xyz[3]) const {
+  // The curves at each wavelength, and this spectrum weighted by the
+  // estimator's 1 / (pdf * Count), normalized like SampledSpectrum::ToXYZ()
+  HeroSpectrum X, Y, Z, weighted;
+  for (int i = 0; i < HeroWavelengths::Count; ++i) {
+    X.c[i] = interpolate(CIE_X, nCIESamples, CIE_lambda[0], 1, wl.lambda[i]);
+    Y.c[i] = interpolate(CIE_Y, nCIESamples, CIE_lambda[0], 1, wl.lambda[i]);
+    Z.c[i] = interpolate(CIE_Z, nCIESamples, CIE_lambda[0], 1, wl.lambda[i]);
+    weighted.c[i] =
+        c[i] / (wl.pdf[i] * HeroWavelengths::Count * CIE_Y_integral);
+  }
+  xyz[0] = Dot(X, weighted);
+  xyz[1] = Dot(Y, weighted);
+  xyz[2] = Dot(Z, weighted);
+}
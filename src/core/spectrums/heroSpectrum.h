@@ -0,0 +1,48 @@
+#ifndef PHR_CORE_SPECTRUMS_HEROSPECTRUM_H
+#define PHR_CORE_SPECTRUMS_HEROSPECTRUM_H
+
+#include "core/phr.h"
+#include "core/spectrums/coefficientSpectrum.h"
+#include "core/spectrums/spectrum.h"
+
+// The wavelengths one camera ray carries in hero wavelength sampling
+// (Wilkie et al., "Hero Wavelength Spectral Sampling", 2014): a hero
+// wavelength drawn uniformly from [sampledLambdaStart, sampledLambdaEnd),
+// and the others at equal offsets from it, wrapping around the range. The
+// set is stratified over the range, and each wavelength on its own is still
+// uniformly distributed.
+struct HeroWavelengths {
+  static constexpr int Count = 4;
+
+  static HeroWavelengths Sample(Float u);
+
+  Float lambda[Count];
+  // The density each wavelength was sampled with.
+  Float pdf[Count];
+};
+
+// Radiance or reflectance at the HeroWavelengths of one ray, held in a
+// single SSE register: 16 bytes, where a SampledSpectrum takes 240.
+class HeroSpectrum : public CoefficientSpectrum<HeroWavelengths::Count> {
+ public:
+  HeroSpectrum(Float v = 0.f)
+      : CoefficientSpectrum<HeroWavelengths::Count>(v) {}
+  HeroSpectrum(const CoefficientSpectrum<HeroWavelengths::Count> &v)
+      : CoefficientSpectrum<HeroWavelengths::Count>(v) {}
+
+  // Smits' conversion of a linear RGB reflectance, evaluated at _wl_.
+  static HeroSpectrum FromRGB(const Float rgb[3], const HeroWavelengths &wl);
+
+  // The Monte Carlo estimate of the XYZ integrals of the spectrum these
+  // samples come from, through the CIE matching curves at _wl_. Averaged
+  // over many sets of wavelengths it converges to SampledSpectrum::ToXYZ()
+  // of the same spectrum.
+  void ToXYZ(const HeroWavelengths &wl, Float xyz[3]) const;
+  void ToRGB(const HeroWavelengths &wl, Float rgb[3]) const {
+    Float xyz[3];
+    ToXYZ(wl, xyz);
+    XYZToRGB(xyz, rgb);
+  }
+};
+
+#endif  // PHR_CORE_SPECTRUMS_HEROSPECTRUM_H
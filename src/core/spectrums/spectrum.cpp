@@ -0,0 +1,260 @@
+#include "core/spectrums/spectrum.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// std::exp() is not constexpr. Halving the argument until the Taylor series
+// converges quickly, then squaring back up, is accurate to well below float
+// precision for the arguments the tables need.
+static constexpr double constexprExp(double x) {
+  if (x < -700) return 0;
+  int halvings = 0;
+  while (x < -0.5 || x > 0.5) {
+    x /= 2;
+    ++halvings;
+  }
+  double sum = 1, term = 1;
+  for (int n = 1; n < 14; ++n) {
+    term *= x / n;
+    sum += term;
+  }
+  while (halvings-- > 0) sum *= sum;
+  return sum;
+}
+
+// A Gaussian lobe with peak 1 at _mu_ and different widths on either side.
+static constexpr double lobe(double lambda, double mu, double sigmaLow,
+                             double sigmaHigh) {
+  double t = (lambda - mu) / (lambda < mu ? sigmaLow : sigmaHigh);
+  return constexprExp(-0.5 * t * t);
+}
+
+struct CIECurves {
+  Float lambda[nCIESamples], x[nCIESamples], y[nCIESamples], z[nCIESamples];
+  Float yIntegral;
+};
+
+static constexpr CIECurves computeCIECurves() {
+  CIECurves c{};
+  double yIntegral = 0;
+  for (int i = 0; i < nCIESamples; ++i) {
+    double l = 360 + i;
+    double x = 1.056 * lobe(l, 599.8, 37.9, 31.0) +
+               0.362 * lobe(l, 442.0, 16.0, 26.7) -
+               0.065 * lobe(l, 501.1, 20.4, 26.2);
+    double y = 0.821 * lobe(l, 568.8, 46.9, 40.5) +
+               0.286 * lobe(l, 530.9, 16.3, 31.1);
+    double z = 1.217 * lobe(l, 437.0, 11.8, 36.0) +
+               0.681 * lobe(l, 459.0, 26.0, 13.8);
+    c.lambda[i] = Float(l);
+    c.x[i] = Float(x);
+    c.y[i] = Float(y);
+    c.z[i] = Float(z);
+    yIntegral += y;
+  }
+  c.yIntegral = Float(yIntegral);
+  return c;
+}
+
+static constexpr CIECurves cieCurves = computeCIECurves();
+const Float (&CIE_lambda)[nCIESamples] = cieCurves.lambda;
+const Float (&CIE_X)[nCIESamples] = cieCurves.x;
+const Float (&CIE_Y)[nCIESamples] = cieCurves.y;
+const Float (&CIE_Z)[nCIESamples] = cieCurves.z;
+const Float CIE_Y_integral = cieCurves.yIntegral;
+
+const Float RGB2SpectLambda[nRGB2SpectSamples] = {
+    400.000000f, 409.677419f, 419.354839f, 429.032258f, 438.709677f,
+    448.387097f, 458.064516f, 467.741935f, 477.419355f, 487.096774f,
+    496.774194f, 506.451613f, 516.129032f, 525.806452f, 535.483871f,
+    545.161290f, 554.838710f, 564.516129f, 574.193548f, 583.870968f,
+    593.548387f, 603.225806f, 612.903226f, 622.580645f, 632.258065f,
+    641.935484f, 651.612903f, 661.290323f, 670.967742f, 680.645161f,
+    690.322581f, 700.000000f};
+
+const Float RGBRefl2SpectWhite[nRGB2SpectSamples] = {
+    1.087749f, 1.087781f, 1.088005f, 1.088689f, 1.090143f, 1.092625f, 1.095959f,
+    1.099611f, 1.102956f, 1.105369f, 1.106119f, 1.104333f, 1.099010f, 1.089101f,
+    1.073922f, 1.053570f, 1.028793f, 1.000854f, 0.971394f, 0.942242f, 0.915208f,
+    0.891844f, 0.873183f, 0.859490f, 0.850289f, 0.844652f, 0.841519f, 0.839953f,
+    0.839257f, 0.838990f, 0.838908f, 0.838893f};
+
+const Float RGBRefl2SpectCyan[nRGB2SpectSamples] = {
+    1.000227f, 1.000512f, 1.002358f, 1.008262f, 1.021525f, 1.044525f, 1.076508f,
+    1.114410f, 1.154097f, 1.191020f, 1.220199f, 1.236224f, 1.233114f, 1.204677f,
+    1.146740f, 1.059435f, 0.946491f, 0.814444f, 0.671928f, 0.528649f, 0.394314f,
+    0.277323f, 0.183424f, 0.114319f, 0.067832f, 0.039363f, 0.023578f, 0.015722f,
+    0.012261f, 0.010951f, 0.010555f, 0.010488f};
+
+const Float RGBRefl2SpectMagenta[nRGB2SpectSamples] = {
+    1.282738f, 1.281709f, 1.275446f, 1.254624f, 1.205622f, 1.119626f, 0.997022f,
+    0.843985f, 0.671425f, 0.493201f, 0.323248f, 0.174947f, 0.062335f, 0.000000f,
+    0.000000f, 0.000000f, 0.027411f, 0.105272f, 0.220225f, 0.356509f, 0.497621f,
+    0.628467f, 0.737638f, 0.819771f, 0.875538f, 0.909614f, 0.928232f, 0.937216f,
+    0.940960f, 0.942245f, 0.942568f, 0.942606f};
+
+const Float RGBRefl2SpectYellow[nRGB2SpectSamples] = {
+    0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.018182f, 0.079978f,
+    0.181100f, 0.311761f, 0.458496f, 0.608847f, 0.752637f, 0.880617f, 0.983894f,
+    1.055881f, 1.094488f, 1.101268f, 1.080565f, 1.038869f, 0.983972f, 0.924143f,
+    0.867052f, 0.818626f, 0.781864f, 0.756810f, 0.741512f, 0.733202f, 0.729242f,
+    0.727630f, 0.727102f, 0.726982f, 0.726972f};
+
+const Float RGBRefl2SpectRed[nRGB2SpectSamples] = {
+    0.049263f, 0.049105f, 0.047629f, 0.043340f, 0.035344f, 0.022549f, 0.008252f,
+    0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,
+    0.000000f, 0.000000f, 0.000000f, 0.023097f, 0.123283f, 0.274394f, 0.448493f,
+    0.619446f, 0.766747f, 0.879506f, 0.956611f, 1.003647f, 1.029058f, 1.041021f,
+    1.045773f, 1.047251f, 1.047539f, 1.047548f};
+
+const Float RGBRefl2SpectGreen[nRGB2SpectSamples] = {
+    0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.010405f,
+    0.108017f, 0.270730f, 0.468656f, 0.674221f, 0.865109f, 1.021588f, 1.125326f,
+    1.163586f, 1.133938f, 1.042350f, 0.901234f, 0.727812f, 0.541946f, 0.363938f,
+    0.211806f, 0.098472f, 0.028841f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,
+    0.000000f, 0.000000f, 0.000000f, 0.000000f};
+
+const Float RGBRefl2SpectBlue[nRGB2SpectSamples] = {
+    1.208378f, 1.207567f, 1.202745f, 1.186445f, 1.147376f, 1.078532f, 0.979583f,
+    0.854049f, 0.709529f, 0.556479f, 0.405087f, 0.264654f, 0.144860f, 0.056002f,
+    0.006467f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,
+    0.002804f, 0.010716f, 0.018982f, 0.025245f, 0.028979f, 0.030674f, 0.031135f,
+    0.031047f, 0.030834f, 0.030682f, 0.030634f};
+
+const Float *RGBRefl2Spect(RGBBasis basis) {
+  static const Float *const tables[] = {
+      RGBRefl2SpectWhite, RGBRefl2SpectCyan,  RGBRefl2SpectMagenta,
+      RGBRefl2SpectYellow, RGBRefl2SpectRed, RGBRefl2SpectGreen,
+      RGBRefl2SpectBlue};
+  return tables[int(basis)];
+}
+
+bool SpectrumSamplesSorted(const Float *lambda, int n) {
+  for (int i = 0; i < n - 1; ++i)
+    if (lambda[i] > lambda[i + 1]) return false;
+  return true;
+}
+
+void SortSpectrumSamples(Float *lambda, Float *vals, int n) {
+  std::vector<std::pair<Float, Float>> sortVec;
+  sortVec.reserve(n);
+  for (int i = 0; i < n; ++i) sortVec.push_back({lambda[i], vals[i]});
+  std::sort(sortVec.begin(), sortVec.end());
+  for (int i = 0; i < n; ++i) {
+    lambda[i] = sortVec[i].first;
+    vals[i] = sortVec[i].second;
+  }
+}
+
+Float AverageSpectrumSamples(const Float *lambda, const Float *vals, int n,
+                             Float lambdaStart, Float lambdaEnd) {
+  if (lambdaEnd <= lambda[0]) return vals[0];
+  if (lambdaStart >= lambda[n - 1]) return vals[n - 1];
+  if (n == 1) return vals[0];
+
+  Float sum = 0;
+  // Add the constant regions outside the sampled wavelengths
+  if (lambdaStart < lambda[0]) sum += vals[0] * (lambda[0] - lambdaStart);
+  if (lambdaEnd > lambda[n - 1])
+    sum += vals[n - 1] * (lambdaEnd - lambda[n - 1]);
+
+  // Find the first segment overlapping the range
+  int i = std::max<int>(
+      0, std::upper_bound(lambda, lambda + n, lambdaStart) - lambda - 1);
+
+  auto interp = [lambda, vals](Float w, int i) {
+    return Lerp((w - lambda[i]) / (lambda[i + 1] - lambda[i]), vals[i],
+                vals[i + 1]);
+  };
+  for (; i + 1 < n && lambdaEnd >= lambda[i]; ++i) {
+    Float segLambdaStart = std::max(lambdaStart, lambda[i]);
+    Float segLambdaEnd = std::min(lambdaEnd, lambda[i + 1]);
+    sum += 0.5f * (interp(segLambdaStart, i) + interp(segLambdaEnd, i)) *
+           (segLambdaEnd - segLambdaStart);
+  }
+  return sum / (lambdaEnd - lambdaStart);
+}
+
+SampledSpectrum SampledSpectrum::FromSampled(const Float *lambda,
+                                             const Float *v, int n) {
+  if (!SpectrumSamplesSorted(lambda, n)) {
+    std::vector<Float> slambda(&lambda[0], &lambda[n]);
+    std::vector<Float> sv(&v[0], &v[n]);
+    SortSpectrumSamples(&slambda[0], &sv[0], n);
+    return FromSampled(&slambda[0], &sv[0], n);
+  }
+  SampledSpectrum r;
+  for (int i = 0; i < nSpectralSamples; ++i) {
+    Float lambda0 = Lerp(Float(i) / Float(nSpectralSamples),
+                         sampledLambdaStart, sampledLambdaEnd);
+    Float lambda1 = Lerp(Float(i + 1) / Float(nSpectralSamples),
+                         sampledLambdaStart, sampledLambdaEnd);
+    r.c[i] = AverageSpectrumSamples(lambda, v, n, lambda0, lambda1);
+  }
+  return r;
+}
+
+// The SampledSpectrum constants, built once by the first thread to need
+// them.
+struct SampledSpectrumTables {
+  SampledSpectrumTables() {
+    // Scaled so that the dot products approximate the integrals of the
+    // matching curves times the spectrum, over CIE_Y_integral.
+    Float scale = Float(sampledLambdaEnd - sampledLambdaStart) /
+                  (CIE_Y_integral * nSpectralSamples);
+    for (int i = 0; i < nSpectralSamples; ++i) {
+      Float wl0 = Lerp(Float(i) / Float(nSpectralSamples), sampledLambdaStart,
+                       sampledLambdaEnd);
+      Float wl1 = Lerp(Float(i + 1) / Float(nSpectralSamples),
+                       sampledLambdaStart, sampledLambdaEnd);
+      X[i] = scale * AverageSpectrumSamples(CIE_lambda, CIE_X, nCIESamples,
+                                            wl0, wl1);
+      Y[i] = scale * AverageSpectrumSamples(CIE_lambda, CIE_Y, nCIESamples,
+                                            wl0, wl1);
+      Z[i] = scale * AverageSpectrumSamples(CIE_lambda, CIE_Z, nCIESamples,
+                                            wl0, wl1);
+      Float xyz[3] = {X[i], Y[i], Z[i]}, rgb[3];
+      XYZToRGB(xyz, rgb);
+      R[i] = rgb[0];
+      G[i] = rgb[1];
+      B[i] = rgb[2];
+    }
+    for (int b = 0; b < 7; ++b)
+      rgbBasis[b] = SampledSpectrum::FromSampled(
+          RGB2SpectLambda, RGBRefl2Spect(RGBBasis(b)), nRGB2SpectSamples);
+  }
+
+  SampledSpectrum X, Y, Z, R, G, B;
+  // Indexed by RGBBasis.
+  SampledSpectrum rgbBasis[7];
+};
+
+static const SampledSpectrumTables &tables() {
+  static const SampledSpectrumTables t;
+  return t;
+}
+
+void SampledSpectrum::ToXYZ(Float xyz[3]) const {
+  const SampledSpectrumTables &t = tables();
+  xyz[0] = Dot(t.X, *this);
+  xyz[1] = Dot(t.Y, *this);
+  xyz[2] = Dot(t.Z, *this);
+}
+
+Float SampledSpectrum::y() const { return Dot(tables().Y, *this); }
+
+void SampledSpectrum::ToRGB(Float rgb[3]) const {
+  const SampledSpectrumTables &t = tables();
+  rgb[0] = Dot(t.R, *this);
+  rgb[1] = Dot(t.G, *this);
+  rgb[2] = Dot(t.B, *this);
+}
+
+SampledSpectrum SampledSpectrum::FromRGB(const Float rgb[3]) {
+  const SampledSpectrumTables &t = tables();
+  return SmitsRGBToSpectrum<SampledSpectrum>(
+      rgb, [&t](RGBBasis b) -> const SampledSpectrum & {
+        return t.rgbBasis[int(b)];
+      });
+}
@@ -1,5 +1,6 @@
+#ifndef PHR_CORE_SPECTRUMS_SPECTRUM_H
+#define PHR_CORE_SPECTRUMS_SPECTRUM_H
 
-#include "core/geometry.h"
 #include "core/phr.h"
 #include "core/spectrums/coefficientSpectrum.h"
 
@@ -7,47 +8,161 @@ static const int sampledLambdaStart = 400;
 static const int sampledLambdaEnd = 700;
 static const int nSpectralSamples = 60;
 
+// The CIE 1931 2-degree colour matching functions at 1 nm steps from 360 to
+// 830 nm, and the integral of CIE_Y over that range. They are evaluated at
+// compile time from the multi-lobe Gaussian fit of Wyman, Sloan and Shirley,
+// "Simple Analytic Approximations to the CIE XYZ Color Matching Functions"
+// (JCGT 2013), which stays within about 1% of the peak of the measured
+// tables.
+static const int nCIESamples = 471;
+extern const Float (&CIE_lambda)[nCIESamples];
+extern const Float (&CIE_X)[nCIESamples];
+extern const Float (&CIE_Y)[nCIESamples];
+extern const Float (&CIE_Z)[nCIESamples];
+extern const Float CIE_Y_integral;
+
+// Basis reflectances for converting RGB to spectra, after Smits, "An
+// RGB-to-Spectrum Conversion for Reflectances" (1999), sampled at
+// nRGB2SpectSamples wavelengths spread evenly over the sampled range. Each
+// is the smoothest non-negative spectrum whose linear RGB, under the curves
+// above, is exactly its colour: (1, 1, 1) for white, (0, 1, 1) for cyan and
+// so on.
+static const int nRGB2SpectSamples = 32;
+extern const Float RGB2SpectLambda[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectWhite[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectCyan[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectMagenta[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectYellow[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectRed[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectGreen[nRGB2SpectSamples];
+extern const Float RGBRefl2SpectBlue[nRGB2SpectSamples];
+
+enum class RGBBasis { White, Cyan, Magenta, Yellow, Red, Green, Blue };
+// The RGBRefl2Spect table for _basis_.
+const Float *RGBRefl2Spect(RGBBasis basis);
+
+// Smits' decomposition of _rgb_: the smallest component is taken as white,
+// the gap to the middle one as the secondary colour the two larger
+// components share, and the rest as the largest one's primary.
+// _basis_(RGBBasis) returns the basis reflectances as _Spectrum_ values.
+template <typename Spectrum, typename Basis>
+Spectrum SmitsRGBToSpectrum(const Float rgb[3], Basis basis) {
+  Spectrum r;
+  if (rgb[0] <= rgb[1] && rgb[0] <= rgb[2]) {
+    r += rgb[0] * basis(RGBBasis::White);
+    if (rgb[1] <= rgb[2]) {
+      r += (rgb[1] - rgb[0]) * basis(RGBBasis::Cyan);
+      r += (rgb[2] - rgb[1]) * basis(RGBBasis::Blue);
+    } else {
+      r += (rgb[2] - rgb[0]) * basis(RGBBasis::Cyan);
+      r += (rgb[1] - rgb[2]) * basis(RGBBasis::Green);
+    }
+  } else if (rgb[1] <= rgb[0] && rgb[1] <= rgb[2]) {
+    r += rgb[1] * basis(RGBBasis::White);
+    if (rgb[0] <= rgb[2]) {
+      r += (rgb[0] - rgb[1]) * basis(RGBBasis::Magenta);
+      r += (rgb[2] - rgb[0]) * basis(RGBBasis::Blue);
+    } else {
+      r += (rgb[2] - rgb[1]) * basis(RGBBasis::Magenta);
+      r += (rgb[0] - rgb[2]) * basis(RGBBasis::Red);
+    }
+  } else {
+    r += rgb[2] * basis(RGBBasis::White);
+    if (rgb[0] <= rgb[1]) {
+      r += (rgb[0] - rgb[2]) * basis(RGBBasis::Yellow);
+      r += (rgb[1] - rgb[0]) * basis(RGBBasis::Green);
+    } else {
+      r += (rgb[1] - rgb[2]) * basis(RGBBasis::Yellow);
+      r += (rgb[0] - rgb[1]) * basis(RGBBasis::Red);
+    }
+  }
+  return r.Clamp();
+}
+
+// Returns true if _lambda_[0.._n_) is in increasing order.
+bool SpectrumSamplesSorted(const Float *lambda, int n);
+// Sorts the (_lambda_, _vals_) pairs by wavelength.
+void SortSpectrumSamples(Float *lambda, Float *vals, int n);
+// Returns the average over [_lambdaStart_, _lambdaEnd_] of the piecewise
+// linear function through the _n_ sorted samples, extended as a constant
+// past either end.
+Float AverageSpectrumSamples(const Float *lambda, const Float *vals, int n,
+                             Float lambdaStart, Float lambdaEnd);
+
+inline void XYZToRGB(const Float xyz[3], Float rgb[3]) {
+  rgb[0] = 3.240479f * xyz[0] - 1.537150f * xyz[1] - 0.498535f * xyz[2];
+  rgb[1] = -0.969256f * xyz[0] + 1.875991f * xyz[1] + 0.041556f * xyz[2];
+  rgb[2] = 0.055648f * xyz[0] - 0.204043f * xyz[1] + 1.057311f * xyz[2];
+}
+
+inline void RGBToXYZ(const Float rgb[3], Float xyz[3]) {
+  xyz[0] = 0.412453f * rgb[0] + 0.357580f * rgb[1] + 0.180423f * rgb[2];
+  xyz[1] = 0.212671f * rgb[0] + 0.715160f * rgb[1] + 0.072169f * rgb[2];
+  xyz[2] = 0.019334f * rgb[0] + 0.119193f * rgb[1] + 0.950227f * rgb[2];
+}
+
+// The three-coefficient case: linear RGB, held in one SSE register.
+class RGBSpectrum : public CoefficientSpectrum<3> {
+ public:
+  RGBSpectrum(Float v = 0.f) : CoefficientSpectrum<3>(v) {}
+  RGBSpectrum(const CoefficientSpectrum<3> &v) : CoefficientSpectrum<3>(v) {}
+
+  static RGBSpectrum FromRGB(const Float rgb[3]) {
+    RGBSpectrum s;
+    s.c[0] = rgb[0];
+    s.c[1] = rgb[1];
+    s.c[2] = rgb[2];
+    return s;
+  }
+  void ToRGB(Float *rgb) const {
+    rgb[0] = c[0];
+    rgb[1] = c[1];
+    rgb[2] = c[2];
+  }
+  void ToXYZ(Float xyz[3]) const { RGBToXYZ(c, xyz); }
+  static RGBSpectrum FromXYZ(const Float xyz[3]) {
+    RGBSpectrum r;
+    XYZToRGB(xyz, r.c);
+    return r;
+  }
+  Float y() const {
+    const Float YWeight[3] = {0.212671f, 0.715160f, 0.072169f};
+    return YWeight[0] * c[0] + YWeight[1] * c[1] + YWeight[2] * c[2];
+  }
+};
+
+// A spectrum sampled at nSpectralSamples evenly spaced wavelengths between
+// sampledLambdaStart and sampledLambdaEnd, each coefficient the average of
+// the spectrum over its bin.
+//
+// The matching curves and RGB basis spectra are resampled into this basis
+// once, on first use, with the weights of the integrals folded in, so each
+// conversion to XYZ or RGB is three dot products.
 class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
  public:
   SampledSpectrum(Float v = 0.f) : CoefficientSpectrum<nSpectralSamples>(v) {}
+  SampledSpectrum(const CoefficientSpectrum<nSpectralSamples> &v)
+      : CoefficientSpectrum<nSpectralSamples>(v) {}
 
- private:
+  // Resamples the _n_ (_lambda_, _v_) pairs, which need not be sorted.
   static SampledSpectrum FromSampled(const Float *lambda, const Float *v,
-                                     int n) {
-    // TODO: Sort samples
-    SampledSpectrum r;
-    for (int i = 0; i < nSpectralSamples; ++i) {
-      Float lambda0 = Lerp(Float(i) / Float(nSpectralSamples),
-                           sampledLambdaStart, sampledLambdaEnd);
-      Float lambda1 = Lerp(Float(i + 1) / Float(nSpectralSamples),
-                           sampledLambdaStart, sampledLambdaEnd);
-      // TODO: Implement Average Spectrum Samples
-      r.c[i] = AverageSpectrumSamples(lambda, v, n, lambda0, lambda1);
-    }
+                                     int n);
+  // Smits' conversion of a linear RGB reflectance to a smooth spectrum.
+  static SampledSpectrum FromRGB(const Float rgb[3]);
+  static SampledSpectrum FromXYZ(const Float xyz[3]) {
+    Float rgb[3];
+    XYZToRGB(xyz, rgb);
+    return FromRGB(rgb);
   }
-  Float AverageSpectrumSamples(const Float *lambda, const Float *vals, int n,
-                               Float lambdaStart, Float lambdaEnd) {
-    if (lambdaEnd <= lambda[0]) return vals[0];
-    if (lambdaStart >= lambda[n - 1]) return vals[n - 1];
-    if (n == 1) return vals[0];
-
-    Float sum = 0;
-    int i = 0;
-    // Add constant regions outside of wavelength ideas;
-    if (lambdaStart < lambda[0]) sum += vals[0] * (lambda[0] - lambdaStart);
-    if (lambdaEnd > lambda[n - 1])
-      sum += vals[n - 1] * (lambdaEnd - lambda[n - 1]);
-    while (lambdaStart > lambda[i + 1]) ++i;
-
-    auto interp = [lambda, vals](Float w, int i) {
-      return Lerp((w - lambda[i]) / (lambda[i + 1] - lambda[i]), vals[i],
-                  vals[i + 1]);
-    };
-    for (; i + 1 < n && lambdaEnd >= lambda[i]; ++i) {
-      Float segLambdaStart = std::max(lambdaStart, lambda[i]);
-      Float segLambdaEnd = std::min(lambdaEnd, lambda[i + 1]);
-      sum += 0.5 * (interp(segLambdaStart, i) + interp(segLambdaEnd, i)) *
-             (segLambdaEnd - segLambdaStart);
-    }
+
+  void ToXYZ(Float xyz[3]) const;
+  Float y() const;
+  void ToRGB(Float rgb[3]) const;
+  RGBSpectrum ToRGBSpectrum() const {
+    Float rgb[3];
+    ToRGB(rgb);
+    return RGBSpectrum::FromRGB(rgb);
   }
-};
\ No newline at end of file
+};
+
+#endif  // PHR_CORE_SPECTRUMS_SPECTRUM_H
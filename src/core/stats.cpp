@@ -0,0 +1,86 @@
+#include "core/stats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#ifdef PHR_ENABLE_STATS
+
+namespace {
+
+// Live per-thread blocks, plus the totals of threads that have exited.
+std::mutex statsMutex;
+std::vector<ThreadStats *> liveStats;
+RenderStats retiredStats;
+
+}  // namespace
+
+ThreadStats::ThreadStats() {
+  for (std::atomic<uint64_t> &c : counts) c.store(0, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(statsMutex);
+  liveStats.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  for (int i = 0; i < int(Stat::Count); ++i)
+    retiredStats.counts[i] += counts[i].load(std::memory_order_relaxed);
+  liveStats.erase(std::find(liveStats.begin(), liveStats.end(), this));
+}
+
+void ResetStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  retiredStats = RenderStats();
+  for (ThreadStats *stats : liveStats)
+    for (std::atomic<uint64_t> &c : stats->counts)
+      c.store(0, std::memory_order_relaxed);
+}
+
+RenderStats MergeStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  RenderStats merged = retiredStats;
+  for (const ThreadStats *stats : liveStats)
+    for (int i = 0; i < int(Stat::Count); ++i)
+      merged.counts[i] += stats->counts[i].load(std::memory_order_relaxed);
+  return merged;
+}
+
+#else
+
+void ResetStats() {}
+RenderStats MergeStats() { return RenderStats(); }
+
+#endif  // PHR_ENABLE_STATS
+
+void ReportStats(FILE *out, const RenderStats &stats, double seconds) {
+  uint64_t rays = stats[Stat::RaysTraced] + stats[Stat::ShadowRays];
+  auto perRay = [rays](uint64_t count) {
+    return rays ? double(count) / rays : 0.;
+  };
+  auto percent = [](uint64_t part, uint64_t total) {
+    return total ? 100. * part / total : 0.;
+  };
+  fprintf(out, "Statistics:\n");
+  fprintf(out, "  Rays                  %12llu (%llu closest, %llu shadow)\n",
+          (unsigned long long)rays,
+          (unsigned long long)stats[Stat::RaysTraced],
+          (unsigned long long)stats[Stat::ShadowRays]);
+  fprintf(out, "  Rays/sec              %12.3fM\n",
+          seconds > 0 ? rays / seconds / 1e6 : 0.);
+  fprintf(out, "  Ray hits              %12llu (%.1f%%)\n",
+          (unsigned long long)stats[Stat::RayHits],
+          percent(stats[Stat::RayHits], rays));
+  fprintf(out, "  Nodes per ray         %12.2f\n",
+          perRay(stats[Stat::NodesVisited]));
+  fprintf(out, "  Box tests per ray     %12.2f\n",
+          perRay(stats[Stat::BoxTests]));
+  fprintf(out, "  Leaves per ray        %12.2f\n",
+          perRay(stats[Stat::LeafVisits]));
+  fprintf(out, "  Primitive tests/ray   %12.2f (%.1f%% hit)\n",
+          perRay(stats[Stat::PrimitiveTests]),
+          percent(stats[Stat::PrimitiveHits], stats[Stat::PrimitiveTests]));
+  uint64_t traversal = stats[Stat::TraversalCycles];
+  uint64_t leaf = std::min(stats[Stat::LeafCycles], traversal);
+  fprintf(out, "  Traversal time        %11.1f%% leaf, %.1f%% interior\n",
+          percent(leaf, traversal), percent(traversal - leaf, traversal));
+}
@@ -0,0 +1,113 @@
+#ifndef PHR_CORE_STATS_H
+#define PHR_CORE_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(PHR_ENABLE_STATS)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+// Hot-path counters for ray traversal. Every thread counts into its own
+// block, without locks or atomic read-modify-writes, and MergeStats() sums
+// the blocks once a render is done. The PHR_STAT_* macros compile to nothing
+// unless PHR_ENABLE_STATS is defined (the CMake option of the same name), so
+// the hooks can stay in release builds.
+
+enum class Stat {
+  RaysTraced,      // closest-hit queries
+  ShadowRays,      // any-hit queries
+  RayHits,
+  NodesVisited,    // nodes popped and tested, once per ray in a packet
+  BoxTests,        // individual ray/box tests
+  LeafVisits,      // likewise per ray that enters the leaf
+  PrimitiveTests,  // Shape::intersect/intersectP calls
+  PrimitiveHits,
+  TraversalCycles,
+  LeafCycles,      // part of TraversalCycles spent in leaves
+  Count
+};
+
+struct RenderStats {
+  uint64_t operator[](Stat s) const { return counts[int(s)]; }
+  uint64_t counts[int(Stat::Count)] = {};
+};
+
+constexpr bool StatsEnabled() {
+#ifdef PHR_ENABLE_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Zeroes every thread's counters. Call between renders, while no thread is
+// tracing rays.
+void ResetStats();
+// Sums the counters of all threads, including ones that have exited.
+RenderStats MergeStats();
+// Prints rays/sec, per-ray node, box and primitive counts, and the split of
+// traversal time between leaves and interior nodes.
+void ReportStats(FILE *out, const RenderStats &stats, double seconds);
+
+#ifdef PHR_ENABLE_STATS
+
+// One thread's counters. Only the owning thread writes them, so updates are
+// relaxed load/store pairs; the atomics just make reads from MergeStats()
+// well defined.
+struct alignas(64) ThreadStats {
+  ThreadStats();
+  ~ThreadStats();
+  std::atomic<uint64_t> counts[int(Stat::Count)];
+};
+
+inline void StatsAdd(Stat s, uint64_t n) {
+  thread_local ThreadStats stats;
+  std::atomic<uint64_t> &c = stats.counts[int(s)];
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// A cheap monotonic tick count. Only ratios of it are reported, so the unit
+// does not matter.
+inline uint64_t StatsCycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Adds the ticks between construction and destruction to a counter.
+class StatTimer {
+ public:
+  explicit StatTimer(Stat stat) : stat(stat), start(StatsCycles()) {}
+  ~StatTimer() { StatsAdd(stat, StatsCycles() - start); }
+
+ private:
+  const Stat stat;
+  const uint64_t start;
+};
+
+#define PHR_STAT_CONCAT_(a, b) a##b
+#define PHR_STAT_CONCAT(a, b) PHR_STAT_CONCAT_(a, b)
+#define PHR_STAT_ADD(stat, n) StatsAdd(Stat::stat, (n))
+#define PHR_STAT_TIMER(stat) \
+  StatTimer PHR_STAT_CONCAT(statTimer, __LINE__)(Stat::stat)
+
+#else
+
+#define PHR_STAT_ADD(stat, n) ((void)0)
+#define PHR_STAT_TIMER(stat) ((void)0)
+
+#endif  // PHR_ENABLE_STATS
+
+#define PHR_STAT_INC(stat) PHR_STAT_ADD(stat, 1)
+
+#endif  // PHR_CORE_STATS_H
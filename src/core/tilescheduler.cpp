@@ -0,0 +1,88 @@
+#include "core/tilescheduler.h"
+
+#include <chrono>
+
+TileScheduler::TileScheduler(ThreadPool &pool, const Point2i &resolution,
+                             int tileSize)
+    : pool(pool),
+      tileSize(tileSize),
+      queues(new WorkQueue[pool.Size()]) {
+  for (int y = 0; y < resolution.y; y += tileSize)
+    for (int x = 0; x < resolution.x; x += tileSize)
+      tiles.push_back(Bounds2i(
+          Point2i(x, y), Point2i(std::min(x + tileSize, resolution.x),
+                                 std::min(y + tileSize, resolution.y))));
+  timings.resize(tiles.size());
+}
+
+bool TileScheduler::nextTile(int threadIndex, int *tile, bool *stolen) {
+  {
+    WorkQueue &own = queues[threadIndex];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tiles.empty()) {
+      *tile = own.tiles.front();
+      own.tiles.pop_front();
+      *stolen = false;
+      return true;
+    }
+  }
+  // Nothing is queued once Run() starts, so a full sweep over empty queues
+  // means every tile has been claimed.
+  int nQueues = pool.Size();
+  for (int i = 1; i < nQueues; ++i) {
+    WorkQueue &victim = queues[(threadIndex + i) % nQueues];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tiles.empty()) {
+      *tile = victim.tiles.back();
+      victim.tiles.pop_back();
+      *stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TileScheduler::Run(
+    const std::function<void(const Bounds2i &, int)> &renderTile) {
+  std::vector<int> all(tiles.size());
+  for (int t = 0; t < TileCount(); ++t) {
+    all[t] = t;
+    timings[t] = TileTiming();
+  }
+  run(all, renderTile);
+}
+
+void TileScheduler::Run(
+    const std::vector<int> &tileIndices,
+    const std::function<void(const Bounds2i &, int)> &renderTile) {
+  run(tileIndices, renderTile);
+}
+
+void TileScheduler::run(
+    const std::vector<int> &tileIndices,
+    const std::function<void(const Bounds2i &, int)> &renderTile) {
+  int nQueues = pool.Size();
+  int nTiles = int(tileIndices.size());
+  for (int q = 0; q < nQueues; ++q) {
+    int begin = int(int64_t(nTiles) * q / nQueues);
+    int end = int(int64_t(nTiles) * (q + 1) / nQueues);
+    queues[q].tiles.clear();
+    for (int t = begin; t < end; ++t) queues[q].tiles.push_back(tileIndices[t]);
+  }
+
+  pool.RunOnAll([&](int threadIndex) {
+    using Clock = std::chrono::steady_clock;
+    int tile;
+    bool stolen;
+    while (nextTile(threadIndex, &tile, &stolen)) {
+      auto start = Clock::now();
+      renderTile(tiles[tile], threadIndex);
+      std::chrono::duration<double> elapsed = Clock::now() - start;
+      TileTiming &timing = timings[tile];
+      timing.bounds = tiles[tile];
+      timing.seconds += elapsed.count();
+      timing.threadIndex = threadIndex;
+      timing.stolen = timing.stolen || stolen;
+    }
+  });
+}
@@ -0,0 +1,63 @@
+#ifndef PHR_CORE_TILESCHEDULER_H
+#define PHR_CORE_TILESCHEDULER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "core/geometry.h"
+#include "core/parallel.h"
+#include "core/phr.h"
+
+struct TileTiming {
+  Bounds2i bounds;
+  double seconds = 0;
+  int threadIndex = 0;
+  bool stolen = false;
+};
+
+// Splits the film into square tiles and renders them on a ThreadPool. Each
+// worker starts with a contiguous run of tiles in its own deque and takes
+// from the front of it; once it runs dry it steals from the back of another
+// worker's deque, so expensive tiles do not leave the other cores idle.
+class TileScheduler {
+ public:
+  TileScheduler(ThreadPool &pool, const Point2i &resolution,
+                int tileSize = 16);
+
+  // Calls _renderTile(tileBounds, threadIndex)_ once for every tile. Tile
+  // bounds are half-open pixel ranges [pMin, pMax).
+  void Run(const std::function<void(const Bounds2i &, int)> &renderTile);
+  // Calls _renderTile_ only for the tiles whose indices are listed in
+  // _tileIndices_, and adds their times to the ones already recorded, so
+  // repeated passes over fewer and fewer tiles report the total per tile.
+  void Run(const std::vector<int> &tileIndices,
+           const std::function<void(const Bounds2i &, int)> &renderTile);
+
+  int TileCount() const { return int(tiles.size()); }
+  int TileSize() const { return tileSize; }
+  int ThreadCount() const { return pool.Size(); }
+  const Bounds2i &Tile(int index) const { return tiles[index]; }
+  // Per-tile wall-clock times from the last full Run() and the partial ones
+  // since, in tile order.
+  const std::vector<TileTiming> &Timings() const { return timings; }
+
+ private:
+  struct alignas(PBRT_L1_CACHE_LINE_SIZE) WorkQueue {
+    std::mutex mutex;
+    std::deque<int> tiles;
+  };
+  bool nextTile(int threadIndex, int *tile, bool *stolen);
+  void run(const std::vector<int> &tileIndices,
+           const std::function<void(const Bounds2i &, int)> &renderTile);
+
+  ThreadPool &pool;
+  const int tileSize;
+  std::vector<Bounds2i> tiles;
+  std::vector<TileTiming> timings;
+  std::unique_ptr<WorkQueue[]> queues;
+};
+
+#endif  // PHR_CORE_TILESCHEDULER_H
@@ -1,26 +1,37 @@
 
 #include "transform.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "geometry.h"
 #include "glm/geometric.hpp"
 #include "glm/matrix.hpp"
 #include "glm/trigonometric.hpp"
 #include "interaction.h"
 
+// NOTE: Transform indexes its matrices as m[row][column], so the translation
+// lives in the last column (m[i][3]), not glm's usual m[3][i].
 Transform Translate(const Vector3f &delta) {
-  glm::mat4 m(1.f);
-  m[3][0] = delta.x;
-  m[3][1] = delta.y;
-  m[3][2] = delta.z;
-  return Transform(m, glm::transpose(m));
+  glm::mat4 m(1.f), mInv(1.f);
+  m[0][3] = delta.x;
+  m[1][3] = delta.y;
+  m[2][3] = delta.z;
+  mInv[0][3] = -delta.x;
+  mInv[1][3] = -delta.y;
+  mInv[2][3] = -delta.z;
+  return Transform(m, mInv);
 }
 
 Transform Scale(Float x, Float y, Float z) {
-  glm::mat4 m(1.f);
+  glm::mat4 m(1.f), mInv(1.f);
   m[0][0] = x;
   m[1][1] = y;
   m[2][2] = z;
-  return Transform(m, glm::transpose(m));
+  mInv[0][0] = 1 / x;
+  mInv[1][1] = 1 / y;
+  mInv[2][2] = 1 / z;
+  return Transform(m, mInv);
 }
 
 Transform RotateX(Float theta) {
@@ -94,18 +105,6 @@ Transform LookAt(const Point3f &pos, const Point3f &look, const Vector3f &up) {
   return Transform(glm::inverse(cameraToWorld), cameraToWorld);
 }
 
-template <typename T>
-inline Point3<T> Transform::operator()(const Point3<T> &p) const {
-  T x = p.x, y = p.y, z = p.z;
-  T xp = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
-  T yp = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
-  T zp = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
-  T wp = m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3];
-  if (wp == 1)
-    return Point3<T>(xp, yp, zp);
-  else
-    return Point3<T>(xp, yp, zp) / wp;
-}
 
 // template <typename T>
 // inline Point3<T> Transform::operator()(const Point3<T> &p,
@@ -129,13 +128,6 @@ inline Point3<T> Transform::operator()(const Point3<T> &p) const {
 //     return Point3<T>(xp, yp, zp) / wp;
 // }
 
-template <typename T>
-inline Vector3<T> Transform::operator()(const Vector3<T> &v) const {
-  T x = v.x, y = v.y, z = v.z;
-  return Vector3<T>(m[0][0] * x + m[0][1] * y + m[0][2] * z,
-                    m[1][0] * x + m[1][1] * y + m[1][2] * z,
-                    m[2][0] * x + m[2][1] * y + m[2][2] * z);
-}
 
 // template <typename T>
 // inline Vector3<T> Transform::operator()(const Vector3<T> &v,
@@ -150,29 +142,7 @@ inline Vector3<T> Transform::operator()(const Vector3<T> &v) const {
 //                     m[2][0] * x + m[2][1] * y + m[2][2] * z);
 // }
 
-template <typename T>
-inline Normal3<T> Transform::operator()(const Normal3<T> &n) const {
-  T x = n.x, y = n.y, z = n.z;
-  return Normal3<T>(mInv[0][0] * x + mInv[1][0] * y + mInv[2][0] * z,
-                    mInv[0][1] * x + mInv[1][1] * y + mInv[2][1] * z,
-                    mInv[0][2] * x + mInv[1][2] * y + mInv[2][2] * z);
-}
-
-inline Ray Transform::operator()(const Ray &r) const {
-  Point3f o = (*this)(r.o);
-  Vector3f d = (*this)(r.d);
-  Float lengthSqr = d.lengthSquared();
-  Float tmax = r.tMax;
-  if (lengthSqr > 0) {
-    Float dt = glm::dot(Abs(d), r.tMax * d / glm::sqrt(lengthSqr));
-    // HACK: should be +=, but the way i have implemented it makes it not
-    // possible.
-    o = o + d * dt;
-    tmax -= dt;
-  }
 
-  return Ray(o, d, tmax, r.time, r.medium);
-}
 
 // inline Ray Transform::operator()(const Ray &r, Vector3f *oError,
 //                                  Vector3f *dError) const {
@@ -218,23 +188,26 @@ SurfaceInteraction Transform::operator()(const SurfaceInteraction &si) const {
   ret.mediumInterface = si.mediumInterface;
   ret.uv = si.uv;
   ret.shape = si.shape;
-  ret.dndu = si.dndu;
-  ret.dndv = si.dndv;
+  ret.primitive = si.primitive;
+  ret.dndu = t(si.dndu);
+  ret.dndv = t(si.dndv);
   ret.dpdu = t(si.dpdu);
   ret.dpdv = t(si.dpdv);
-  ret.shading.n = glm::normalize(t(si.shading.n));
   ret.shading.dpdu = t(si.shading.dpdu);
   ret.shading.dpdv = t(si.shading.dpdv);
   ret.shading.dndu = t(si.shading.dndu);
-  ret.shading.dndu = t(si.shading.dndv);
+  ret.shading.dndv = t(si.shading.dndv);
   ret.shading.n = glm::normalize(t(si.shading.n));
   ret.shading.n = FaceForward(ret.shading.n, ret.n);
 
   return ret;
 }
+// glm multiplies its matrices as column-major, i.e. as the transposes of the
+// row-major matrices stored here, so the operands are swapped: (A * B)^T is
+// B^T * A^T. The result applies _t2_ first, as in pbrt.
 Transform Transform::operator*(const Transform &t2) const {
-  glm::mat4 m1 = m * t2.m;
-  glm::mat4 m2 = t2.mInv * mInv;
+  glm::mat4 m1 = t2.m * m;
+  glm::mat4 m2 = mInv * t2.mInv;
   return Transform(m1, m2);
 }
 
@@ -242,3 +215,161 @@ bool Transform::swapsHandedness() const {
   Float det = glm::determinant(m);
   return det < 0;
 }
+
+// Row-major product, matching how Transform indexes its matrices.
+static glm::mat4 mul(const glm::mat4 &a, const glm::mat4 &b) {
+  glm::mat4 r(0.f);
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      for (int k = 0; k < 4; ++k) r[i][j] += a[i][k] * b[k][j];
+  return r;
+}
+
+AnimatedTransform::AnimatedTransform(const Transform *startTransform,
+                                     Float startTime,
+                                     const Transform *endTransform,
+                                     Float endTime)
+    : startTransform(startTransform),
+      endTransform(endTransform),
+      startTime(startTime),
+      endTime(endTime),
+      actuallyAnimated(!startTransform->isEqual(*endTransform)) {
+  Decompose(startTransform->GetMatrix(), &T[0], &R[0], &S[0]);
+  Decompose(endTransform->GetMatrix(), &T[1], &R[1], &S[1]);
+  // q and -q are the same rotation; pick the one that turns the short way.
+  if (Dot(R[0], R[1]) < 0) R[1] = -R[1];
+  hasRotation = !(R[0] == R[1]);
+}
+
+void AnimatedTransform::Decompose(const glm::mat4 &m, Vector3f *T,
+                                  Quaternion *Rquat, glm::mat4 *S) {
+  *T = Vector3f(m[0][3], m[1][3], m[2][3]);
+
+  glm::mat4 M = m;
+  for (int i = 0; i < 3; ++i) M[i][3] = M[3][i] = 0;
+  M[3][3] = 1;
+
+  // Polar decomposition: average R with its inverse transpose until it
+  // stops changing, which converges on the nearest rotation.
+  glm::mat4 R = M;
+  for (int count = 0; count < 100; ++count) {
+    glm::mat4 Rit = glm::inverse(glm::transpose(R));
+    glm::mat4 Rnext;
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j) Rnext[i][j] = 0.5f * (R[i][j] + Rit[i][j]);
+    Float norm = 0;
+    for (int i = 0; i < 3; ++i) {
+      Float n = std::abs(R[i][0] - Rnext[i][0]) +
+                std::abs(R[i][1] - Rnext[i][1]) +
+                std::abs(R[i][2] - Rnext[i][2]);
+      norm = std::max(norm, n);
+    }
+    R = Rnext;
+    if (norm <= .0001f) break;
+  }
+  *Rquat = Quaternion(Transform(R, glm::transpose(R)));
+  *S = mul(glm::inverse(R), M);
+}
+
+void AnimatedTransform::Interpolate(Float time, Transform *t) const {
+  if (!actuallyAnimated || time <= startTime) {
+    *t = *startTransform;
+    return;
+  }
+  if (time >= endTime) {
+    *t = *endTransform;
+    return;
+  }
+  compose((time - startTime) / (endTime - startTime), t);
+}
+
+void AnimatedTransform::compose(Float dt, Transform *t) const {
+  Vector3f trans = T[0] * (1 - dt) + T[1] * dt;
+  Quaternion q = hasRotation ? Slerp(dt, R[0], R[1]) : R[0];
+  glm::mat4 rotate = q.ToTransform().GetMatrix();
+  Float scale[3][3];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j) scale[i][j] = Lerp(dt, S[0][i][j], S[1][i][j]);
+
+  // m = T * R * S, and its inverse S^-1 * R^T * T^-1, built directly
+  // rather than through three 4x4 products and a general inverse, since
+  // moving instances do this for every ray.
+  Float inv[3][3] = {
+      {scale[1][1] * scale[2][2] - scale[1][2] * scale[2][1],
+       scale[0][2] * scale[2][1] - scale[0][1] * scale[2][2],
+       scale[0][1] * scale[1][2] - scale[0][2] * scale[1][1]},
+      {scale[1][2] * scale[2][0] - scale[1][0] * scale[2][2],
+       scale[0][0] * scale[2][2] - scale[0][2] * scale[2][0],
+       scale[0][2] * scale[1][0] - scale[0][0] * scale[1][2]},
+      {scale[1][0] * scale[2][1] - scale[1][1] * scale[2][0],
+       scale[0][1] * scale[2][0] - scale[0][0] * scale[2][1],
+       scale[0][0] * scale[1][1] - scale[0][1] * scale[1][0]}};
+  Float det = scale[0][0] * inv[0][0] + scale[0][1] * inv[1][0] +
+              scale[0][2] * inv[2][0];
+  glm::mat4 m(1.f), mInv(1.f);
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      m[i][j] = rotate[i][0] * scale[0][j] + rotate[i][1] * scale[1][j] +
+                rotate[i][2] * scale[2][j];
+      mInv[i][j] = (inv[i][0] * rotate[j][0] + inv[i][1] * rotate[j][1] +
+                    inv[i][2] * rotate[j][2]) /
+                   det;
+    }
+    m[i][3] = trans[i];
+  }
+  for (int i = 0; i < 3; ++i)
+    mInv[i][3] = -(mInv[i][0] * trans.x + mInv[i][1] * trans.y +
+                   mInv[i][2] * trans.z);
+  *t = Transform(m, mInv);
+}
+
+Bounds3f AnimatedTransform::MotionBounds(const Bounds3f &b) const {
+  if (!actuallyAnimated) return (*startTransform)(b);
+  Point3f corners[8];
+  for (int i = 0; i < 8; ++i) corners[i] = b.Corner(i);
+  return motionBounds(corners, 8);
+}
+
+Bounds3f AnimatedTransform::BoundPointMotion(const Point3f &p) const {
+  if (!actuallyAnimated) return Bounds3f((*startTransform)(p));
+  return motionBounds(&p, 1);
+}
+
+Bounds3f AnimatedTransform::motionBounds(const Point3f *p, int n) const {
+  // Every keyframe matrix is affine, so the image of a box at any time is
+  // the hull of its transformed corners and bounding the corners' paths
+  // bounds the box.
+  Bounds3f bounds;
+  for (int i = 0; i < n; ++i)
+    bounds = Union(Union(bounds, (*startTransform)(p[i])),
+                   (*endTransform)(p[i]));
+  if (!hasRotation) return bounds;
+
+  // A point moves as p(dt) = T(dt) + R(dt) S(dt) p. Its speed along each
+  // axis is at most |T1 - T0| + w max(|S0 p|, |S1 p|) + |(S1 - S0) p|, w
+  // being the rotation rate, and over a segment of length h it strays at
+  // most speed * h / 2 from the box of the segment's endpoints. Slerp()
+  // falls back to a normalized lerp for nearby rotations, which turns a
+  // hair faster than w at its midpoint; the 1% margin covers that.
+  Float w = 1.01f * 2 * AngleBetween(R[0], R[1]);
+  Vector3f speed(0, 0, 0);
+  for (int i = 0; i < n; ++i) {
+    Vector3f sp[2];
+    for (int k = 0; k < 2; ++k)
+      for (int r = 0; r < 3; ++r)
+        sp[k][r] =
+            S[k][r][0] * p[i].x + S[k][r][1] * p[i].y + S[k][r][2] * p[i].z;
+    Float rotational = w * std::max(sp[0].length(), sp[1].length()) +
+                       Vector3f(sp[1] - sp[0]).length();
+    for (int axis = 0; axis < 3; ++axis)
+      speed[axis] = std::max(
+          speed[axis], std::abs(T[1][axis] - T[0][axis]) + rotational);
+  }
+  for (int step = 1; step < MotionSegments; ++step) {
+    Transform t;
+    compose(Float(step) / MotionSegments, &t);
+    for (int i = 0; i < n; ++i) bounds = Union(bounds, t(p[i]));
+  }
+  Vector3f pad = speed * (Float(0.5) / MotionSegments);
+  return Bounds3f(bounds.pMin - pad, bounds.pMax + pad);
+}
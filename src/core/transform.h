@@ -4,10 +4,11 @@
 #include "geometry.h"
 #include "interaction.h"
 #include "phr.h"
+#include "quaternion.h"
 
 class Transform {
  public:
-  Transform() {}
+  Transform() : m(1.f), mInv(1.f) {}
   Transform(const Float mat[4][4]) {
     m = glm::mat4(mat[0][0], mat[0][1], mat[0][2], mat[0][3], mat[1][0],
                   mat[1][1], mat[1][2], mat[1][3], mat[2][0], mat[2][1],
@@ -26,6 +27,8 @@ class Transform {
     return (t.m == m && t.mInv == mInv);
   }
   bool isIdentity() const { return (m == glm::mat4(1.f)); }
+  const glm::mat4 &GetMatrix() const { return m; }
+  const glm::mat4 &GetInverseMatrix() const { return mInv; }
 
   bool hasScale() const {
     Float la2 = (*this)(Vector3f(1, 0, 0)).lengthSquared();
@@ -100,6 +103,51 @@ class Transform {
   glm::mat4 m, mInv;
 };
 
+template <typename T>
+inline Point3<T> Transform::operator()(const Point3<T> &p) const {
+  T x = p.x, y = p.y, z = p.z;
+  T xp = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+  T yp = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+  T zp = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+  T wp = m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3];
+  if (wp == 1)
+    return Point3<T>(xp, yp, zp);
+  else
+    return Point3<T>(xp, yp, zp) / wp;
+}
+
+template <typename T>
+inline Vector3<T> Transform::operator()(const Vector3<T> &v) const {
+  T x = v.x, y = v.y, z = v.z;
+  return Vector3<T>(m[0][0] * x + m[0][1] * y + m[0][2] * z,
+                    m[1][0] * x + m[1][1] * y + m[1][2] * z,
+                    m[2][0] * x + m[2][1] * y + m[2][2] * z);
+}
+
+template <typename T>
+inline Normal3<T> Transform::operator()(const Normal3<T> &n) const {
+  T x = n.x, y = n.y, z = n.z;
+  return Normal3<T>(mInv[0][0] * x + mInv[1][0] * y + mInv[2][0] * z,
+                    mInv[0][1] * x + mInv[1][1] * y + mInv[2][1] * z,
+                    mInv[0][2] * x + mInv[1][2] * y + mInv[2][2] * z);
+}
+
+inline Ray Transform::operator()(const Ray &r) const {
+  Point3f o = (*this)(r.o);
+  Vector3f d = (*this)(r.d);
+  Float lengthSqr = d.lengthSquared();
+  Float tmax = r.tMax;
+  if (lengthSqr > 0) {
+    Float dt = glm::dot(Abs(d), r.tMax * d / glm::sqrt(lengthSqr));
+    // HACK: should be +=, but the way i have implemented it makes it not
+    // possible.
+    o = o + d * dt;
+    tmax -= dt;
+  }
+
+  return Ray(o, d, tmax, r.time, r.medium);
+}
+
 Transform Translate(const Vector3f &delta);
 Transform Scale(Float x, Float y, Float z);
 Transform RotateX(Float theta);
@@ -108,4 +156,46 @@ Transform RotateZ(Float theta);
 Transform Rotate(Float theta, const Vector3f &axis);
 Transform LookAt(const Point3f &pos, const Point3f &look, const Vector3f &up);
 
+// A transform that moves from _startTransform_ at _startTime_ to
+// _endTransform_ at _endTime_. Both keyframes are decomposed into a
+// translation, a rotation and a scale, which are interpolated separately
+// (the rotation with Slerp()), so a spinning object keeps its shape instead
+// of shearing through the in-between matrices.
+class AnimatedTransform {
+ public:
+  AnimatedTransform(const Transform *startTransform, Float startTime,
+                    const Transform *endTransform, Float endTime);
+  // Splits _m_ into T * R * S, R being found by polar decomposition. S holds
+  // whatever is not a rotation or translation, so it need not be diagonal.
+  static void Decompose(const glm::mat4 &m, Vector3f *T, Quaternion *R,
+                        glm::mat4 *S);
+
+  // The transform at _time_, clamped to the keyframes, with its inverse.
+  void Interpolate(Float time, Transform *t) const;
+  bool IsAnimated() const { return actuallyAnimated; }
+  bool HasRotation() const { return hasRotation; }
+
+  // Bounds on everything _b_ (or _p_) sweeps over between the keyframes.
+  // Exact when the keyframes share a rotation, since points then move in
+  // straight lines; otherwise the path is sampled at MotionSegments steps
+  // and the result padded by how far a point can stray between two samples.
+  Bounds3f MotionBounds(const Bounds3f &b) const;
+  Bounds3f BoundPointMotion(const Point3f &p) const;
+
+ private:
+  static constexpr int MotionSegments = 32;
+
+  // Interpolates the decomposed keyframes at _dt_ in [0, 1].
+  void compose(Float dt, Transform *t) const;
+  Bounds3f motionBounds(const Point3f *p, int n) const;
+
+  const Transform *startTransform, *endTransform;
+  const Float startTime, endTime;
+  const bool actuallyAnimated;
+  bool hasRotation;
+  Vector3f T[2];
+  Quaternion R[2];
+  glm::mat4 S[2];
+};
+
 #endif
@@ -0,0 +1,49 @@
+#include "core/transformcache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// FNV-1a over the bits of the matrix. The inverse is a function of it, so
+// need not be hashed. Transforms that compare equal but differ in their bits
+// (0 and -0) may hash apart and be stored twice, which only costs memory.
+static uint64_t hash(const Transform &t) {
+  uint32_t words[16];
+  static_assert(sizeof(glm::mat4) == sizeof(words), "unexpected glm::mat4");
+  memcpy(words, &t.GetMatrix(), sizeof(words));
+  uint64_t h = 14695981039346656037ull;
+  for (uint32_t w : words) {
+    h ^= w;
+    h *= 1099511628211ull;
+  }
+  // Fold the high bits down; the table index comes from the low ones.
+  return h ^ (h >> 32);
+}
+
+const Transform *TransformCache::Lookup(const Transform &t) {
+  ++nRequests;
+  if (2 * (nUnique + 1) > table.size()) grow();
+  size_t mask = table.size() - 1;
+  size_t slot = hash(t) & mask;
+  while (table[slot]) {
+    if (table[slot]->isEqual(t)) return table[slot];
+    slot = (slot + 1) & mask;
+  }
+  Transform *cached = new (arena.alloc(sizeof(Transform))) Transform(t);
+  table[slot] = cached;
+  ++nUnique;
+  return cached;
+}
+
+void TransformCache::grow() {
+  std::vector<const Transform *> newTable(
+      table.empty() ? 256 : 2 * table.size(), nullptr);
+  size_t mask = newTable.size() - 1;
+  for (const Transform *t : table) {
+    if (!t) continue;
+    size_t slot = hash(*t) & mask;
+    while (newTable[slot]) slot = (slot + 1) & mask;
+    newTable[slot] = t;
+  }
+  table.swap(newTable);
+}
@@ -0,0 +1,47 @@
+#ifndef PHR_CORE_TRANSFORMCACHE_H
+#define PHR_CORE_TRANSFORMCACHE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "core/transform.h"
+#include "core/util/MemoryArena.h"
+
+// Interns transforms, so shapes that share a placement share one Transform
+// instead of each owning a copy. Lookup() hands out a pointer to the cached
+// copy of a transform equal (by Transform::isEqual) to the one asked for,
+// storing it on first use. Cached transforms live in an arena, packed next to
+// each other, and stay valid until the cache is destroyed. Not thread-safe.
+class TransformCache {
+ public:
+  TransformCache() : arena(16384) {}
+  TransformCache(const TransformCache &) = delete;
+  TransformCache &operator=(const TransformCache &) = delete;
+
+  const Transform *Lookup(const Transform &t);
+  // Looks up _t_ and its inverse, the pair a Shape is built from.
+  void Lookup(const Transform &t, const Transform **tCached,
+              const Transform **tCachedInverse) {
+    *tCached = Lookup(t);
+    *tCachedInverse = Lookup(Inverse(t));
+  }
+
+  // Distinct transforms stored, and Lookup() calls made.
+  size_t Unique() const { return nUnique; }
+  size_t Requests() const { return nRequests; }
+  // Bytes of transform storage and hash table owned by the cache.
+  size_t BytesUsed() const {
+    return arena.TotalAllocated() + table.size() * sizeof(const Transform *);
+  }
+
+ private:
+  void grow();
+
+  MemoryArena arena;
+  // Open addressing with linear probing; the size is a power of two and at
+  // most half the slots are used.
+  std::vector<const Transform *> table;
+  size_t nUnique = 0, nRequests = 0;
+};
+
+#endif  // PHR_CORE_TRANSFORMCACHE_H
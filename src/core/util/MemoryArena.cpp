@@ -1,29 +1,73 @@
 #include "MemoryArena.h"
 
+#include <algorithm>
+#include <new>
+
+#include "core/AllocAligned.h"
+
+MemoryArena::~MemoryArena() {
+  for (auto& block : usedBlocks) FreeAligned(block.second);
+  for (auto& block : availableBlocks) FreeAligned(block.second);
+}
+
 void* MemoryArena::alloc(size_t nBytes) {
   nBytes = (nBytes + 15) & (~15);
   if (currentBlockPosition + nBytes > currentAllocSize) {
-    if (currentBlock) {
-      usedBlocks.push_back(std::make_pair(currentAllocSize, currentBlock));
-      currentBlock = nullptr;
-    }
-    for (auto iter = availableBlocks.begin(); iter != availableBlocks.end();
-         iter++) {
-      if (iter->first >= nBytes) {
-        currentAllocSize = iter->first;
-        currentBlock = iter->second;
-        availableBlocks.erase(iter);
-        break;
-      }
-    }
-    if (!currentBlock) {
-      currentAllocSize = std::max(nBytes, blockSize);
-      // TODO: come back for cache alignment (allocalign)
-      currentBlock = new uint8_t[currentAllocSize];
+    // The full block stays in usedBlocks; reuse a large enough free block or
+    // add a new one behind it.
+    auto iter = std::find_if(
+        availableBlocks.begin(), availableBlocks.end(),
+        [nBytes](const std::pair<size_t, uint8_t*>& b) {
+          return b.first >= nBytes;
+        });
+    if (iter != availableBlocks.end()) {
+      usedBlocks.splice(usedBlocks.end(), availableBlocks, iter);
+    } else {
+      size_t size = std::max(nBytes, blockSize);
+      uint8_t* block = AllocAligned<uint8_t>(size);
+      if (!block) throw std::bad_alloc();
+      usedBlocks.emplace_back(size, block);
     }
+    currentAllocSize = usedBlocks.back().first;
+    currentBlock = usedBlocks.back().second;
+    currentBlockPosition = 0;
   }
 
   void* ret = currentBlock + currentBlockPosition;
   currentBlockPosition += nBytes;
+  bytesInUse += nBytes;
+  highWaterMark = std::max(highWaterMark, bytesInUse);
   return ret;
 }
+
+void MemoryArena::Reset() {
+  currentBlockPosition = 0;
+  currentAllocSize = 0;
+  currentBlock = nullptr;
+  bytesInUse = 0;
+  availableBlocks.splice(availableBlocks.begin(), usedBlocks);
+}
+
+size_t MemoryArena::TotalAllocated() const {
+  size_t total = 0;
+  for (const auto& block : usedBlocks) total += block.first;
+  for (const auto& block : availableBlocks) total += block.first;
+  return total;
+}
+
+ArenaPool::ArenaPool(int nThreads, size_t blockSize) {
+  for (int i = 0; i < nThreads; ++i)
+    arenas.push_back(std::make_unique<PaddedArena>(blockSize));
+}
+
+size_t ArenaPool::HighWaterMark() const {
+  size_t mark = 0;
+  for (const auto& a : arenas) mark = std::max(mark, a->arena.HighWaterMark());
+  return mark;
+}
+
+size_t ArenaPool::TotalAllocated() const {
+  size_t total = 0;
+  for (const auto& a : arenas) total += a->arena.TotalAllocated();
+  return total;
+}
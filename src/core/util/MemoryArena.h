@@ -4,11 +4,23 @@
 #include <cstddef>
 #include <cstdint>
 #include <list>
+#include <memory>
+#include <new>
 #include <utility>
+#include <vector>
 
+// Bump allocator for short-lived objects. Blocks are cache-line aligned and
+// are kept across Reset() calls, so once an arena has grown to its working
+// size allocating from it never touches the heap. Destructors of allocated
+// objects are never run. Not thread-safe; give each thread its own arena
+// (see ArenaPool).
 class MemoryArena {
  public:
   MemoryArena(size_t blockSize = 262144) : blockSize(blockSize) {}
+  ~MemoryArena();
+  MemoryArena(const MemoryArena&) = delete;
+  MemoryArena& operator=(const MemoryArena&) = delete;
+
   void* alloc(size_t nBytes);
   template <typename T>
   T* alloc(size_t n = 1, bool runConstructor = true) {
@@ -18,14 +30,48 @@ class MemoryArena {
     return ret;
   }
 
+  // Makes every block available again. Memory handed out before the call
+  // must no longer be used.
+  void Reset();
+
+  // Bytes of block storage owned by the arena.
+  size_t TotalAllocated() const;
+  // Most bytes handed out between two Reset() calls.
+  size_t HighWaterMark() const { return highWaterMark; }
+
  private:
   const size_t blockSize;
   // NOTE: currentBlockPosition is the offset from the start of the current
   // block to the next free byte. currentAllocSize is the total size of the
-  // current
+  // current block. The current block is also the last entry of usedBlocks,
+  // so that switching blocks only splices list nodes and never allocates.
   size_t currentBlockPosition = 0, currentAllocSize = 0;
   uint8_t* currentBlock = nullptr;
+  size_t bytesInUse = 0, highWaterMark = 0;
   std::list<std::pair<size_t, uint8_t*>> usedBlocks, availableBlocks;
 };
 
+// One MemoryArena per worker thread, each on its own cache lines. A worker
+// only touches the arena at its own thread index, so no locking is needed.
+class ArenaPool {
+ public:
+  explicit ArenaPool(int nThreads, size_t blockSize = 262144);
+
+  MemoryArena& operator[](int threadIndex) {
+    return arenas[threadIndex]->arena;
+  }
+  int Size() const { return int(arenas.size()); }
+
+  // Largest per-thread high-water mark, and the block storage of all arenas.
+  size_t HighWaterMark() const;
+  size_t TotalAllocated() const;
+
+ private:
+  struct alignas(64) PaddedArena {
+    explicit PaddedArena(size_t blockSize) : arena(blockSize) {}
+    MemoryArena arena;
+  };
+  std::vector<std::unique_ptr<PaddedArena>> arenas;
+};
+
 #endif  // PHR_CORE_UTIL_MEMORYARENA_H
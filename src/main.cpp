@@ -6,66 +6,105 @@
 #include <CashewLib/Input/KeyCodes.h>
 
 #include <cstdint>
-#include <iomanip>
+#include <exception>
 #include <memory>
+#include <string>
 
+#include "core/film.h"
+#include "core/progressive.h"
+#include "core/scene.h"
 #include "imgui.h"
-#include "shapes/sphere.h"
+
+// Set from the command line before the layer is created.
+static std::string sceneFile = "scenes/mesh.scene";
 
 class ExampleLayer : public Cashew::Layer {
  public:
-  virtual void onUIRender() override {
-    ImGui::Begin("Configuration");
-    if (ImGui::Button("Render") ||
-        ImGui::ColorEdit4("Temporary Colour: ", &m_tempColour.x)) {
-      Render();
+  ExampleLayer() {
+    try {
+      m_scene = LoadScene(sceneFile);
+    } catch (const std::exception &e) {
+      m_error = e.what();
+      return;
     }
-    ImGui::Text("Viewport size: %d x %d", m_viewportWidth, m_viewportHeight);
+    m_settings.camera = m_scene->camera;
+    m_renderer = std::make_unique<ProgressiveRenderer>(*m_scene);
+  }
 
+  virtual void onUIRender() override {
+    ImGui::Begin("Configuration");
+    bool changed = ImGui::Button("Restart");
+    changed |= ImGui::ColorEdit3("Background", &m_settings.background.x);
+    changed |= ImGui::SliderFloat("FOV", &m_settings.camera.fov, 5.f, 120.f);
+    changed |= ImGui::SliderInt("Max samples", &m_settings.maxSamples, 1, 4096);
+    int spectrum = int(m_settings.spectrum);
+    changed |= ImGui::Combo("Spectrum", &spectrum, "RGB\0Sampled\0Hero\0");
+    m_settings.spectrum = SpectrumMode(spectrum);
+    int sampler = int(m_settings.sampler);
+    changed |= ImGui::Combo("Sampler", &sampler,
+                            "Independent\0Stratified\0Sobol\0PMJ02\0");
+    m_settings.sampler = SamplerType(sampler);
+    ImGui::Text("Viewport size: %d x %d", m_settings.resolution.x,
+                m_settings.resolution.y);
+    ImGui::Text("Samples: %d", m_samples);
+    if (!m_error.empty()) ImGui::TextWrapped("%s", m_error.c_str());
     ImGui::End();
 
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
     ImGui::Begin("Viewport");
-    m_viewportWidth = ImGui::GetContentRegionAvail().x;
-    m_viewportHeight = ImGui::GetContentRegionAvail().y;
+    Point2i viewport(int(ImGui::GetContentRegionAvail().x),
+                     int(ImGui::GetContentRegionAvail().y));
+    if (viewport != m_settings.resolution) {
+      m_settings.resolution = viewport;
+      changed = true;
+    }
+    if (m_renderer) {
+      if (changed) m_renderer->Restart(m_settings);
+      present();
+    }
 
     if (m_image) {
-      ImGui::Image(m_image->getDescriptorSet(),
-                   {(float)m_image->getWidth(), (float)m_image->getHeight()},
-                   ImVec2(0, 1), ImVec2(1, 0));
+      // The texture is allocated at the film's capacity; only the top-left
+      // Resolution() pixels of it are current.
+      const Point2i &res = m_film.Resolution();
+      const Point2i &capacity = m_film.Capacity();
+      ImGui::Image(m_image->getDescriptorSet(), {(float)res.x, (float)res.y},
+                   ImVec2(0, 0),
+                   ImVec2((float)res.x / capacity.x,
+                          (float)res.y / capacity.y));
     }
     ImGui::End();
     ImGui::PopStyleVar();
   }
 
-  void Render() {
-    if (!m_image || m_viewportWidth != m_image->getWidth() ||
-        m_viewportHeight != m_image->getHeight()) {
-      m_image = std::make_shared<Cashew::Image>(
-          m_viewportWidth, m_viewportHeight, Cashew::ImageFormat::RGBA);
-
-      delete[] m_imageData;
-      m_imageData = new uint32_t[m_viewportWidth * m_viewportHeight];
-    }
-
-    for (uint32_t y = 0; y < m_viewportHeight; y++) {
-      for (uint32_t x = 0; x < m_viewportWidth; x++) {
-        m_imageData[x + y * m_viewportWidth] =
-            ImGui::ColorConvertFloat4ToU32(m_tempColour);
-      }
-    }
-    m_image->setData(m_imageData);
+ private:
+  // Uploads the renderer's latest pass, if there is one. The renderer only
+  // publishes at a fixed cadence, so this is cheap on most frames. Film
+  // capacities only grow, so dragging the window smaller, or back and forth
+  // within a size already seen, never recreates the image.
+  void present() {
+    if (!m_renderer->TakeFrame(&m_film, &m_samples)) return;
+    const Point2i &capacity = m_film.Capacity();
+    if (!m_image || uint32_t(capacity.x) != m_image->getWidth() ||
+        uint32_t(capacity.y) != m_image->getHeight())
+      m_image = std::make_shared<Cashew::Image>(capacity.x, capacity.y,
+                                                Cashew::ImageFormat::RGBA);
+    m_image->setData(m_film.Display());
   }
 
- private:
+  // Declared before the renderer, which refers to it and must stop first.
+  std::unique_ptr<Scene> m_scene;
+  std::unique_ptr<ProgressiveRenderer> m_renderer;
+  ProgressiveSettings m_settings;
   std::shared_ptr<Cashew::Image> m_image;
-  uint32_t *m_imageData = nullptr;
-  uint32_t m_viewportWidth = 0;
-  uint32_t m_viewportHeight = 0;
-  ImVec4 m_tempColour;
+  Film m_film;
+  int m_samples = 0;
+  std::string m_error;
 };
 
 Cashew::Application *Cashew::CreateApplication(int argc, char **argv) {
+  if (argc > 1) sceneFile = argv[1];
+
   Cashew::ApplicationSpecification spec;
   spec.Name = "Cashew Example";
 
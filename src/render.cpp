@@ -0,0 +1,333 @@
+// Headless batch renderer. Links only phr_core, so it runs on build nodes
+// without a display or Vulkan.
+//
+//   phr_render <scene> <output.ppm> [--width N] [--height N] [--threads N]
+//              [--tile-size N] [--tile-timings out.csv]
+//              [--bvh sah|hlbvh|middle|equal] [--bvh-buckets N]
+//              [--bvh-layout binary|wide4|wide8] [--no-packets]
+//              [--scene-cache file] [--bvh-report]
+//              [--spectrum rgb|sampled|hero] [--spp N]
+//              [--sampler independent|stratified|sobol|pmj02]
+//              [--adaptive threshold] [--adaptive-min N]
+//              [--sample-counts counts.ppm]
+//
+// Builds with PHR_ENABLE_STATS also print traversal statistics.
+//
+// Camera rays are traced in packets of eight unless --no-packets is given.
+// Packets only traverse the binary layout; with --bvh-layout wide4 or wide8
+// their rays are traced one at a time through the wide nodes.
+//
+// --bvh-buckets sets the SAH buckets per axis, from 2 to 64 (default 12).
+//
+// --bvh-report prints the quality metrics of the scene BVH (SAH cost, node
+// counts, depth and leaf size histograms, sibling overlap, memory). The
+// output image may then be left out, to report without rendering.
+//
+// By default each pixel gets one ray through its centre. --spp and
+// --sampler take N samples per pixel (default 1) from the given sampler
+// (default sobol) instead.
+//
+// --adaptive spends the same total number of samples, N per pixel on
+// average, where the image is noisiest: pixels stop once the standard error
+// of their mean luminance falls below _threshold_ (e.g. 0.01) relative to
+// the mean. Every pixel takes the --adaptive-min samples first (default
+// N / 4, between 4 and 64), and none takes more than 16 N.
+// --sample-counts then writes the number of samples each pixel took, as a
+// grey image scaled so the largest count is white.
+//
+// --spectrum carries the shading result through a SampledSpectrum or a set
+// of four hero wavelengths and back, instead of plain RGB (the default).
+//
+// With --scene-cache the scene is loaded from the cache file when it is up to
+// date, and the cache is (re)written after parsing otherwise. Scenes the
+// cache cannot hold, such as ones with instances or moving instances, are
+// rendered anyway with a warning.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "accelerators/bvhmetrics.h"
+#include "core/camera.h"
+#include "core/film.h"
+#include "core/imageio.h"
+#include "core/parallel.h"
+#include "core/renderer.h"
+#include "core/sampler.h"
+#include "core/scene.h"
+#include "core/scenecache.h"
+#include "core/stats.h"
+#include "core/tilescheduler.h"
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s <scene> <output.ppm> [--width N] [--height N]\n"
+          "         [--threads N] [--tile-size N] [--tile-timings out.csv]\n"
+          "         [--bvh sah|hlbvh|middle|equal] [--bvh-buckets N]\n"
+          "         [--bvh-layout binary|wide4|wide8] [--no-packets]\n"
+          "         [--scene-cache file] [--bvh-report]\n"
+          "         [--spectrum rgb|sampled|hero] [--spp N]\n"
+          "         [--sampler independent|stratified|sobol|pmj02]\n"
+          "         [--adaptive threshold] [--adaptive-min N]\n"
+          "         [--sample-counts counts.ppm]\n"
+          "Packets traverse only the binary layout; with a wide layout\n"
+          "their rays are traced one at a time.\n",
+          argv0);
+  exit(1);
+}
+
+static BVHSplitMethod parseSplitMethod(const char *argv0, const char *name) {
+  if (!strcmp(name, "sah")) return BVHSplitMethod::SAH;
+  if (!strcmp(name, "hlbvh")) return BVHSplitMethod::HLBVH;
+  if (!strcmp(name, "middle")) return BVHSplitMethod::Middle;
+  if (!strcmp(name, "equal")) return BVHSplitMethod::EqualCounts;
+  usage(argv0);
+  return BVHSplitMethod::SAH;
+}
+
+static BVHLayout parseLayout(const char *argv0, const char *name) {
+  if (!strcmp(name, "binary")) return BVHLayout::Binary;
+  if (!strcmp(name, "wide4")) return BVHLayout::Wide4;
+  if (!strcmp(name, "wide8")) return BVHLayout::Wide8;
+  usage(argv0);
+  return BVHLayout::Binary;
+}
+
+static SpectrumMode parseSpectrumMode(const char *argv0, const char *name) {
+  if (!strcmp(name, "rgb")) return SpectrumMode::RGB;
+  if (!strcmp(name, "sampled")) return SpectrumMode::Sampled;
+  if (!strcmp(name, "hero")) return SpectrumMode::Hero;
+  usage(argv0);
+  return SpectrumMode::RGB;
+}
+
+static SamplerType parseSamplerType(const char *argv0, const char *name) {
+  if (!strcmp(name, "independent")) return SamplerType::Independent;
+  if (!strcmp(name, "stratified")) return SamplerType::Stratified;
+  if (!strcmp(name, "sobol")) return SamplerType::Sobol;
+  if (!strcmp(name, "pmj02")) return SamplerType::PMJ02;
+  usage(argv0);
+  return SamplerType::Sobol;
+}
+
+static void reportTileTimings(const TileScheduler &scheduler, int nThreads) {
+  const std::vector<TileTiming> &timings = scheduler.Timings();
+  double total = 0, slowest = 0;
+  int nStolen = 0;
+  for (const TileTiming &t : timings) {
+    total += t.seconds;
+    slowest = std::max(slowest, t.seconds);
+    nStolen += t.stolen;
+  }
+  printf("%d threads, %d tiles of %dx%d: avg %.3fms, max %.3fms, %d stolen\n",
+         nThreads, scheduler.TileCount(), scheduler.TileSize(),
+         scheduler.TileSize(), 1000 * total / timings.size(), 1000 * slowest,
+         nStolen);
+}
+
+static void writeTileTimings(const TileScheduler &scheduler,
+                             const std::string &filename) {
+  std::ofstream out(filename);
+  if (!out)
+    throw std::runtime_error("unable to open \"" + filename +
+                             "\" for writing.\n");
+  out << "x0,y0,x1,y1,seconds,thread,stolen\n";
+  for (const TileTiming &t : scheduler.Timings())
+    out << t.bounds.pMin.x << ',' << t.bounds.pMin.y << ',' << t.bounds.pMax.x
+        << ',' << t.bounds.pMax.y << ',' << t.seconds << ',' << t.threadIndex
+        << ',' << t.stolen << '\n';
+}
+
+static void reportSampleCounts(const VarianceFilm &film, int spp) {
+  std::vector<int> counts;
+  film.GetSampleCounts(&counts);
+  if (counts.empty()) return;
+  int lo = *std::min_element(counts.begin(), counts.end());
+  int hi = *std::max_element(counts.begin(), counts.end());
+  size_t nBelow = std::count_if(counts.begin(), counts.end(),
+                                [&](int n) { return n < spp; });
+  printf("Adaptive: %d to %d samples per pixel, %.1f%% of pixels below %d\n",
+         lo, hi, 100. * nBelow / counts.size(), spp);
+}
+
+// The sample count AOV: each count over the largest, as linear grey.
+static void writeSampleCounts(const VarianceFilm &film,
+                              const std::string &filename) {
+  std::vector<int> counts;
+  film.GetSampleCounts(&counts);
+  int hi = counts.empty() ? 1
+                          : std::max(1, *std::max_element(counts.begin(),
+                                                          counts.end()));
+  std::vector<Float> grey(3 * counts.size());
+  for (size_t i = 0; i < counts.size(); ++i)
+    grey[3 * i] = grey[3 * i + 1] = grey[3 * i + 2] = Float(counts[i]) / hi;
+  WriteImage(filename, grey.data(), film.Resolution());
+}
+
+int main(int argc, char **argv) {
+  std::string sceneFile, outFile;
+  std::string tileTimingsFile, cacheFile, sampleCountsFile;
+  int width = 640, height = 480;
+  int nThreads = 0, tileSize = 16;
+  BVHSplitMethod splitMethod = BVHSplitMethod::SAH;
+  BVHLayout layout = BVHLayout::Binary;
+  int sahBuckets = DefaultSAHBuckets;
+  bool usePackets = true;
+  bool bvhReport = false;
+  SpectrumMode spectrumMode = SpectrumMode::RGB;
+  bool useSampler = false;
+  int spp = 1;
+  SamplerType samplerType = SamplerType::Sobol;
+  Float adaptiveThreshold = 0;
+  int adaptiveMin = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--width") && i + 1 < argc)
+      width = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--height") && i + 1 < argc)
+      height = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+      nThreads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--tile-size") && i + 1 < argc)
+      tileSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--tile-timings") && i + 1 < argc)
+      tileTimingsFile = argv[++i];
+    else if (!strcmp(argv[i], "--bvh") && i + 1 < argc)
+      splitMethod = parseSplitMethod(argv[0], argv[++i]);
+    else if (!strcmp(argv[i], "--bvh-buckets") && i + 1 < argc)
+      sahBuckets = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--bvh-layout") && i + 1 < argc)
+      layout = parseLayout(argv[0], argv[++i]);
+    else if (!strcmp(argv[i], "--scene-cache") && i + 1 < argc)
+      cacheFile = argv[++i];
+    else if (!strcmp(argv[i], "--spectrum") && i + 1 < argc)
+      spectrumMode = parseSpectrumMode(argv[0], argv[++i]);
+    else if (!strcmp(argv[i], "--spp") && i + 1 < argc) {
+      spp = atoi(argv[++i]);
+      useSampler = true;
+    } else if (!strcmp(argv[i], "--sampler") && i + 1 < argc) {
+      samplerType = parseSamplerType(argv[0], argv[++i]);
+      useSampler = true;
+    } else if (!strcmp(argv[i], "--adaptive") && i + 1 < argc) {
+      adaptiveThreshold = Float(atof(argv[++i]));
+      if (!(adaptiveThreshold > 0)) usage(argv[0]);
+      useSampler = true;
+    } else if (!strcmp(argv[i], "--adaptive-min") && i + 1 < argc)
+      adaptiveMin = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--sample-counts") && i + 1 < argc)
+      sampleCountsFile = argv[++i];
+    else if (!strcmp(argv[i], "--no-packets"))
+      usePackets = false;
+    else if (!strcmp(argv[i], "--bvh-report"))
+      bvhReport = true;
+    else if (argv[i][0] == '-')
+      usage(argv[0]);
+    else if (sceneFile.empty())
+      sceneFile = argv[i];
+    else if (outFile.empty())
+      outFile = argv[i];
+    else
+      usage(argv[0]);
+  }
+  if (sceneFile.empty() || (outFile.empty() && !bvhReport) || width <= 0 ||
+      height <= 0 || tileSize <= 0 || sahBuckets < 2 ||
+      sahBuckets > MaxSAHBuckets || spp <= 0 || adaptiveMin < 0 ||
+      (!sampleCountsFile.empty() && adaptiveThreshold == 0))
+    usage(argv[0]);
+
+  try {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    std::unique_ptr<Scene> scene;
+    if (!cacheFile.empty())
+      scene = LoadSceneCache(cacheFile, splitMethod, layout, sahBuckets);
+    // A cache written for a different scene file does not count.
+    if (scene && (scene->SourceFiles().empty() ||
+                  scene->SourceFiles()[0] !=
+                      std::filesystem::absolute(sceneFile).string()))
+      scene.reset();
+    bool fromCache = scene != nullptr;
+    if (!scene) {
+      scene = LoadScene(sceneFile, splitMethod, layout, sahBuckets);
+      if (!cacheFile.empty()) {
+        // Failing to write the cache only costs the next run a parse.
+        try {
+          WriteSceneCache(cacheFile, *scene);
+        } catch (const std::exception &e) {
+          fprintf(stderr, "phr_render: warning: %s", e.what());
+        }
+      }
+    }
+    auto loaded = Clock::now();
+    std::chrono::duration<double> loadTime = loaded - start;
+    printf("Loaded %s in %.3fs%s\n", sceneFile.c_str(), loadTime.count(),
+           fromCache ? " from cache" : "");
+    const TransformCache &transforms = scene->Transforms();
+    printf("Transforms: %zu unique of %zu requested, %.1f KB\n",
+           transforms.Unique(), transforms.Requests(),
+           transforms.BytesUsed() / 1024.);
+    if (bvhReport) {
+      if (scene->BVH())
+        ReportBVHMetrics(stdout, ComputeBVHMetrics(*scene->BVH()));
+      else
+        printf("The scene aggregate is not a BVH.\n");
+      if (outFile.empty()) return 0;
+    }
+
+    const CameraDescription &cd = scene->camera;
+    PerspectiveCamera camera(cd.pos, cd.look, cd.up, cd.fov,
+                             Point2i(width, height));
+    ThreadPool pool(nThreads);
+    TileScheduler scheduler(pool, camera.Resolution(), tileSize);
+    std::vector<Float> rgb;
+    ArenaPool arenas(pool.Size());
+    std::unique_ptr<Sampler> sampler;
+    if (useSampler) sampler = CreateSampler(samplerType, spp);
+    ResetStats();
+    int64_t nSamples = int64_t(width) * height * spp;
+    // Sized by RenderAdaptive().
+    VarianceFilm film(Point2i(0, 0));
+    if (adaptiveThreshold > 0) {
+      AdaptiveSettings settings;
+      settings.threshold = adaptiveThreshold;
+      settings.minSamples =
+          adaptiveMin > 0 ? adaptiveMin : Clamp(spp / 4, 4, 64);
+      settings.maxSamples = 16 * spp;
+      nSamples = RenderAdaptive(*scene, camera, scheduler, *sampler, settings,
+                                &film, usePackets, &arenas, spectrumMode);
+      film.GetRGB(&rgb);
+    } else {
+      Render(*scene, camera, scheduler, &rgb, usePackets, &arenas,
+             spectrumMode, sampler.get());
+    }
+    auto rendered = Clock::now();
+
+    WriteImage(outFile, rgb.data(), camera.Resolution());
+    if (!sampleCountsFile.empty())
+      writeSampleCounts(film, sampleCountsFile);
+
+    std::chrono::duration<double> renderTime = rendered - loaded;
+    printf("Rendered %dx%d at %.2f spp in %.3fs (%.2f Mrays/s)\n", width,
+           height, double(nSamples) / (double(width) * height),
+           renderTime.count(), nSamples / renderTime.count() / 1e6);
+    if (adaptiveThreshold > 0) reportSampleCounts(film, spp);
+    reportTileTimings(scheduler, pool.Size());
+    printf("Sample arenas: %.1f KB high-water, %.1f KB allocated\n",
+           arenas.HighWaterMark() / 1024., arenas.TotalAllocated() / 1024.);
+    if (StatsEnabled())
+      ReportStats(stdout, MergeStats(), renderTime.count());
+    if (!tileTimingsFile.empty())
+      writeTileTimings(scheduler, tileTimingsFile);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "phr_render: %s", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,8 @@
+#include "samplers/independent.h"
+
+#include "core/lowdiscrepancy.h"
+
+Float IndependentSampler::Get1D(const Point2i &pixel, int index,
+                                int dim) const {
+  return BitsToUnitFloat(pixelSeed(pixel, uint32_t(index), uint32_t(dim)));
+}
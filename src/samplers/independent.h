@@ -0,0 +1,16 @@
+#ifndef PHR_SAMPLERS_INDEPENDENT_H
+#define PHR_SAMPLERS_INDEPENDENT_H
+
+#include "core/sampler.h"
+
+// Uniform random values with no stratification, hashed from the pixel,
+// index and dimension: the baseline the other samplers are measured against.
+class IndependentSampler : public Sampler {
+ public:
+  IndependentSampler(int samplesPerPixel, uint32_t seed = 0)
+      : Sampler(samplesPerPixel, seed) {}
+
+  Float Get1D(const Point2i &pixel, int index, int dim) const override;
+};
+
+#endif  // PHR_SAMPLERS_INDEPENDENT_H
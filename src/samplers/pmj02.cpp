@@ -0,0 +1,11 @@
+#include "samplers/pmj02.h"
+
+#include "core/lowdiscrepancy.h"
+
+Float PMJ02Sampler::Get1D(const Point2i &pixel, int index, int dim) const {
+  // Both dimensions of a pair must see the same shuffled index.
+  uint32_t i = OwenScramble(uint32_t(index),
+                            pixelSeed(pixel, uint32_t(dim / 2), 0x68e31da4u));
+  uint32_t v = SobolSample(i, dim % 2);
+  return BitsToUnitFloat(OwenScramble(v, pixelSeed(pixel, uint32_t(dim))));
+}
@@ -0,0 +1,24 @@
+#ifndef PHR_SAMPLERS_PMJ02_H
+#define PHR_SAMPLERS_PMJ02_H
+
+#include "core/sampler.h"
+
+// A progressive (0, 2)-sequence for every pair of dimensions: each
+// power-of-two prefix of a pixel's samples has one sample in every
+// elementary interval of that area, the stratification of Christensen et
+// al.'s progressive multi-jittered (0, 2) sequences. Rather than from
+// precomputed tables, the points come from the first two Sobol' dimensions,
+// which form a (0, 2)-sequence, with the index shuffled and the values
+// Owen-scrambled per pixel and pair (Burley, 2020). Unlike SobolSampler the
+// pairs are uncorrelated with each other, so it trades some
+// higher-dimensional uniformity for freedom from structured artifacts
+// between them.
+class PMJ02Sampler : public Sampler {
+ public:
+  PMJ02Sampler(int samplesPerPixel, uint32_t seed = 0)
+      : Sampler(samplesPerPixel, seed) {}
+
+  Float Get1D(const Point2i &pixel, int index, int dim) const override;
+};
+
+#endif  // PHR_SAMPLERS_PMJ02_H
@@ -0,0 +1,12 @@
+#include "samplers/sobol.h"
+
+#include "core/lowdiscrepancy.h"
+
+Float SobolSampler::Get1D(const Point2i &pixel, int index, int dim) const {
+  uint32_t i = uint32_t(index);
+  if (dim >= NSobolDimensions)
+    i = OwenScramble(i, pixelSeed(pixel, uint32_t(dim / NSobolDimensions),
+                                  0x5bd1e995u));
+  uint32_t v = SobolSample(i, dim % NSobolDimensions);
+  return BitsToUnitFloat(OwenScramble(v, pixelSeed(pixel, uint32_t(dim))));
+}
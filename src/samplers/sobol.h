@@ -0,0 +1,21 @@
+#ifndef PHR_SAMPLERS_SOBOL_H
+#define PHR_SAMPLERS_SOBOL_H
+
+#include "core/sampler.h"
+
+// The Sobol' sequence, Owen-scrambled independently for every pixel and
+// dimension. The first NSobolDimensions dimensions, which cover everything
+// the renderers sample today, are one low-discrepancy sequence; higher
+// dimensions reuse those matrices with the sample index shuffled by another
+// nested scramble (Burley, "Practical Hash-based Owen Scrambling", 2020), so
+// each group of four stays well stratified on its own. Convergence is best
+// at power-of-two sample counts.
+class SobolSampler : public Sampler {
+ public:
+  SobolSampler(int samplesPerPixel, uint32_t seed = 0)
+      : Sampler(samplesPerPixel, seed) {}
+
+  Float Get1D(const Point2i &pixel, int index, int dim) const override;
+};
+
+#endif  // PHR_SAMPLERS_SOBOL_H
@@ -0,0 +1,28 @@
+#include "samplers/stratified.h"
+
+#include <cmath>
+
+#include "core/lowdiscrepancy.h"
+
+StratifiedSampler::StratifiedSampler(int samplesPerPixel, uint32_t seed)
+    : Sampler(samplesPerPixel, seed),
+      m(std::max(1, int(std::sqrt(Float(samplesPerPixel))))),
+      n((samplesPerPixel + m - 1) / m) {}
+
+Float StratifiedSampler::Get1D(const Point2i &pixel, int index,
+                               int dim) const {
+  // Each run of SamplesPerPixel() indices is a pattern of its own.
+  const uint32_t nSamples = uint32_t(samplesPerPixel);
+  uint32_t p = pixelSeed(pixel, uint32_t(dim / 2), uint32_t(index) / nSamples);
+  int s = PermutationElement(uint32_t(index) % nSamples, nSamples,
+                             p * 0x51633e2du);
+  // The 1D strata of one axis are shuffled within each row or column of the
+  // other, so the coarse and fine stratifications hold together.
+  Float jitter = BitsToUnitFloat(uint32_t(HashSeed(s, p, dim)));
+  if (dim % 2 == 0) {
+    int sy = PermutationElement(s / m, n, p * 0x02e5be93u);
+    return std::min((s % m + (sy + jitter) / n) / m, OneMinusEpsilon);
+  }
+  int sx = PermutationElement(s % m, m, p * 0x68bc21ebu);
+  return std::min((s / m + (sx + jitter) / m) / n, OneMinusEpsilon);
+}
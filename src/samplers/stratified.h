@@ -0,0 +1,23 @@
+#ifndef PHR_SAMPLERS_STRATIFIED_H
+#define PHR_SAMPLERS_STRATIFIED_H
+
+#include "core/sampler.h"
+
+// Correlated multi-jittered sampling (Kensler, 2013): each pair of
+// dimensions gets a grid of m x n strata, as square as SamplesPerPixel()
+// allows, with at most one sample in each; projected onto either axis, the
+// samples also fall in distinct ones of m * n finer strata. Samples visit
+// the strata in a hashed order, so a pixel that stops early still has its
+// samples spread over the whole pixel.
+class StratifiedSampler : public Sampler {
+ public:
+  StratifiedSampler(int samplesPerPixel, uint32_t seed = 0);
+
+  Float Get1D(const Point2i &pixel, int index, int dim) const override;
+
+ private:
+  // Strata along the first and second dimension of each pair.
+  const int m, n;
+};
+
+#endif  // PHR_SAMPLERS_STRATIFIED_H
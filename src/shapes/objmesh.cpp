@@ -0,0 +1,145 @@
+#include "shapes/objmesh.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "shapes/triangle.h"
+
+namespace {
+
+struct OBJIndex {
+  int p, uv, n;
+  bool operator<(const OBJIndex &o) const {
+    return std::tie(p, uv, n) < std::tie(o.p, o.uv, o.n);
+  }
+};
+
+// Resolves a 1-based (or negative, relative) OBJ index against _count_
+// elements. Returns -1 for an out-of-range index.
+int resolveIndex(int index, int count) {
+  int i = index > 0 ? index - 1 : count + index;
+  return (i >= 0 && i < count) ? i : -1;
+}
+
+// Parses one "p", "p/uv", "p//n" or "p/uv/n" face vertex.
+bool parseFaceVertex(const std::string &token, int nP, int nUV, int nN,
+                     OBJIndex *idx) {
+  int values[3] = {0, 0, 0};
+  size_t start = 0;
+  for (int i = 0; i < 3 && start <= token.size(); ++i) {
+    size_t slash = token.find('/', start);
+    std::string field = token.substr(
+        start, slash == std::string::npos ? std::string::npos : slash - start);
+    if (!field.empty()) {
+      try {
+        values[i] = std::stoi(field);
+      } catch (const std::exception &) {
+        return false;
+      }
+      if (values[i] == 0) return false;
+    }
+    if (slash == std::string::npos) break;
+    start = slash + 1;
+  }
+  idx->p = resolveIndex(values[0], nP);
+  idx->uv = values[1] ? resolveIndex(values[1], nUV) : -1;
+  idx->n = values[2] ? resolveIndex(values[2], nN) : -1;
+  return idx->p >= 0 && (values[1] == 0 || idx->uv >= 0) &&
+         (values[2] == 0 || idx->n >= 0);
+}
+
+}  // namespace
+
+std::vector<std::shared_ptr<Shape>> CreateOBJMesh(const Transform *o2w,
+                                                  const Transform *w2o,
+                                                  bool reverseOrientation,
+                                                  const std::string &filename) {
+  std::ifstream in(filename);
+  if (!in)
+    throw std::runtime_error("CreateOBJMesh: unable to open \"" + filename +
+                             "\".\n");
+
+  std::vector<Point3f> filePositions;
+  std::vector<Point2f> fileUVs;
+  std::vector<Normal3f> fileNormals;
+
+  // Unique (position, uv, normal) triples become mesh vertices.
+  std::map<OBJIndex, int> vertexMap;
+  std::vector<OBJIndex> vertices;
+  std::vector<int> indices;
+
+  std::string line;
+  int lineNumber = 0;
+  std::vector<int> face;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    std::istringstream ss(line);
+    std::string keyword;
+    if (!(ss >> keyword) || keyword[0] == '#') continue;
+
+    bool ok = true;
+    if (keyword == "v") {
+      Float x, y, z;
+      ok = bool(ss >> x >> y >> z);
+      filePositions.push_back(Point3f(x, y, z));
+    } else if (keyword == "vt") {
+      Float u, v;
+      ok = bool(ss >> u >> v);
+      fileUVs.push_back(Point2f(u, v));
+    } else if (keyword == "vn") {
+      Float x, y, z;
+      ok = bool(ss >> x >> y >> z);
+      fileNormals.push_back(Normal3f(x, y, z));
+    } else if (keyword == "f") {
+      face.clear();
+      std::string token;
+      while (ok && ss >> token) {
+        OBJIndex idx;
+        ok = parseFaceVertex(token, int(filePositions.size()),
+                             int(fileUVs.size()), int(fileNormals.size()),
+                             &idx);
+        if (!ok) break;
+        auto inserted = vertexMap.emplace(idx, int(vertices.size()));
+        if (inserted.second) vertices.push_back(idx);
+        face.push_back(inserted.first->second);
+      }
+      ok = ok && face.size() >= 3;
+      for (size_t i = 1; ok && i + 1 < face.size(); ++i) {
+        indices.push_back(face[0]);
+        indices.push_back(face[i]);
+        indices.push_back(face[i + 1]);
+      }
+    }
+    // Groups, materials and smoothing records are ignored.
+    if (!ok)
+      throw std::runtime_error(filename + ":" + std::to_string(lineNumber) +
+                               ": unable to parse \"" + line + "\".\n");
+  }
+  if (indices.empty())
+    throw std::runtime_error("CreateOBJMesh: \"" + filename +
+                             "\" has no faces.\n");
+
+  // Attributes are only kept when every vertex has them.
+  bool hasUV = true, hasN = true;
+  for (const OBJIndex &idx : vertices) {
+    hasUV &= idx.uv >= 0;
+    hasN &= idx.n >= 0;
+  }
+
+  std::vector<Point3f> p(vertices.size());
+  std::vector<Point2f> uv(hasUV ? vertices.size() : 0);
+  std::vector<Normal3f> n(hasN ? vertices.size() : 0);
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    p[i] = filePositions[vertices[i].p];
+    if (hasUV) uv[i] = fileUVs[vertices[i].uv];
+    if (hasN) n[i] = fileNormals[vertices[i].n];
+  }
+
+  return CreateTriangleMesh(o2w, w2o, reverseOrientation,
+                            int(indices.size() / 3), indices.data(),
+                            int(p.size()), p.data(), hasN ? n.data() : nullptr,
+                            hasUV ? uv.data() : nullptr);
+}
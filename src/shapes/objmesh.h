@@ -0,0 +1,21 @@
+#ifndef PHR_SHAPES_OBJMESH_H
+#define PHR_SHAPES_OBJMESH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/shape.h"
+#include "core/transform.h"
+
+// Loads the triangles of a Wavefront OBJ file as a single TriangleMesh.
+// Only "v", "vt", "vn" and "f" records are read; polygons are fan
+// triangulated and negative (relative) indices are supported. Vertices that
+// share the same position/uv/normal triple are shared by the mesh. Throws
+// std::runtime_error if the file cannot be read or is malformed.
+std::vector<std::shared_ptr<Shape>> CreateOBJMesh(const Transform *o2w,
+                                                  const Transform *w2o,
+                                                  bool reverseOrientation,
+                                                  const std::string &filename);
+
+#endif  // PHR_SHAPES_OBJMESH_H
@@ -1,5 +1,7 @@
 #include "shapes/sphere.h"
 
+#include "core/stats.h"
+
 Bounds3f Sphere::objectBound() const {
   return Bounds3f(Point3f(-radius, -radius, zMin),
                   Point3f(radius, radius, zMax));
@@ -7,48 +9,17 @@ Bounds3f Sphere::objectBound() const {
 
 bool Sphere::intersect(const Ray& ray, Float* tHit, SurfaceInteraction* isect,
                        bool testAlphaTexture) const {
-  Float phi;
+  PHR_STAT_INC(PrimitiveTests);
   Vector3f oErr, dErr;
-  Point3f pHit;
   Ray rayLocal = (*worldToObject)(ray, &oErr, &dErr);
   // TODO: Come back and add Rounding Error checks
-  Float ox = rayLocal.o.x, oy = rayLocal.o.y, oz = rayLocal.o.z;
-  Float dx = rayLocal.d.x, dy = rayLocal.d.y, dz = rayLocal.d.z;
-
-  Float a = dx * dx + dy * dy + dz * dz;
-  Float b = 2 * (dx * ox + dy * oy + dz * oz);
-  Float c = ox * ox + oy * oy + oz * oz - radius * radius;
-
-  Float t0, t1;
-  if (!Quadratic(a, b, c, &t0, &t1)) return false;
-
-  if (t0 > rayLocal.tMax || t1 <= 0) return false;
+  Float tShapeHit;
+  if (!IntersectSphere(rayLocal.o, rayLocal.d, rayLocal.tMax, radius, zMin,
+                       zMax, phiMax, &tShapeHit))
+    return false;
 
-  Float tShapeHit = t0;
-  if (tShapeHit <= 0) {
-    tShapeHit = t1;
-    if (tShapeHit > rayLocal.tMax) return false;
-  }
-
-  pHit = rayLocal((Float)tShapeHit);
-
-  if (pHit.x == 0 && pHit.y == 0) pHit.x = 1e-5f * radius;
-  phi = std::atan2(pHit.y, pHit.x);
-  if (phi < 0) phi += 2 * Pi;
-
-  if ((zMin > -radius && pHit.z < zMin) || (zMax < radius && pHit.z > zMax) ||
-      phi > phiMax) {
-    if (tShapeHit == t1) return false;
-    if (t1 > rayLocal.tMax) return false;
-    tShapeHit = t1;
-    pHit = rayLocal((Float)tShapeHit);
-    if (pHit.x == 0 && pHit.y == 0) pHit.x = 1e-5f * radius;
-    phi = std::atan2(pHit.y, pHit.x);
-    if (phi < 0) phi += 2 * Pi;
-    if ((zMin > -radius && pHit.z < zMin) || (zMax < radius && pHit.z > zMax) ||
-        phi > phiMax)
-      return false;
-  }
+  Point3f pHit = rayLocal(tShapeHit);
+  Float phi = SpherePhi(&pHit, radius);
 
   Float u = phi / phiMax;
   Float theta = std::acos(Clamp(pHit.z / radius, -1, 1));
@@ -92,53 +63,19 @@ bool Sphere::intersect(const Ray& ray, Float* tHit, SurfaceInteraction* isect,
 
   *tHit = (Float)tShapeHit;
 
+  PHR_STAT_INC(PrimitiveHits);
   return true;
 }
 
 bool Sphere::intersectP(const Ray& ray, bool testAlphaTexture) const {
-  Float phi;
+  PHR_STAT_INC(PrimitiveTests);
   Vector3f oErr, dErr;
-  Point3f pHit;
   Ray rayLocal = (*worldToObject)(ray, &oErr, &dErr);
-  // TODO: Come back and add Rounding Error checks
-  Float ox = rayLocal.o.x, oy = rayLocal.o.y, oz = rayLocal.o.z;
-  Float dx = rayLocal.d.x, dy = rayLocal.d.y, dz = rayLocal.d.z;
-
-  Float a = dx * dx + dy * dy + dz * dz;
-  Float b = 2 * (dx * ox + dy * oy + dz * oz);
-  Float c = ox * ox + oy * oy + oz * oz - radius * radius;
-
-  Float t0, t1;
-  if (!Quadratic(a, b, c, &t0, &t1)) return false;
-
-  if (t0 > rayLocal.tMax || t1 <= 0) return false;
-
-  Float tShapeHit = t0;
-  if (tShapeHit <= 0) {
-    tShapeHit = t1;
-    if (tShapeHit > rayLocal.tMax) return false;
-  }
-
-  pHit = rayLocal((Float)tShapeHit);
-
-  if (pHit.x == 0 && pHit.y == 0) pHit.x = 1e-5f * radius;
-  phi = std::atan2(pHit.y, pHit.x);
-  if (phi < 0) phi += 2 * Pi;
-
-  if ((zMin > -radius && pHit.z < zMin) || (zMax < radius && pHit.z > zMax) ||
-      phi > phiMax) {
-    if (tShapeHit == t1) return false;
-    if (t1 > rayLocal.tMax) return false;
-    tShapeHit = t1;
-    pHit = rayLocal((Float)tShapeHit);
-    if (pHit.x == 0 && pHit.y == 0) pHit.x = 1e-5f * radius;
-    phi = std::atan2(pHit.y, pHit.x);
-    if (phi < 0) phi += 2 * Pi;
-    if ((zMin > -radius && pHit.z < zMin) || (zMax < radius && pHit.z > zMax) ||
-        phi > phiMax)
-      return false;
-  }
-
+  Float tShapeHit;
+  if (!IntersectSphere(rayLocal.o, rayLocal.d, rayLocal.tMax, radius, zMin,
+                       zMax, phiMax, &tShapeHit))
+    return false;
+  PHR_STAT_INC(PrimitiveHits);
   return true;
 }
 
@@ -4,6 +4,8 @@
 #include "core/shape.h"
 #include "core/transform.h"
 
+// A sphere of _radius_ about the object-space origin, optionally clipped to
+// [zMin, zMax] and to azimuths in [0, phiMax]. _pm_ is in degrees.
 class Sphere : public Shape {
  public:
   Sphere(const Transform* o2w, const Transform* w2o, bool ro, Float rad,
@@ -13,7 +15,9 @@ class Sphere : public Shape {
         zMin(Clamp(std::min(z0, z1), -rad, rad)),
         zMax(Clamp(std::max(z0, z1), -rad, rad)),
         thetaMin(std::acos(Clamp(zMin / rad, -1, 1))),
-        thetaMax(std::acos(Clamp(zMax / rad, -1, 1))) {}
+        thetaMax(std::acos(Clamp(zMax / rad, -1, 1))),
+        // Exactly 2 * Pi for whole spheres, which are then never clipped.
+        phiMax(pm >= 360 ? 2 * Pi : glm::radians(Clamp(pm, 0, 360))) {}
 
   Bounds3f objectBound() const override;
   bool intersect(const Ray& ray, Float* tHit, SurfaceInteraction* isect,
@@ -22,11 +26,67 @@ class Sphere : public Shape {
 
   Float Area() const override;
 
+  Float Radius() const { return radius; }
+  Float ZMin() const { return zMin; }
+  Float ZMax() const { return zMax; }
+  Float PhiMax() const { return phiMax; }
+
  private:
   const Float radius;
   const Float zMin, zMax;
   const Float thetaMin, thetaMax;
-  const Float phiMax = 2 * Pi;
+  const Float phiMax;
 };
 
+// Azimuth of an object-space hit point in [0, 2 * Pi). Points on the z axis
+// are nudged off it first, as they have no azimuth.
+inline Float SpherePhi(Point3f* pHit, Float radius) {
+  if (pHit->x == 0 && pHit->y == 0) pHit->x = 1e-5f * radius;
+  Float phi = std::atan2(pHit->y, pHit->x);
+  if (phi < 0) phi += 2 * Pi;
+  return phi;
+}
+
+// The hit test of Sphere::intersect(), for a ray from _o_ along _d_ in the
+// sphere's object space. Returns the first hit in (0, tMax] that survives the
+// zMin/zMax/phiMax clipping. Whole spheres skip the clipping, and with it the
+// atan2, altogether. Shared with the BVH leaf kernels so both agree exactly.
+inline bool IntersectSphere(const Point3f& o, const Vector3f& d, Float tMax,
+                            Float radius, Float zMin, Float zMax, Float phiMax,
+                            Float* tHit) {
+  Float ox = o.x, oy = o.y, oz = o.z;
+  Float dx = d.x, dy = d.y, dz = d.z;
+
+  Float a = dx * dx + dy * dy + dz * dz;
+  Float b = 2 * (dx * ox + dy * oy + dz * oz);
+  Float c = ox * ox + oy * oy + oz * oz - radius * radius;
+
+  Float t0, t1;
+  if (!Quadratic(a, b, c, &t0, &t1)) return false;
+  if (t0 > tMax || t1 <= 0) return false;
+
+  Float tShapeHit = t0;
+  if (tShapeHit <= 0) {
+    tShapeHit = t1;
+    if (tShapeHit > tMax) return false;
+  }
+
+  if (zMin > -radius || zMax < radius || phiMax < 2 * Pi) {
+    auto clipped = [&](Float t) {
+      Point3f pHit = o + d * t;
+      Float phi = SpherePhi(&pHit, radius);
+      return (zMin > -radius && pHit.z < zMin) ||
+             (zMax < radius && pHit.z > zMax) || phi > phiMax;
+    };
+    if (clipped(tShapeHit)) {
+      if (tShapeHit == t1) return false;
+      if (t1 > tMax) return false;
+      tShapeHit = t1;
+      if (clipped(tShapeHit)) return false;
+    }
+  }
+  *tHit = tShapeHit;
+  return true;
+}
+
 #endif  // PHR_SHAPES_SPHERE_H
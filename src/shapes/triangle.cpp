@@ -0,0 +1,227 @@
+#include "shapes/triangle.h"
+
+#include "core/AllocAligned.h"
+#include "core/interaction.h"
+#include "core/stats.h"
+
+static size_t alignToCacheLine(size_t bytes) {
+  return (bytes + PBRT_L1_CACHE_LINE_SIZE - 1) &
+         ~size_t(PBRT_L1_CACHE_LINE_SIZE - 1);
+}
+
+TriangleMesh::TriangleMesh(const Transform &objectToWorld, int nTriangles,
+                           const int *vertexIndices, int nVertices,
+                           const Point3f *P, const Normal3f *N,
+                           const Point2f *UV)
+    : nTriangles(nTriangles), nVertices(nVertices) {
+  size_t indexBytes = alignToCacheLine(3 * nTriangles * sizeof(int));
+  size_t pBytes = alignToCacheLine(nVertices * sizeof(Point3f));
+  size_t nBytes = N ? alignToCacheLine(nVertices * sizeof(Normal3f)) : 0;
+  size_t uvBytes = UV ? alignToCacheLine(nVertices * sizeof(Point2f)) : 0;
+
+  uint8_t *base = AllocAligned<uint8_t>(indexBytes + pBytes + nBytes + uvBytes);
+  storage = std::shared_ptr<const void>(
+      base, [](const void *ptr) { FreeAligned(const_cast<void *>(ptr)); });
+
+  int *indices = reinterpret_cast<int *>(base);
+  std::memcpy(indices, vertexIndices, 3 * nTriangles * sizeof(int));
+  this->vertexIndices = indices;
+  base += indexBytes;
+
+  Point3f *worldP = reinterpret_cast<Point3f *>(base);
+  for (int i = 0; i < nVertices; ++i)
+    new (&worldP[i]) Point3f(objectToWorld(P[i]));
+  p = worldP;
+  base += pBytes;
+
+  n = nullptr;
+  if (N) {
+    Normal3f *worldN = reinterpret_cast<Normal3f *>(base);
+    for (int i = 0; i < nVertices; ++i)
+      new (&worldN[i]) Normal3f(objectToWorld(N[i]));
+    n = worldN;
+    base += nBytes;
+  }
+
+  uv = nullptr;
+  if (UV) {
+    Point2f *meshUV = reinterpret_cast<Point2f *>(base);
+    for (int i = 0; i < nVertices; ++i) new (&meshUV[i]) Point2f(UV[i]);
+    uv = meshUV;
+  }
+}
+
+TriangleMesh::TriangleMesh(int nTriangles, const int *vertexIndices,
+                           int nVertices, const Point3f *P, const Normal3f *N,
+                           const Point2f *UV,
+                           std::shared_ptr<const void> storage)
+    : nTriangles(nTriangles),
+      nVertices(nVertices),
+      vertexIndices(vertexIndices),
+      p(P),
+      n(N),
+      uv(UV),
+      storage(std::move(storage)) {}
+
+namespace {
+
+// The triangles of one mesh and the reference that keeps the mesh alive for
+// them.
+struct MeshTriangles {
+  std::shared_ptr<const TriangleMesh> mesh;
+  std::vector<Triangle> triangles;
+};
+
+}  // namespace
+
+std::vector<std::shared_ptr<Shape>> CreateTriangles(
+    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
+    std::shared_ptr<const TriangleMesh> mesh) {
+  auto block = std::make_shared<MeshTriangles>();
+  block->mesh = std::move(mesh);
+  int nTriangles = block->mesh->nTriangles;
+  block->triangles.reserve(nTriangles);
+  for (int i = 0; i < nTriangles; ++i)
+    block->triangles.emplace_back(o2w, w2o, reverseOrientation,
+                                  block->mesh.get(), i);
+  std::vector<std::shared_ptr<Shape>> tris;
+  tris.reserve(nTriangles);
+  for (Triangle &tri : block->triangles) tris.emplace_back(block, &tri);
+  return tris;
+}
+
+std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(
+    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
+    int nTriangles, const int *vertexIndices, int nVertices, const Point3f *p,
+    const Normal3f *n, const Point2f *uv) {
+  return CreateTriangles(
+      o2w, w2o, reverseOrientation,
+      std::make_shared<TriangleMesh>(*o2w, nTriangles, vertexIndices,
+                                     nVertices, p, n, uv));
+}
+
+void Triangle::getUVs(Point2f uv[3]) const {
+  if (mesh->uv) {
+    uv[0] = mesh->uv[v[0]];
+    uv[1] = mesh->uv[v[1]];
+    uv[2] = mesh->uv[v[2]];
+  } else {
+    uv[0] = Point2f(0, 0);
+    uv[1] = Point2f(1, 0);
+    uv[2] = Point2f(1, 1);
+  }
+}
+
+Bounds3f Triangle::objectBound() const {
+  const Point3f &p0 = mesh->p[v[0]];
+  const Point3f &p1 = mesh->p[v[1]];
+  const Point3f &p2 = mesh->p[v[2]];
+  return Union(Bounds3f((*worldToObject)(p0), (*worldToObject)(p1)),
+               (*worldToObject)(p2));
+}
+
+Bounds3f Triangle::worldBound() const {
+  const Point3f &p0 = mesh->p[v[0]];
+  const Point3f &p1 = mesh->p[v[1]];
+  const Point3f &p2 = mesh->p[v[2]];
+  return Union(Bounds3f(p0, p1), p2);
+}
+
+bool Triangle::intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
+                         bool /*testAlphaTexture*/) const {
+  PHR_STAT_INC(PrimitiveTests);
+  const Point3f &p0 = mesh->p[v[0]];
+  const Point3f &p1 = mesh->p[v[1]];
+  const Point3f &p2 = mesh->p[v[2]];
+  Float t, b0, b1, b2;
+  if (!IntersectTriangle(ray, p0, p1, p2, &t, &b0, &b1, &b2)) return false;
+
+  PHR_STAT_INC(PrimitiveHits);
+  if (!isect) return true;
+
+  // Compute triangle partial derivatives
+  Point2f uv[3];
+  getUVs(uv);
+  Vector2f duv02(uv[0] - uv[2]), duv12(uv[1] - uv[2]);
+  Vector3f dp02(p0 - p2), dp12(p1 - p2);
+  Float determinant = duv02[0] * duv12[1] - duv02[1] * duv12[0];
+  bool degenerateUV = std::abs(determinant) < 1e-8f;
+  Vector3f dpdu, dpdv;
+  if (!degenerateUV) {
+    Float invdet = 1 / determinant;
+    dpdu = (duv12[1] * dp02 - duv02[1] * dp12) * invdet;
+    dpdv = (duv02[0] * dp12 - duv12[0] * dp02) * invdet;
+  }
+  if (degenerateUV || Cross(dpdu, dpdv).lengthSquared() == 0) {
+    Vector3f ng = Cross(Vector3f(p2 - p0), Vector3f(p1 - p0));
+    if (ng.lengthSquared() == 0) return false;
+    glm::vec3 u, w;
+    CoordinateSystem(Normalize(ng), &u, &w);
+    dpdu = u;
+    dpdv = w;
+  }
+
+  // Compute error bounds for triangle intersection
+  Float xAbsSum = std::abs(b0 * p0.x) + std::abs(b1 * p1.x) +
+                  std::abs(b2 * p2.x);
+  Float yAbsSum = std::abs(b0 * p0.y) + std::abs(b1 * p1.y) +
+                  std::abs(b2 * p2.y);
+  Float zAbsSum = std::abs(b0 * p0.z) + std::abs(b1 * p1.z) +
+                  std::abs(b2 * p2.z);
+  Vector3f pError = Vector3f(xAbsSum, yAbsSum, zAbsSum) * gamma(7);
+
+  // Interpolate hit point and uv from the barycentric coordinates
+  Point3f pHit = b0 * p0 + b1 * p1 + b2 * p2;
+  Point2f uvHit = b0 * uv[0] + b1 * uv[1] + b2 * uv[2];
+
+  // The mesh is already in world space, so the interaction is built directly
+  // without going through objectToWorld.
+  *isect = SurfaceInteraction(pHit, pError, uvHit, -ray.d, dpdu, dpdv,
+                              Normal3f(0, 0, 0), Normal3f(0, 0, 0), ray.time,
+                              this);
+
+  // Override surface normal for triangle, honouring orientation flags
+  isect->n = isect->shading.n = Normal3f(Normalize(Cross(dp02, dp12)));
+  if (reverseOrientation ^ transformSwapsHandedness)
+    isect->n = isect->shading.n = -isect->n;
+
+  if (mesh->n) {
+    // Shading normal from the interpolated vertex normals
+    Normal3f ns(b0 * mesh->n[v[0]] + b1 * mesh->n[v[1]] + b2 * mesh->n[v[2]]);
+    if (Dot(ns, ns) > 0) {
+      ns = glm::normalize(ns);
+
+      // Shading tangents from the shading normal and the geometric dpdu
+      Vector3f ss = Normalize(isect->dpdu);
+      Vector3f ts = Cross(Vector3f(ns), ss);
+      if (ts.lengthSquared() > 0) {
+        ts = Normalize(ts);
+        ss = Cross(ts, Vector3f(ns));
+      } else {
+        glm::vec3 u, w;
+        CoordinateSystem(ns, &u, &w);
+        ss = u;
+        ts = w;
+      }
+      isect->setShadingGeometry(ss, ts, Normal3f(0, 0, 0), Normal3f(0, 0, 0),
+                                true);
+    }
+  } else {
+    // Keep the geometric normal on the same side as the shading normal
+    isect->n = FaceForward(isect->n, isect->shading.n);
+  }
+
+  *tHit = t;
+  return true;
+}
+
+bool Triangle::intersectP(const Ray &ray, bool testAlphaTexture) const {
+  return intersect(ray, nullptr, nullptr, testAlphaTexture);
+}
+
+Float Triangle::Area() const {
+  const Point3f &p0 = mesh->p[v[0]];
+  const Point3f &p1 = mesh->p[v[1]];
+  const Point3f &p2 = mesh->p[v[2]];
+  return 0.5f * Cross(Vector3f(p1 - p0), Vector3f(p2 - p0)).length();
+}
@@ -0,0 +1,173 @@
+#ifndef PHR_SHAPES_TRIANGLE_H
+#define PHR_SHAPES_TRIANGLE_H
+
+#include <memory>
+#include <vector>
+
+#include "core/phr.h"
+#include "core/shape.h"
+#include "core/transform.h"
+
+// Vertex data shared by every Triangle of a mesh. Positions and normals are
+// transformed to world space once at construction, so intersecting a triangle
+// never touches a Transform. The arrays are copied into one aligned
+// allocation, each section starting on its own cache line.
+struct TriangleMesh {
+  TriangleMesh(const Transform &objectToWorld, int nTriangles,
+               const int *vertexIndices, int nVertices, const Point3f *P,
+               const Normal3f *N, const Point2f *UV);
+  // Uses buffers that already hold world-space data, such as the pages of a
+  // mapped scene cache, without copying them. _storage_ keeps them alive.
+  TriangleMesh(int nTriangles, const int *vertexIndices, int nVertices,
+               const Point3f *P, const Normal3f *N, const Point2f *UV,
+               std::shared_ptr<const void> storage);
+
+  TriangleMesh(const TriangleMesh &) = delete;
+  TriangleMesh &operator=(const TriangleMesh &) = delete;
+
+  const int nTriangles, nVertices;
+  const int *vertexIndices;
+  const Point3f *p;
+  // Optional per-vertex attributes; nullptr when the mesh has none.
+  const Normal3f *n;
+  const Point2f *uv;
+
+ private:
+  std::shared_ptr<const void> storage;
+};
+
+// One triangle of a TriangleMesh, recorded as pointers to the mesh and to its
+// three vertex indices. Triangles do not own their mesh: CreateTriangles()
+// allocates all of a mesh's triangles in one array that holds the mesh
+// alive, so they cost neither a heap allocation nor a reference count each.
+class Triangle : public Shape {
+ public:
+  Triangle(const Transform *o2w, const Transform *w2o, bool ro,
+           const TriangleMesh *mesh, int triNumber)
+      : Shape(o2w, w2o, ro),
+        mesh(mesh),
+        v(&mesh->vertexIndices[3 * triNumber]) {}
+
+  Bounds3f objectBound() const override;
+  Bounds3f worldBound() const override;
+  bool intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
+                 bool testAlphaTexture) const override;
+  bool intersectP(const Ray &ray, bool testAlphaTexture) const override;
+
+  Float Area() const override;
+
+  const TriangleMesh &GetMesh() const { return *mesh; }
+  int TriangleIndex() const { return int(v - mesh->vertexIndices) / 3; }
+
+ private:
+  void getUVs(Point2f uv[3]) const;
+
+  const TriangleMesh *mesh;
+  const int *v;
+};
+
+// Watertight ray/triangle test (Woop et al. 2013): the vertices are moved into
+// a space where the ray starts at the origin and points down +z, so the edge
+// functions are evaluated identically for triangles sharing an edge and rays
+// cannot slip through the cracks between them. On a hit in (0, ray.tMax],
+// returns true with the distance and barycentrics of the hit. Shared by
+// Triangle::intersect() and the BVH leaf kernels, which must agree exactly.
+inline bool IntersectTriangle(const Ray &ray, const Point3f &p0,
+                              const Point3f &p1, const Point3f &p2,
+                              Float *tHit, Float *b0, Float *b1, Float *b2) {
+  // Translate vertices based on ray origin
+  Point3f p0t = p0 - ray.o;
+  Point3f p1t = p1 - ray.o;
+  Point3f p2t = p2 - ray.o;
+
+  // Permute components of triangle vertices and ray direction
+  int kz = MaxDimension(Abs(ray.d));
+  int kx = kz + 1;
+  if (kx == 3) kx = 0;
+  int ky = kx + 1;
+  if (ky == 3) ky = 0;
+  Vector3f d = Permute(ray.d, kx, ky, kz);
+  p0t = Permute(p0t, kx, ky, kz);
+  p1t = Permute(p1t, kx, ky, kz);
+  p2t = Permute(p2t, kx, ky, kz);
+
+  // Apply shear transformation to translated vertex positions
+  Float Sx = -d.x / d.z;
+  Float Sy = -d.y / d.z;
+  Float Sz = 1.f / d.z;
+  p0t.x += Sx * p0t.z;
+  p0t.y += Sy * p0t.z;
+  p1t.x += Sx * p1t.z;
+  p1t.y += Sy * p1t.z;
+  p2t.x += Sx * p2t.z;
+  p2t.y += Sy * p2t.z;
+
+  // Compute edge function coefficients
+  Float e0 = p1t.x * p2t.y - p1t.y * p2t.x;
+  Float e1 = p2t.x * p0t.y - p2t.y * p0t.x;
+  Float e2 = p0t.x * p1t.y - p0t.y * p1t.x;
+
+  // Fall back to double precision test at triangle edges
+  if (sizeof(Float) == sizeof(float) && (e0 == 0 || e1 == 0 || e2 == 0)) {
+    double p2txp1ty = (double)p2t.x * (double)p1t.y;
+    double p2typ1tx = (double)p2t.y * (double)p1t.x;
+    e0 = (float)(p2typ1tx - p2txp1ty);
+    double p0txp2ty = (double)p0t.x * (double)p2t.y;
+    double p0typ2tx = (double)p0t.y * (double)p2t.x;
+    e1 = (float)(p0typ2tx - p0txp2ty);
+    double p1txp0ty = (double)p1t.x * (double)p0t.y;
+    double p1typ0tx = (double)p1t.y * (double)p0t.x;
+    e2 = (float)(p1typ0tx - p1txp0ty);
+  }
+
+  // Perform triangle edge and determinant tests
+  if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+    return false;
+  Float det = e0 + e1 + e2;
+  if (det == 0) return false;
+
+  // Compute scaled hit distance and test against ray t range
+  p0t.z *= Sz;
+  p1t.z *= Sz;
+  p2t.z *= Sz;
+  Float tScaled = e0 * p0t.z + e1 * p1t.z + e2 * p2t.z;
+  if (det < 0 && (tScaled >= 0 || tScaled < ray.tMax * det))
+    return false;
+  else if (det > 0 && (tScaled <= 0 || tScaled > ray.tMax * det))
+    return false;
+
+  Float invDet = 1 / det;
+  *b0 = e0 * invDet;
+  *b1 = e1 * invDet;
+  *b2 = e2 * invDet;
+  *tHit = tScaled * invDet;
+
+  // Ensure that computed triangle t is conservatively greater than zero
+  Float maxZt = MaxComponent(Abs(Vector3f(p0t.z, p1t.z, p2t.z)));
+  Float deltaZ = gamma(3) * maxZt;
+  Float maxXt = MaxComponent(Abs(Vector3f(p0t.x, p1t.x, p2t.x)));
+  Float maxYt = MaxComponent(Abs(Vector3f(p0t.y, p1t.y, p2t.y)));
+  Float deltaX = gamma(5) * (maxXt + maxZt);
+  Float deltaY = gamma(5) * (maxYt + maxZt);
+  Float deltaE =
+      2 * (gamma(2) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt);
+  Float maxE = MaxComponent(Abs(Vector3f(e0, e1, e2)));
+  Float deltaT = 3 *
+                 (gamma(3) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE) *
+                 std::abs(invDet);
+  return *tHit > deltaT;
+}
+
+// Returns the triangles of _mesh_, in order. They are stored in one array,
+// allocated together with a reference to _mesh_, whose reference count the
+// returned pointers share.
+std::vector<std::shared_ptr<Shape>> CreateTriangles(
+    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
+    std::shared_ptr<const TriangleMesh> mesh);
+
+std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(
+    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
+    int nTriangles, const int *vertexIndices, int nVertices, const Point3f *p,
+    const Normal3f *n, const Point2f *uv);
+
+#endif  // PHR_SHAPES_TRIANGLE_H